@@ -15,6 +15,7 @@
 #include <ctype.h>
 #include <string.h>
 #include "fold.h"
+#include "alifold.h"
 #include "utils.h"
 #include "energy_par.h"
 #include "fold_vars.h"
@@ -33,97 +34,187 @@ static char rcsid[] UNUSED = "$Id: alifold.c,v 1.1.1.1 2004/09/18 13:25:52 wash
 #define NEW_NINIO     1   /* new asymetry penalty */
 
 PUBLIC float  alifold(char **strings, char *structure);
+PUBLIC alifold_ctx *alifold_ctx_create(int length, int n_seq);
+PUBLIC float  alifold_r(alifold_ctx *ctx, char **strings, char *structure);
+PUBLIC void   alifold_ctx_destroy(alifold_ctx *ctx);
 
-PRIVATE void   init_alifold(int length);
 PUBLIC  void   free_alifold_arrays(void);
 PUBLIC  void   update_alifold_params(void);
 
 PUBLIC double cv_fact=1.;
 PUBLIC double nc_fact=1.;
 
-PRIVATE void  parenthesis_structure(char *structure, int length);
-PRIVATE void  get_arrays(unsigned int size);
-PRIVATE void  make_pscores(const short *const *S, int n_seq,
+PRIVATE void  parenthesis_structure(const bondT *bp, char *structure, int length);
+PRIVATE void  get_arrays(alifold_ctx *ctx, unsigned int size);
+PRIVATE void  release_arrays(alifold_ctx *ctx);
+PRIVATE void  get_encodings(alifold_ctx *ctx, int n_seq, unsigned int size);
+PRIVATE void  release_encodings(alifold_ctx *ctx);
+PRIVATE void  make_pscores(alifold_ctx *ctx, const short *const *S, int n_seq,
 			   const char *structure);
-PRIVATE short *encode_seq(const char *sequence);
+PRIVATE void  make_candidates(alifold_ctx *ctx, int length);
+PRIVATE void  encode_seq(const char *sequence, short *S);
 /*@unused@*/
-extern  int LoopEnergy(int n1, int n2, int type, int type_2,
+extern  int LoopEnergy(const paramT *P, int n1, int n2, int type, int type_2,
 		       int si1, int sj1, int sp1, int sq1);
-extern  int HairpinE(int size, int type, int si1, int sj1, const char *string);
+extern  int HairpinE(const paramT *P, int size, int type, int si1, int sj1,
+		     const char *string);
+extern  void export_base_pairs(const bondT *bp);
 
 #define MAXSECTORS      500     /* dimension for a backtrack array */
 #define LOCALITY        0.      /* locality parameter for base-pairs */
 
 #define MIN2(A, B)      ((A) < (B) ? (A) : (B))
+/* index of (i,j) in c[] and pscore[], see dp_layout() in fold.c */
+#define CX(I,J)         (row[I]+col[J])
+
+/* Workspace of alifold_r(). The arrays only grow: they are sized for
+   the longest alignment (and the most sequences) seen so far. */
+struct alifold_ctx {
+  const paramT *P;   /* scaled energy parameters, shared with other contexts */
+  int   length;      /* arrays are allocated for alignments up to length */
+  int   *indx;  /* index for moving in the triangle matrices c[] and fMl[]*/
+  int   *row, *col; /* c[] and pscore[] of (i,j) are at row[i]+col[j] */
+  int   row_major;  /* ... in the layout of dp_layout() */
+  int   *c;       /* energy array, given that i-j pair */
+  int   *cc;      /* linear array for calculating canonical structures */
+  int   *cc1;     /*   "     "        */
+  int   *f5;      /* energy of 5' end */
+  int   *fML;     /* multi-loop auxiliary energy array */
+  int   *Fmi;     /* holds row i of fML (avoids jumps in memory) */
+  int   *DMLi;    /* DMLi[j] holds MIN(fML[i,k]+fML[k+1,j])  */
+  int   *DMLi1;   /*             MIN(fML[i+1,k]+fML[k+1,j])  */
+  int   *DMLi2;   /*             MIN(fML[i+2,k]+fML[k+1,j])  */
+  int   *pscore;  /* precomputed array of pair types */ 
+  int   *cand;    /* the q of all (p,q) with pscore>=MINPSCORE, by p */
+  int   cand_size;  /* room in cand[], grows with the pairs found */
+  int   *cand_p;  /* the q of row p are cand[cand_p[p]..cand_p[p+1]-1] */
+  bondT *base_pair; /* pairs of the last consensus structure */
+  int   n_seq;       /* number of encoded sequences S can hold */
+  int   seq_length;  /* ... and their maximal length */
+  short **S;         /* encoded sequences */
+  int   *type;       /* pair type of (i,j) in each sequence */
+};
+
+/* context used by alifold(), one per thread */
+PRIVATE THREAD_LOCAL alifold_ctx *default_ctx = NULL;
 
-PRIVATE const paramT *P;
+/*--------------------------------------------------------------------------*/
 
-PRIVATE int *indx; /* index for moving in the triangle matrices c[] and fMl[]*/
+PRIVATE void get_arrays(alifold_ctx *ctx, unsigned int size)
+{
+  unsigned int n;
 
-PRIVATE int   *c;       /* energy array, given that i-j pair */
-PRIVATE int   *cc;      /* linear array for calculating canonical structures */
-PRIVATE int   *cc1;     /*   "     "        */
-PRIVATE int   *f5;      /* energy of 5' end */
-PRIVATE int   *fML;     /* multi-loop auxiliary energy array */
+  ctx->indx =  (int *) space(sizeof(int)*(size+1));
+  ctx->row  = (int *) space(sizeof(int)*(size+2));
+  ctx->col  = (int *) space(sizeof(int)*(size+2));
+  ctx->c     = (int *) space(sizeof(int)*((size*(size+1))/2+2));
+  ctx->fML   = (int *) space(sizeof(int)*((size*(size+1))/2+2));
+
+  ctx->pscore = (int *) space(sizeof(int)*((size*(size+1))/2+2));
+  ctx->cand_size = 4*size+16;
+  ctx->cand  = (int *) space(sizeof(int)*ctx->cand_size);
+  ctx->cand_p = (int *) space(sizeof(int)*(size+2));
+  ctx->f5    = (int *) space(sizeof(int)*(size+2));
+  ctx->cc    = (int *) space(sizeof(int)*(size+2));
+  ctx->cc1   = (int *) space(sizeof(int)*(size+2));
+  ctx->Fmi   = (int *) space(sizeof(int)*(size+1));
+  ctx->DMLi  = (int *) space(sizeof(int)*(size+1));
+  ctx->DMLi1  = (int *) space(sizeof(int)*(size+1));
+  ctx->DMLi2  = (int *) space(sizeof(int)*(size+1));
+  ctx->base_pair = (struct bond *) space(sizeof(struct bond)*(1+size/2));
+
+  for (n = 1; n <= size; n++)
+    ctx->indx[n] = (n*(n-1)) >> 1;        /* n(n-1)/2 */
+  ctx->length = (int) size;
+  ctx->row_major = row_major_dp;
+  dp_layout((int) size, ctx->row_major, ctx->row, ctx->col);
+}
 
-PRIVATE int   *Fmi;     /* holds row i of fML (avoids jumps in memory) */
-PRIVATE int   *DMLi;    /* DMLi[j] holds MIN(fML[i,k]+fML[k+1,j])  */
-PRIVATE int   *DMLi1;   /*             MIN(fML[i+1,k]+fML[k+1,j])  */
-PRIVATE int   *DMLi2;   /*             MIN(fML[i+2,k]+fML[k+1,j])  */
-PRIVATE int   *pscore;  /* precomputed array of pair types */ 
-PRIVATE int   init_length=-1;
+/*--------------------------------------------------------------------------*/
+
+PRIVATE void release_arrays(alifold_ctx *ctx)
+{
+  free(ctx->indx); free(ctx->row); free(ctx->col);
+  free(ctx->c); free(ctx->fML); free(ctx->f5);
+  free(ctx->cc); free(ctx->cc1); free(ctx->pscore);
+  free(ctx->cand); free(ctx->cand_p);
+  free(ctx->base_pair); free(ctx->Fmi);
+  free(ctx->DMLi); free(ctx->DMLi1); free(ctx->DMLi2);
+  ctx->length = 0;
+}
 
 /*--------------------------------------------------------------------------*/
 
-PRIVATE void init_alifold(int length)
+PRIVATE void get_encodings(alifold_ctx *ctx, int n_seq, unsigned int size)
 {
-  unsigned int n;
-  if (length<1) nrerror("initialize_fold: argument must be greater 0");
-  if (init_length>0) free_alifold_arrays();
-  get_arrays((unsigned) length);
-  make_pair_matrix();
-  init_length=length;
+  int s;
+
+  ctx->S = (short **) space(n_seq*sizeof(short *));
+  for (s=0; s<n_seq; s++)
+    ctx->S[s] = (short *) space(sizeof(short)*(size+1));
+  ctx->type = (int *) space(n_seq*sizeof(int));
+  ctx->n_seq = n_seq;
+  ctx->seq_length = (int) size;
+}
 
-  for (n = 1; n <= (unsigned) length; n++)
-    indx[n] = (n*(n-1)) >> 1;        /* n(n-1)/2 */
-  
-  update_fold_params();
+/*--------------------------------------------------------------------------*/
+
+PRIVATE void release_encodings(alifold_ctx *ctx)
+{
+  int s;
+
+  for (s=0; s<ctx->n_seq; s++) free(ctx->S[s]);
+  free(ctx->S); free(ctx->type);
+  ctx->n_seq = ctx->seq_length = 0;
+}
+
+/*--------------------------------------------------------------------------*/
+
+PUBLIC alifold_ctx *alifold_ctx_create(int length, int n_seq)
+{
+  alifold_ctx *ctx;
+
+  ctx = (alifold_ctx *) space(sizeof(alifold_ctx));
+  ctx->P = get_scaled_parameters();
+  if (length>0) get_arrays(ctx, (unsigned) length);
+  if ((length>0)&&(n_seq>0)) get_encodings(ctx, n_seq, (unsigned) length);
+  return ctx;
 }
 
 /*--------------------------------------------------------------------------*/
 
-PRIVATE void get_arrays(unsigned int size)
+PUBLIC void alifold_ctx_destroy(alifold_ctx *ctx)
 {
-  indx =  (int *) space(sizeof(int)*(size+1));
-  c     = (int *) space(sizeof(int)*((size*(size+1))/2+2));
-  fML   = (int *) space(sizeof(int)*((size*(size+1))/2+2));
-
-  pscore = (int *) space(sizeof(int)*((size*(size+1))/2+2));
-  f5    = (int *) space(sizeof(int)*(size+2));
-  cc    = (int *) space(sizeof(int)*(size+2));
-  cc1   = (int *) space(sizeof(int)*(size+2));
-  Fmi   = (int *) space(sizeof(int)*(size+1));
-  DMLi  = (int *) space(sizeof(int)*(size+1));
-  DMLi1  = (int *) space(sizeof(int)*(size+1));
-  DMLi2  = (int *) space(sizeof(int)*(size+1));
-  base_pair = (struct bond *) space(sizeof(struct bond)*(1+size/2));
+  if (ctx==NULL) return;
+  if (ctx->length>0) release_arrays(ctx);
+  if (ctx->n_seq>0) release_encodings(ctx);
+  free(ctx);
 }
 
 /*--------------------------------------------------------------------------*/
 
 void free_alifold_arrays(void)
 {
-  free(indx); free(c); free(fML); free(f5); free(cc); free(cc1); 
-  free(pscore);
-  free(base_pair); free(Fmi);
-  free(DMLi); free(DMLi1);free(DMLi2);
-  init_length=0;
+  if (default_ctx!=NULL) alifold_ctx_destroy(default_ctx);
+  default_ctx = NULL;
+}
+
+/*--------------------------------------------------------------------------*/
+
+float alifold(char **strings, char *structure)
+{
+  float energy;
+
+  if (default_ctx==NULL) default_ctx = alifold_ctx_create(0, 0);
+  energy = alifold_r(default_ctx, strings, structure);
+  export_base_pairs(default_ctx->base_pair);
+  return energy;
 }
 
 /*--------------------------------------------------------------------------*/
 #define UNIT 100
 #define MINPSCORE -2 * UNIT
-float alifold(char **strings, char *structure)
+float alifold_r(alifold_ctx *ctx, char **strings, char *structure)
 {
   struct sect {
     int  i;
@@ -138,73 +229,122 @@ float alifold(char **strings, char *structure)
   int   n_seq, *type, type_2, tt;
   short **S;
   int cov_en = 0;
+  const paramT *P;
+  const int *indx, *row, *col, *pscore, *cand, *cand_p;
+  int   lo[MAXLOOP+2], hi[MAXLOOP+2]; /* cand[] of (p,minq..j-1), by p-i */
+  int   *c, *cc, *cc1, *f5, *fML, *Fmi, *DMLi, *DMLi1, *DMLi2;
+  bondT *bp;
 
   length = (int) strlen(strings[0]);
-  if (length>init_length) init_alifold(length);
-  if ((P==NULL)||(fabs(P->temperature - temperature)>1e-6)) { 
-  	update_fold_params();  P = scale_parameters();
-  }
+  if (length<1) nrerror("alifold: argument must be greater 0");
   for (s=0; strings[s]!=NULL; s++); 
   n_seq = s;
-  S = (short **) space(n_seq*sizeof(short *));
-  type = (int *) space(n_seq*sizeof(int));
+
+  if (length>ctx->length) {
+    if (ctx->length>0) release_arrays(ctx);
+    get_arrays(ctx, (unsigned) length);
+  }
+  if (ctx->row_major!=row_major_dp) {
+    ctx->row_major = row_major_dp;
+    dp_layout(ctx->length, ctx->row_major, ctx->row, ctx->col);
+  }
+  if ((n_seq>ctx->n_seq)||(length>ctx->seq_length)) {
+    if (ctx->n_seq>0) release_encodings(ctx);
+    get_encodings(ctx, n_seq, (unsigned) ctx->length);
+  }
+  if (!scaled_parameters_current(ctx->P))
+    ctx->P = get_scaled_parameters();
+  make_pair_matrix();
+
+  P = ctx->P;
+  indx = ctx->indx; pscore = ctx->pscore;
+  row = ctx->row; col = ctx->col;
+  cand_p = ctx->cand_p;
+  c = ctx->c; cc = ctx->cc; cc1 = ctx->cc1; f5 = ctx->f5; fML = ctx->fML;
+  Fmi = ctx->Fmi; DMLi = ctx->DMLi; DMLi1 = ctx->DMLi1; DMLi2 = ctx->DMLi2;
+  bp = ctx->base_pair;
+  S = ctx->S;
+  type = ctx->type;
+
   for (s=0; s<n_seq; s++) { 
     if (strlen(strings[s]) != length) nrerror("uneqal seqence lengths");
-    S[s] = encode_seq(strings[s]);
+    encode_seq(strings[s], S[s]);
   }
-  make_pscores((const short **) S, n_seq, structure);
+  make_pscores(ctx, (const short **) S, n_seq, structure);
+  make_candidates(ctx, length);
+  cand = ctx->cand;    /* may have moved */
 
   for (j=1; j<=length; j++) {
     Fmi[j]=DMLi[j]=DMLi1[j]=DMLi2[j]=INF;
   }
+  /* may hold values from an earlier call */
+  for (j=0; j<=length+1; j++) cc[j]=cc1[j]=0;
    
   for (j = 1; j<=length; j++)
     for (i=(j>TURN?(j-TURN):1); i<j; i++) {
-      c[indx[j]+i] = fML[indx[j]+i] = INF;
+      c[CX(i,j)] = fML[indx[j]+i] = INF;
 
     }       
   
   for (i = length-TURN-1; i >= 1; i--) { /* i,j in [1..length] */
+    for (k = 1; (k <= MAXLOOP+1) && (i+k <= length); k++)
+      lo[k] = hi[k] = cand_p[i+k];
       
     for (j = i+TURN+1; j <= length; j++) {
-      int ij, psc;
+      int ij, pij, psc;
       ij = indx[j]+i;
+      pij = CX(i,j);
 
       for (s=0; s<n_seq; s++) {
 	type[s] = pair[S[s][i]][S[s][j]];
 	if (type[s]==0) type[s]=7;
       }
  
-      psc = pscore[indx[j]+i];
+      psc = pscore[pij];
 		 
       if (psc>=cv_fact*MINPSCORE) {   /* a pair to consider */
-	int stackEnergy = INF;
+	int stackEnergy = INF, mm = 0;
 	/* hairpin ----------------------------------------------*/
 	
 	
 	for (new_c=s=0; s<n_seq; s++)
-	  new_c += HairpinE(j-i-1,type[s],S[s][i+1],S[s][j-1],strings[s]+i-1);
+	  new_c += HairpinE(P, j-i-1,type[s],S[s][i+1],S[s][j-1],strings[s]+i-1);
 	   
 	/*--------------------------------------------------------
 	  check for elementary structures involving more than one
 	  closing pair.
 	  --------------------------------------------------------*/
 	   
+	for (s=0; s<n_seq; s++)
+	  mm += P->mismatchI[type[s]][S[s][i+1]][S[s][j-1]];
 	for (p = i+1; p <= MIN2(j-2-TURN,i+MAXLOOP+1) ; p++) {
-	  int minq = j-i+p-MAXLOOP-2;
+	  int minq = j-i+p-MAXLOOP-2, n1 = p-i-1, n2, l;
+	  const int *size_e = P->interior[n1];
 	  if (minq<p+1+TURN) minq = p+1+TURN;
-	  for (q = minq; q < j; q++) {
-	    if (pscore[indx[q]+p]<MINPSCORE) continue;
-
-
-	    for (energy = s=0; s<n_seq; s++) {
-	      type_2 = pair[S[s][q]][S[s][p]]; /* q,p not p,q! */
-	      if (type_2 == 0) type_2 = 7;
-	      energy += LoopEnergy(p-i-1, j-q-1, type[s], type_2,
-				   S[s][i+1], S[s][j-1], 
-				   S[s][p-1], S[s][q+1]);
+	  /* only the q that may pair with p; minq and j grow with j */
+	  while ((lo[n1+1]<cand_p[p+1])&&(cand[lo[n1+1]]<minq)) lo[n1+1]++;
+	  while ((hi[n1+1]<cand_p[p+1])&&(cand[hi[n1+1]]<j)) hi[n1+1]++;
+	  for (l = lo[n1+1]; l < hi[n1+1]; l++) {
+	    q = cand[l];
+	    n2 = j-q-1;
+	    if ((n1>0)&&(n2>0)&&((n1>2)||(n2>2))) {
+	      /* generic interior loop, as in LoopEnergy() */
+	      energy = n_seq*size_e[n2]+mm;
+	      for (s=0; s<n_seq; s++) {
+		type_2 = pair[S[s][q]][S[s][p]];
+		if (type_2 == 0) type_2 = 7;
+		energy += P->mismatchI[type_2][S[s][q+1]][S[s][p-1]];
+	      }
 	    }
-	    new_c = MIN2(energy+c[indx[q]+p], new_c);
+	    else
+	      for (energy = s=0; s<n_seq; s++) {
+		type_2 = pair[S[s][q]][S[s][p]]; /* q,p not p,q! */
+		if (type_2 == 0) type_2 = 7;
+		energy += LoopEnergy(P, n1, n2, type[s], type_2,
+				     S[s][i+1], S[s][j-1],
+				     S[s][p-1], S[s][q+1]);
+	      }
+	    new_c = MIN2(energy+c[CX(p,q)], new_c);
 	    if ((p==i+1)&&(j==q+1)) stackEnergy = energy; /* remember stack energy */
 	       
 	  } /* end q-loop */
@@ -232,13 +372,13 @@ float alifold(char **strings, char *structure)
 	new_c = MIN2(new_c, cc1[j-1]+stackEnergy);
 	cc[j] = new_c - psc; /* add covariance bonnus/penalty */
 	if (noLonelyPairs)
-	  c[ij] = cc1[j-1]+stackEnergy-psc;
+	  c[pij] = cc1[j-1]+stackEnergy-psc;
 	else
-	  c[ij] = cc[j];
+	  c[pij] = cc[j];
 	   
       } /* end >> if (pair) << */
 	 
-      else c[ij] = INF;
+      else c[pij] = INF;
 
 
       /* done with c[i,j], now compute fML[i,j] */
@@ -246,7 +386,7 @@ float alifold(char **strings, char *structure)
 
       new_fML = fML[ij+1]+n_seq*P->MLbase;
       new_fML = MIN2(fML[indx[j-1]+i]+n_seq*P->MLbase, new_fML);
-      energy = c[ij];
+      energy = c[pij];
       for (s=0; s<n_seq; s++) {
 	energy += P->MLintern[type[s]];
 	if (dangles) {  /* double dangles */
@@ -283,8 +423,8 @@ float alifold(char **strings, char *structure)
   f5[TURN+1]=0;
   for (j=TURN+2; j<=length; j++) {
     f5[j] = f5[j-1];
-    if (c[indx[j]+1]<INF) {
-      energy = c[indx[j]+1];
+    if (c[CX(1,j)]<INF) {
+      energy = c[CX(1,j)];
       for (s=0; s<n_seq; s++) {
 	int type;
 	type = pair[S[s][1]][S[s][j]]; if (type==0) type=7;
@@ -295,8 +435,8 @@ float alifold(char **strings, char *structure)
       f5[j] = MIN2(f5[j], energy);
     }
     for (i=j-TURN-1; i>1; i--) {
-      if (c[indx[j]+i]<INF) {
-	energy = f5[i-1]+c[indx[j]+i];
+      if (c[CX(i,j)]<INF) {
+	energy = f5[i-1]+c[CX(i,j)];
 	for (s=0; s<n_seq; s++) {
 	  int type;
 	  type = pair[S[s][i]][S[s][j]]; if (type==0) type=7;
@@ -331,9 +471,9 @@ float alifold(char **strings, char *structure)
     ml = sector[s--].ml;   /* ml is a flag indicating if backtracking is to 
 			      occur in the fML- (1) or in the f-array (0) */
     if (ml==2) {
-      base_pair[++b].i = i;
-      base_pair[b].j   = j;
-      cov_en += pscore[indx[j]+i];
+      bp[++b].i = i;
+      bp[b].j   = j;
+      cov_en += pscore[CX(i,j)];
       goto repeat1; 
     }
 
@@ -354,8 +494,8 @@ float alifold(char **strings, char *structure)
       for (i=j-TURN-1,traced=0; i>=1; i--) {
 	int cc, en;
 	jj = i-1; 
-	if (c[indx[j]+i]<INF) {
-	  cc = c[indx[j]+i];
+	if (c[CX(i,j)]<INF) {
+	  cc = c[CX(i,j)];
 	  for (ss=0; ss<n_seq; ss++) {
 	    type[ss] = pair[S[ss][i]][S[ss][j]];
 	    if (type[ss]==0) type[ss] = 7;
@@ -379,9 +519,9 @@ float alifold(char **strings, char *structure)
       sector[s].ml  = ml;
        
       j=traced;
-      base_pair[++b].i = i;
-      base_pair[b].j   = j;
-      cov_en += pscore[indx[j]+i];
+      bp[++b].i = i;
+      bp[b].j   = j;
+      cov_en += pscore[CX(i,j)];
       goto repeat1;
     }
     else { /* trace back in fML array */
@@ -393,7 +533,7 @@ float alifold(char **strings, char *structure)
 	continue;
       } 
 
-      cij = c[indx[j]+i];
+      cij = c[CX(i,j)];
       for (ss=0; ss<n_seq; ss++) {
 	tt  = pair[S[ss][i]][S[ss][j]];
 	if (tt==0) tt=7;
@@ -409,9 +549,9 @@ float alifold(char **strings, char *structure)
 	if (fij==ci1j) i++;
 	else if (fij==cij1) j--;
 	else if (fij==ci1j1) {i++; j--;}
-	base_pair[++b].i = i;
-	base_pair[b].j   = j;
-	cov_en += pscore[indx[j]+i];
+	bp[++b].i = i;
+	bp[b].j   = j;
+	cov_en += pscore[CX(i,j)];
 	goto repeat1;
       } 
        
@@ -433,7 +573,7 @@ float alifold(char **strings, char *structure)
   repeat1:
       
     /*----- begin of "repeat:" -----*/
-    if (canonical)  cij = c[indx[j]+i];
+    if (canonical)  cij = c[CX(i,j)];
 
     for (ss=0; ss<n_seq; ss++) {
       type[ss] = pair[S[ss][i]][S[ss][j]];
@@ -441,7 +581,7 @@ float alifold(char **strings, char *structure)
     }
     
     if (noLonelyPairs) 
-      if (cij == c[indx[j]+i]) {
+      if (cij == c[CX(i,j)]) {
 	/* (i.j) closes canonical structures, thus
 	   (i+1.j-1) must be a pair                */
 	for (ss=0; ss<n_seq; ss++) {
@@ -449,20 +589,20 @@ float alifold(char **strings, char *structure)
 	  if (type_2==0) type_2 = 7;
 	  cij -= P->stack[type[ss]][type_2];
 	}
-	cij += pscore[indx[j]+i];
-	base_pair[++b].i = i+1;
-	base_pair[b].j   = j-1;
-	cov_en += pscore[indx[j-1]+i+1];
+	cij += pscore[CX(i,j)];
+	bp[++b].i = i+1;
+	bp[b].j   = j-1;
+	cov_en += pscore[CX(i+1,j-1)];
 	i++; j--; 
 	canonical=0;
 	goto repeat1;
       }
     canonical = 1;
-    cij += pscore[indx[j]+i];
+    cij += pscore[CX(i,j)];
 
     {int cc=0;
     for (ss=0; ss<n_seq; ss++) 
-      cc += HairpinE(j-i-1, type[ss], S[ss][i+1], S[ss][j-1], strings[ss]+i-1);
+      cc += HairpinE(P, j-i-1, type[ss], S[ss][i+1], S[ss][j-1], strings[ss]+i-1);
     if (cij == cc) /* found hairpin */ 
       continue;
     }
@@ -471,20 +611,20 @@ float alifold(char **strings, char *structure)
       if (minq<p+1+TURN) minq = p+1+TURN;
       for (q = j-1; q >= minq; q--) {
 	 
-	if (c[indx[q]+p]>=INF) continue;
+	if (c[CX(p,q)]>=INF) continue;
 
 	for (ss=energy=0; ss<n_seq; ss++) {
 	  type_2 = pair[S[ss][q]][S[ss][p]];  /* q,p not p,q */
 	  if (type_2==0) type_2 = 7;
-	  energy += LoopEnergy(p-i-1, j-q-1, type[ss], type_2,
+	  energy += LoopEnergy(P, p-i-1, j-q-1, type[ss], type_2,
 			       S[ss][i+1], S[ss][j-1], 
 			       S[ss][p-1], S[ss][q+1]);
 	}
-	traced = (cij == energy+c[indx[q]+p]);
+	traced = (cij == energy+c[CX(p,q)]);
 	if (traced) {
-	  base_pair[++b].i = p;
-	  base_pair[b].j   = q;
-	  cov_en += pscore[indx[q]+p];
+	  bp[++b].i = p;
+	  bp[b].j   = q;
+	  cov_en += pscore[CX(p,q)];
 	  i = p, j = q;
 	  goto repeat1;
 	}
@@ -525,17 +665,13 @@ float alifold(char **strings, char *structure)
     
   }
   
-  base_pair[0].i = b;    /* save the total number of base pairs */
+  bp[0].i = b;    /* save the total number of base pairs */
 
-  parenthesis_structure(structure, length);
-
-  free(type);
-  for (s=0; s<n_seq; s++) free(S[s]); 
-  free(S);
+  parenthesis_structure(bp, structure, length);
   
   /* fprintf(stderr, "covariance energy %6.2f\n", cov_en/100.); */
   if (backtrack_type=='C')
-    return (float) c[indx[length]+1]/(n_seq*100.);
+    return (float) c[CX(1,length)]/(n_seq*100.);
   else if (backtrack_type=='M')
     return (float) fML[indx[length]+1]/(n_seq*100.);
   else
@@ -544,42 +680,41 @@ float alifold(char **strings, char *structure)
 
 /*---------------------------------------------------------------------------*/
 
-PRIVATE short * encode_seq(const char *sequence) {
+PRIVATE void encode_seq(const char *sequence, short *S) {
   unsigned int i,l;
-  short *S;
   l = strlen(sequence);
-  S = (short *) space(sizeof(short)*(l+1));
   S[0] = (short) l;
   
   /* make numerical encoding of sequence */
   for (i=1; i<=l; i++) 
     S[i]= (short) encode_char(toupper(sequence[i-1]));
-  
-  return S;
 }
 
 /*---------------------------------------------------------------------------*/
 
-PRIVATE void parenthesis_structure(char *structure, int length)
+PRIVATE void parenthesis_structure(const bondT *bp, char *structure, int length)
 {
   int n, k;
   
   for (n = 0; n <= length-1; structure[n++] = '.') ;
   structure[length] = '\0';
 
-  for (k = 1; k <= base_pair[0].i; k++) {
-    structure[base_pair[k].i-1] = '(';
-    structure[base_pair[k].j-1] = ')';
+  for (k = 1; k <= bp[0].i; k++) {
+    structure[bp[k].i-1] = '(';
+    structure[bp[k].j-1] = ')';
   }
 }
 /*---------------------------------------------------------------------------*/
 
-PRIVATE void make_pscores(const short *const* S, int n_seq, const char *structure) {
+PRIVATE void make_pscores(alifold_ctx *ctx, const short *const* S, int n_seq,
+			 const char *structure) {
   /* calculate co-variance bonus for each pair depending on  */
   /* compensatory/consistent mutations and incompatible seqs */
   /* should be 0 for conserved pairs, >0 for good pairs      */
 #define NONE -10000 /* score for forbidden pairs */
   int n,i,j,k,l,s,score;
+  const int *row = ctx->row, *col = ctx->col;
+  int *pscore = ctx->pscore;
   int dm[7][7]={{0,0,0,0,0,0,0}, /* hamming distance between pairs */
 	       	{0,0,2,2,1,2,2} /* CG */,
 		{0,2,0,1,2,2,2} /* GC */,
@@ -590,7 +725,7 @@ PRIVATE void make_pscores(const short *const* S, int n_seq, const char *structur
   n=S[0][0];  /* length of seqs */
   for (i=1; i<n; i++) {
     for (j=i+1; (j<i+TURN+1) && (j<=n); j++) 
-      pscore[indx[j]+i] = NONE;
+      pscore[CX(i,j)] = NONE;
     for (j=i+TURN+1; j<=n; j++) {
       int pfreq[8]={0,0,0,0,0,0,0,0};
       for (s=0; s<n_seq; s++) {
@@ -600,14 +735,14 @@ PRIVATE void make_pscores(const short *const* S, int n_seq, const char *structur
 	
 	pfreq[type]++;
       }
-      if (pfreq[0]*2>n_seq) { pscore[indx[j]+i] = NONE; continue;}
+      if (pfreq[0]*2>n_seq) { pscore[CX(i,j)] = NONE; continue;}
       for (k=1,score=0; k<=6; k++) /* ignore pairtype 7 (gap-gap) */
 	for (l=k+1; l<=6; l++) 
 	  /* scores for replacements between pairtypes    */
 	  /* consistent or compensatory mutations score 1 or 2  */
 	  score += pfreq[k]*pfreq[l]*dm[k][l];
       /* counter examples score -1, gap-gap scores -0.25   */
-      pscore[indx[j]+i] = cv_fact *
+      pscore[CX(i,j)] = cv_fact *
 	((UNIT*score)/n_seq - UNIT*pfreq[0]*nc_fact - UNIT*pfreq[7]*0.25);
     }
   }
@@ -617,11 +752,11 @@ PRIVATE void make_pscores(const short *const* S, int n_seq, const char *structur
       for (l=1; l<=2; l++) {
 	int type,ntype=0,otype=0;
 	i=k; j = i+TURN+l;
-	type = pscore[indx[j]+i];
+	type = pscore[CX(i,j)];
 	while ((i>=1)&&(j<=n)) {
-	  if ((i>1)&&(j<n)) ntype = pscore[indx[j+1]+i-1];
+	  if ((i>1)&&(j<n)) ntype = pscore[CX(i-1,j+1)];
 	  if ((otype<-4*UNIT)&&(ntype<-4*UNIT))  /* worse than 2 counterex */
-	    pscore[indx[j]+i] = NONE; /* i.j can only form isolated pairs */
+	    pscore[CX(i,j)] = NONE; /* i.j can only form isolated pairs */
 	  otype =  type;
 	  type  = ntype;
 	  i--; j++;
@@ -636,14 +771,14 @@ PRIVATE void make_pscores(const short *const* S, int n_seq, const char *structur
     for(hx=0, j=1; j<=n; j++) {
       switch (structure[j-1]) {
       case 'x': /* can't pair */ 
-        for (l=1; l<j-TURN; l++) pscore[indx[j]+l] = NONE;
-        for (l=j+TURN+1; l<=n; l++) pscore[indx[l]+j] = NONE;
+        for (l=1; l<j-TURN; l++) pscore[CX(l,j)] = NONE;
+        for (l=j+TURN+1; l<=n; l++) pscore[CX(j,l)] = NONE;
         break;
       case '(':
         stack[hx++]=j;
         /* fallthrough */
       case '<': /* pairs upstream */
-        for (l=1; l<j-TURN; l++) pscore[indx[j]+l] = NONE;
+        for (l=1; l<j-TURN; l++) pscore[CX(l,j)] = NONE;
         break;
       case ')':
         if (hx<=0) {
@@ -651,17 +786,17 @@ PRIVATE void make_pscores(const short *const* S, int n_seq, const char *structur
           nrerror("unbalanced brackets in constraints");
         }
         i = stack[--hx];
-	for (k=i+1; k<=n; k++) pscore[indx[i]+k] = NONE;
+	for (k=i+1; k<=n; k++) pscore[CX(k,i)] = NONE;
         for (l=i+1; l<=j; l++) 
-	  for (k=j; k<=n; k++) pscore[indx[l]+k] = NONE;
+	  for (k=j; k<=n; k++) pscore[CX(k,l)] = NONE;
 	for (k=1; k<=i; k++) 
-	  for (l=i; l<=j; l++) pscore[indx[k]+l] = NONE;
-	for (k=1; k<j; k++) pscore[indx[k]+j] = NONE;
-        if (pscore[indx[j]+i]==NONE) 
-	  pscore[indx[j]+i] = 0;
+	  for (l=i; l<=j; l++) pscore[CX(l,k)] = NONE;
+	for (k=1; k<j; k++) pscore[CX(j,k)] = NONE;
+        if (pscore[CX(i,j)]==NONE) 
+	  pscore[CX(i,j)] = 0;
         /* fallthrough */
       case '>': /* pairs downstream */
-        for (l=j+TURN+1; l<=n; l++) pscore[indx[l]+j] = NONE;
+        for (l=j+TURN+1; l<=n; l++) pscore[CX(j,l)] = NONE;
         break;
       }
     }
@@ -672,3 +807,26 @@ PRIVATE void make_pscores(const short *const* S, int n_seq, const char *structur
     free(stack);
   }
 }
+
+/*---------------------------------------------------------------------------*/
+
+PRIVATE void make_candidates(alifold_ctx *ctx, int length) {
+  /* the (p,q) with pscore>=MINPSCORE row by row, the inner pairs the
+     interior loops of alifold_r() go over */
+  const int *row = ctx->row, *col = ctx->col;
+  const int *pscore = ctx->pscore;
+  int p, q, n;
+
+  for (n=0, p=1; p<=length; p++) {
+    ctx->cand_p[p] = n;
+    for (q=p+TURN+1; q<=length; q++)
+      if (pscore[CX(p,q)]>=MINPSCORE) {
+	if (n==ctx->cand_size) {
+	  ctx->cand_size *= 2;
+	  ctx->cand = (int *) xrealloc(ctx->cand, sizeof(int)*ctx->cand_size);
+	}
+	ctx->cand[n++] = q;
+      }
+  }
+  ctx->cand_p[length+1] = n;
+}
@@ -1,4 +1,10 @@
 extern float  alifold(char **strings, char *structure);
+typedef struct alifold_ctx alifold_ctx;
+/* workspace of one consensus folding; alifold() uses one per thread */
+extern alifold_ctx *alifold_ctx_create(int length, int n_seq);
+extern float  alifold_r(alifold_ctx *ctx, char **strings, char *structure);
+/* reentrant alifold(), arrays of ctx only grow, never shrink */
+extern  void  alifold_ctx_destroy(alifold_ctx *ctx);
 extern  void  free_alifold_arrays(void);
 extern  void  update_alifold_params(void);
 extern double cv_fact /* =1 */;
@@ -21,6 +21,8 @@
 #include "fold_vars.h"
 #include "pair_mat.h"
 #include "params.h"
+#include "fold.h"
+#include "alifold.h"
 
 /*@unused@*/
 static char rcsid[] UNUSED = "$Id: fold.c,v 1.1.1.1 2004/09/18 13:25:53 wash Exp $";
@@ -34,56 +36,95 @@ static char rcsid[] UNUSED = "$Id: fold.c,v 1.1.1.1 2004/09/18 13:25:53 wash Exp
 #define NEW_NINIO     1   /* new asymetry penalty */
 
 PUBLIC float  fold(const char *string, char *structure);
+PUBLIC fold_ctx *fold_ctx_create(int length);
+PUBLIC float  fold_r(fold_ctx *ctx, const char *string, char *structure);
+PUBLIC float  fold_energy_only(fold_ctx *ctx, const char *string);
+PUBLIC void   fold_ctx_destroy(fold_ctx *ctx);
 PUBLIC float  energy_of_struct(const char *string, const char *structure);
 PUBLIC int    energy_of_struct_pt(const char *string, short *ptable,
 				  short *s, short *s1);
 PUBLIC void   free_arrays(void);
+PUBLIC void   free_fold_workspaces(void);
 PUBLIC void   initialize_fold(int length);
 PUBLIC void   update_fold_params(void);
+PUBLIC void   dp_layout(int size, int row_major, int *row, int *col);
+PUBLIC void   export_base_pairs(const bondT *bp);
 
 PUBLIC int    logML=0;    /* if nonzero use logarithmic ML energy in
 			     energy_of_struct */
 PUBLIC int    uniq_ML=0;  /* do ML decomposition uniquely (for subopt) */
+#ifndef ROW_MAJOR_DP
+#define ROW_MAJOR_DP 0
+#endif
+PUBLIC int    row_major_dp=ROW_MAJOR_DP; /* c[] and pair types by rows */
 /*@unused@*/
-PRIVATE void  letter_structure(char *structure, int length) UNUSED;
-PRIVATE void  parenthesis_structure(char *structure, int length);
-PRIVATE void  get_arrays(unsigned int size);
+PRIVATE void  letter_structure(const bondT *bp, char *structure, int length) UNUSED;
+PRIVATE void  parenthesis_structure(const bondT *bp, char *structure, int length);
+PRIVATE void  get_arrays(fold_ctx *ctx, unsigned int size);
+PRIVATE void  release_arrays(fold_ctx *ctx);
 /* PRIVATE void  scale_parameters(void); */
 PRIVATE int   stack_energy(int i, const char *string);
 PRIVATE int   ML_Energy(int i, int is_extloop);
-PRIVATE void  make_ptypes(const short *S, const char *structure);
-PRIVATE void  encode_seq(const char *sequence);
-PRIVATE void backtrack(const char *sequence);
-PRIVATE int fill_arrays(const char *sequence);
+PRIVATE void  make_ptypes(fold_ctx *ctx, const short *S, const char *structure);
+PRIVATE void  make_candidates(fold_ctx *ctx, int length);
+PRIVATE void  encode_seq(const char *sequence, short *S, short *S1);
+PRIVATE void backtrack(fold_ctx *ctx, const char *sequence);
+PRIVATE int fill_arrays(fold_ctx *ctx, const char *sequence, int energy_only);
 /*@unused@*/
 inline PRIVATE  int   oldLoopEnergy(int i, int j, int p, int q, int type, int type_2);
-extern int  LoopEnergy(int n1, int n2, int type, int type_2,
+extern int  LoopEnergy(const paramT *P, int n1, int n2, int type, int type_2,
 			 int si1, int sj1, int sp1, int sq1);
-extern int  HairpinE(int size, int type, int si1, int sj1, const char *string);
+extern int  HairpinE(const paramT *P, int size, int type, int si1, int sj1,
+		     const char *string);
 
 #define MAXSECTORS      500     /* dimension for a backtrack array */
 #define LOCALITY        0.      /* locality parameter for base-pairs */
 
 #define MIN2(A, B)      ((A) < (B) ? (A) : (B))
 #define SAME_STRAND(I,J) (((I)>=cut_point)||((J)<cut_point))
+/* index of (i,j) in c[] and ptype[], with the row and col of the context */
+#define CX(I,J)         (row[I]+col[J])
+
+/* Everything one mfe folding needs. Contexts share nothing but the
+   read-only energy parameters, so different threads can fold with
+   different contexts at the same time, and a context keeps its arrays
+   from one call to the next. */
+struct fold_ctx {
+  const paramT *P;   /* scaled energy parameters, shared with other contexts */
+  int   length;      /* arrays are allocated for sequences up to length */
+  int   *indx;  /* index for moving in the triangle matrices c[] and fMl[]*/
+  int   *row, *col; /* c[] and ptype[] of (i,j) are at row[i]+col[j] */
+  int   row_major;  /* ... in the layout of dp_layout() */
+  int   *c;       /* energy array, given that i-j pair */
+  int   *cc;      /* linear array for calculating canonical structures */
+  int   *cc1;     /*   "     "        */
+  int   *f5;      /* energy of 5' end */
+  int   *fML;     /* multi-loop auxiliary energy array */
+  int   *fM1;     /* second ML array, only for subopt */
+  int   *Fmi;     /* holds row i of fML (avoids jumps in memory) */
+  int   *DMLi;    /* DMLi[j] holds MIN(fML[i,k]+fML[k+1,j])  */
+  int   *DMLi1;   /*             MIN(fML[i+1,k]+fML[k+1,j])  */
+  int   *DMLi2;   /*             MIN(fML[i+2,k]+fML[k+1,j])  */
+  char  *ptype;   /* precomputed array of pair types */ 
+  int   *cand;    /* the q of all (p,q) with a pair type, by p */
+  int   cand_size;  /* room in cand[], grows with the pairs found */
+  int   *cand_p;  /* the q of row p are cand[cand_p[p]..cand_p[p+1]-1] */
+  short *S, *S1;  /* encoded sequence */
+  int   *BP;      /* contains the structure constrainsts: BP[i]
+			-1: | = base must be paired
+			-2: < = base must be paired with j<i
+			-3: > = base must be paired with j>i
+			-4: x = base must not pair
+			positive int: base is paired with int      */
+  bondT *base_pair; /* pairs of the last mfe structure */
+};
 
-PRIVATE paramT *P = NULL;
-
-PRIVATE int *indx; /* index for moving in the triangle matrices c[] and fMl[]*/
+/* context used by fold() and friends, one per thread */
+PRIVATE THREAD_LOCAL fold_ctx *default_ctx = NULL;
 
-PRIVATE int   *c;       /* energy array, given that i-j pair */
-PRIVATE int   *cc;      /* linear array for calculating canonical structures */
-PRIVATE int   *cc1;     /*   "     "        */
-PRIVATE int   *f5;      /* energy of 5' end */
-PRIVATE int   *fML;     /* multi-loop auxiliary energy array */
-PRIVATE int   *fM1;     /* second ML array, only for subopt */
-PRIVATE int   *Fmi;     /* holds row i of fML (avoids jumps in memory) */
-PRIVATE int   *DMLi;    /* DMLi[j] holds MIN(fML[i,k]+fML[k+1,j])  */
-PRIVATE int   *DMLi1;   /*             MIN(fML[i+1,k]+fML[k+1,j])  */
-PRIVATE int   *DMLi2;   /*             MIN(fML[i+2,k]+fML[k+1,j])  */
-PRIVATE char  *ptype;   /* precomputed array of pair types */ 
-PRIVATE short  *S, *S1;
-PRIVATE int   init_length=-1;
+/* energy parameters and encoded sequence for energy_of_struct() */
+PRIVATE THREAD_LOCAL const paramT *P = NULL;
+PRIVATE THREAD_LOCAL short  *S, *S1;
 
 PRIVATE char  alpha[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz";
 /* needed by cofold/eval */
@@ -96,91 +137,217 @@ PUBLIC int   eos_debug=0;  /* verbose info from energy_of_struct */
 
 void initialize_fold(int length)
 {
-  unsigned int n;
   if (length<1) nrerror("initialize_fold: argument must be greater 0");
-  if (init_length>0) free_arrays();
-  get_arrays((unsigned) length);
-  init_length=length;
-  
-  for (n = 1; n <= (unsigned) length; n++)
-    indx[n] = (n*(n-1)) >> 1;        /* n(n-1)/2 */
-
-  update_fold_params();
+  if (default_ctx!=NULL) fold_ctx_destroy(default_ctx);
+  default_ctx = fold_ctx_create(length);
 }
     
 /*--------------------------------------------------------------------------*/
 
-PRIVATE void get_arrays(unsigned int size)
+PRIVATE void get_arrays(fold_ctx *ctx, unsigned int size)
 {
-  indx = (int *) space(sizeof(int)*(size+1));
-  c     = (int *) space(sizeof(int)*((size*(size+1))/2+2));
-  fML   = (int *) space(sizeof(int)*((size*(size+1))/2+2));
+  unsigned int n;
+
+  ctx->indx = (int *) space(sizeof(int)*(size+1));
+  ctx->row  = (int *) space(sizeof(int)*(size+2));
+  ctx->col  = (int *) space(sizeof(int)*(size+2));
+  ctx->c     = (int *) space(sizeof(int)*((size*(size+1))/2+2));
+  ctx->fML   = (int *) space(sizeof(int)*((size*(size+1))/2+2));
   if (uniq_ML)
-    fM1    = (int *) space(sizeof(int)*((size*(size+1))/2+2));
-
-  ptype = (char *) space(sizeof(char)*((size*(size+1))/2+2));
-  f5    = (int *) space(sizeof(int)*(size+2));
-  cc    = (int *) space(sizeof(int)*(size+2));
-  cc1   = (int *) space(sizeof(int)*(size+2));
-  Fmi   = (int *) space(sizeof(int)*(size+1));
-  DMLi  = (int *) space(sizeof(int)*(size+1));
-  DMLi1  = (int *) space(sizeof(int)*(size+1));
-  DMLi2  = (int *) space(sizeof(int)*(size+1));
-  base_pair = (struct bond *) space(sizeof(struct bond)*(1+size/2));
+    ctx->fM1    = (int *) space(sizeof(int)*((size*(size+1))/2+2));
+
+  ctx->ptype = (char *) space(sizeof(char)*((size*(size+1))/2+2));
+  ctx->cand_size = 4*size+16;
+  ctx->cand  = (int *) space(sizeof(int)*ctx->cand_size);
+  ctx->cand_p = (int *) space(sizeof(int)*(size+2));
+  ctx->f5    = (int *) space(sizeof(int)*(size+2));
+  ctx->cc    = (int *) space(sizeof(int)*(size+2));
+  ctx->cc1   = (int *) space(sizeof(int)*(size+2));
+  ctx->Fmi   = (int *) space(sizeof(int)*(size+1));
+  ctx->DMLi  = (int *) space(sizeof(int)*(size+1));
+  ctx->DMLi1  = (int *) space(sizeof(int)*(size+1));
+  ctx->DMLi2  = (int *) space(sizeof(int)*(size+1));
+  ctx->S     = (short *) space(sizeof(short)*(size+1));
+  ctx->S1    = (short *) space(sizeof(short)*(size+1));
+  ctx->BP    = (int *) space(sizeof(int)*(size+2));
+  ctx->base_pair = (struct bond *) space(sizeof(struct bond)*(1+size/2));
+
+  for (n = 1; n <= size; n++)
+    ctx->indx[n] = (n*(n-1)) >> 1;        /* n(n-1)/2 */
+  ctx->length = (int) size;
+  ctx->row_major = row_major_dp;
+  dp_layout((int) size, ctx->row_major, ctx->row, ctx->col);
+}
+
+/*--------------------------------------------------------------------------*/
+
+PRIVATE void release_arrays(fold_ctx *ctx)
+{
+  free(ctx->indx); free(ctx->row); free(ctx->col);
+  free(ctx->c); free(ctx->fML); free(ctx->f5);
+  free(ctx->cc); free(ctx->cc1); free(ctx->ptype);
+  free(ctx->cand); free(ctx->cand_p);
+  if (ctx->fM1!=NULL) free(ctx->fM1);
+
+  free(ctx->base_pair); free(ctx->Fmi);
+  free(ctx->DMLi); free(ctx->DMLi1); free(ctx->DMLi2);
+  free(ctx->S); free(ctx->S1); free(ctx->BP);
+  ctx->fM1 = NULL;
+  ctx->length = 0;
+}
+
+/*--------------------------------------------------------------------------*/
+
+PUBLIC void dp_layout(int size, int row_major, int *row, int *col)
+{
+  /* Where c[] and the pair types of (i,j), i<=j<=size, are kept: at
+     row[i]+col[j], from 1 to size*(size+1)/2. By columns the cells
+     (.,j) follow each other, as in fML[]; by rows the cells (i,.),
+     which is the order in which the interior loops closed by (i,j)
+     and the pscore checks of alifold() go over their inner pairs. */
+  int n;
+
+  row[0] = col[0] = 0;
+  for (n = 1; n <= size; n++) {
+    if (row_major) {
+      row[n] = (n-1)*(size+1) - ((n-1)*n)/2 - n + 1;
+      col[n] = n;
+    } else {
+      row[n] = n;
+      col[n] = (n*(n-1)) >> 1;
+    }
+  }
 }
 
 /*--------------------------------------------------------------------------*/
 
 void free_arrays(void)
 {
-  free(indx); free(c); free(fML); free(f5); free(cc); free(cc1); 
-  free(ptype);
-  if (uniq_ML) free(fM1);
+  if (default_ctx!=NULL) fold_ctx_destroy(default_ctx);
+  default_ctx = NULL;
+}
 
-  free(base_pair); free(Fmi);
-  free(DMLi); free(DMLi1);free(DMLi2);
-  init_length=0;
+/*--------------------------------------------------------------------------*/
+
+void free_fold_workspaces(void)
+{
+  /* end of a run: the default contexts of the calling thread, the
+     global base_pair and the shared energy parameters; all other
+     contexts must be gone by now */
+  free_arrays();
+  free_alifold_arrays();
+  free(base_pair);
+  base_pair = NULL;
+  free_scaled_parameters();
 }
 
 /*--------------------------------------------------------------------------*/
 
 void export_fold_arrays(int **f5_p, int **c_p, int **fML_p, int **fM1_p, 
 			int **indx_p, char **ptype_p) {
-  /* make the DP arrays available to routines such as subopt() */ 
-  *f5_p = f5; *c_p = c;
-  *fML_p = fML; *fM1_p = fM1;
-  *indx_p = indx; *ptype_p = ptype;
+  /* make the DP arrays available to routines such as subopt() */
+  fold_ctx *ctx = default_ctx;
+  if (ctx==NULL) {  /* nothing folded yet */
+    *f5_p = *c_p = *fML_p = *fM1_p = *indx_p = NULL; *ptype_p = NULL;
+    return;
+  }
+  /* indx[] describes c[] and ptype[] only in the column layout */
+  if (ctx->row_major)
+    nrerror("export_fold_arrays: c[] and ptype[] are stored by rows");
+  *f5_p = ctx->f5; *c_p = ctx->c;
+  *fML_p = ctx->fML; *fM1_p = ctx->fM1;
+  *indx_p = ctx->indx; *ptype_p = ctx->ptype;
 }
 
 /*--------------------------------------------------------------------------*/
 
-PRIVATE   int   *BP; /* contains the structure constrainsts: BP[i]
-			-1: | = base must be paired
-			-2: < = base must be paired with j<i
-			-3: > = base must be paired with j>i
-			-4: x = base must not pair
-			positive int: base is paired with int      */
+PUBLIC fold_ctx *fold_ctx_create(int length)
+{
+  fold_ctx *ctx;
+
+  ctx = (fold_ctx *) space(sizeof(fold_ctx));
+  ctx->P = get_scaled_parameters();
+  if (length>0) get_arrays(ctx, (unsigned) length);
+  return ctx;
+}
+
+/*--------------------------------------------------------------------------*/
+
+PUBLIC void fold_ctx_destroy(fold_ctx *ctx)
+{
+  if (ctx==NULL) return;
+  if (ctx->length>0) release_arrays(ctx);
+  free(ctx);
+}
+
+/*--------------------------------------------------------------------------*/
 
 float fold(const char *string, char *structure) {
+  int length;
+  float energy;
+
+  length = (int) strlen(string);
+  if ((default_ctx==NULL)||(length>default_ctx->length))
+    initialize_fold(length);
+
+  energy = fold_r(default_ctx, string, structure);
+  export_base_pairs(default_ctx->base_pair);
+  return energy;
+}
+
+/*--------------------------------------------------------------------------*/
+
+/* the global base_pair of fold() and alifold(); the reentrant versions
+   only fill the list of their context */
+void export_base_pairs(const bondT *bp)
+{
+  unsigned size;
+
+  size = sizeof(bondT)*(1+bp[0].i);
+  base_pair = (bondT *) xrealloc(base_pair, size);
+  memcpy(base_pair, bp, size);
+}
+
+/*--------------------------------------------------------------------------*/
+
+float fold_r(fold_ctx *ctx, const char *string, char *structure) {
   int i, length, energy, bonus=0, bonus_cnt=0;
-  
+  int *BP;
+  bondT *bp;
+
   length = (int) strlen(string);
-  if (length>init_length) initialize_fold(length);
-  if (fabs(P->temperature - temperature)>1e-6) update_fold_params();
-  
-  encode_seq(string);
+  if (length>ctx->length) {
+    if (ctx->length>0) release_arrays(ctx);
+    get_arrays(ctx, (unsigned) length);
+  }
+  if (ctx->row_major!=row_major_dp) {
+    ctx->row_major = row_major_dp;
+    dp_layout(ctx->length, ctx->row_major, ctx->row, ctx->col);
+  }
+  if (uniq_ML && (ctx->fM1==NULL))
+    ctx->fM1 = (int *) space(sizeof(int)*((ctx->length*(ctx->length+1))/2+2));
+  if (!scaled_parameters_current(ctx->P))
+    ctx->P = get_scaled_parameters();
+  make_pair_matrix();
   
-  BP = (int *)space(sizeof(int)*(length+2));
-  make_ptypes(S, structure);
+  encode_seq(string, ctx->S, ctx->S1);
+
+  /* the arrays may hold values from an earlier call */
+  BP = ctx->BP;
+  memset(BP, 0, sizeof(int)*(length+2));
+  memset(ctx->ptype, 0,
+	 sizeof(char)*(ctx->row[length]+ctx->col[length]+1));
+  make_ptypes(ctx, ctx->S, structure);
   
-  energy = fill_arrays(string);
+  energy = fill_arrays(ctx, string, 0);
 
-  backtrack(string);
+  backtrack(ctx, string);
 
+  bp = ctx->base_pair;
 #ifdef PAREN
-  parenthesis_structure(structure, length);
+  parenthesis_structure(bp, structure, length);
 #else
-  letter_structure(structure, length);
+  letter_structure(bp, structure, length);
 #endif
 
   /* check constraints */ 
@@ -195,99 +362,165 @@ float fold(const char *string, char *structure) {
     if(BP[i]>i) {
       int l;
       bonus_cnt++;
-      for(l=1; l<=base_pair[0].i; l++)
-	if((i==base_pair[l].i)&&(BP[i]==base_pair[l].j)) bonus++;
+      for(l=1; l<=bp[0].i; l++)
+	if((i==bp[l].i)&&(BP[i]==bp[l].j)) bonus++;
     }
   }
   
   if (bonus_cnt>bonus) fprintf(stderr,"\ncould not enforce all constraints\n");
   bonus*=BONUS;
 
-  free(S); free(S1); free(BP);
-
   energy += bonus;      /*remove bonus energies from result */
 
   if (backtrack_type=='C')
-    return (float) c[indx[length]+1]/100.;
+    return (float) ctx->c[ctx->row[1]+ctx->col[length]]/100.;
   else if (backtrack_type=='M')
-    return (float) fML[indx[length]+1]/100.;
+    return (float) ctx->fML[ctx->indx[length]+1]/100.;
   else
     return (float) energy/100.;
 }
 
-PRIVATE int fill_arrays(const char *string) {
-  /* fill "c", "fML" and "f5" arrays and return  optimal energy */
+/* Minimum free energy of a sequence without the structure: only the
+   arrays needed for f5[length] are filled, there is no backtracking and
+   constraints are ignored. ctx==NULL uses the default context of the
+   thread, like fold(). */
+
+float fold_energy_only(fold_ctx *ctx, const char *string) {
+  int length, energy;
+
+  length = (int) strlen(string);
+  if (ctx==NULL) {
+    if ((default_ctx==NULL)||(length>default_ctx->length))
+      initialize_fold(length);
+    ctx = default_ctx;
+  }
+  if (length>ctx->length) {
+    if (ctx->length>0) release_arrays(ctx);
+    get_arrays(ctx, (unsigned) length);
+  }
+  if (ctx->row_major!=row_major_dp) {
+    ctx->row_major = row_major_dp;
+    dp_layout(ctx->length, ctx->row_major, ctx->row, ctx->col);
+  }
+  if (!scaled_parameters_current(ctx->P))
+    ctx->P = get_scaled_parameters();
+  make_pair_matrix();
+
+  encode_seq(string, ctx->S, ctx->S1);
+  memset(ctx->ptype, 0,
+	 sizeof(char)*(ctx->row[length]+ctx->col[length]+1));
+  make_ptypes(ctx, ctx->S, NULL);
+
+  energy = fill_arrays(ctx, string, 1);
+
+  if (backtrack_type=='C')
+    return (float) ctx->c[ctx->row[1]+ctx->col[length]]/100.;
+  else if (backtrack_type=='M')
+    return (float) ctx->fML[ctx->indx[length]+1]/100.;
+  else
+    return (float) energy/100.;
+}
+
+/*--------------------------------------------------------------------------*/
+
+PRIVATE int fill_arrays(fold_ctx *ctx, const char *string, int energy_only) {
+  /* fill "c", "fML" and "f5" arrays and return  optimal energy;
+     with energy_only there are no constraints and no fM1 for subopt */
 
   int   i, j, k, length, energy;
   int   decomp, new_fML, max_separation;
   int   no_close, type, type_2, tt;
   int   bonus=0;
+  const paramT *P = ctx->P;
+  const int   *indx = ctx->indx, *BP = ctx->BP;
+  const int   *row = ctx->row, *col = ctx->col;
+  const char  *ptype = ctx->ptype;
+  const short *S1 = ctx->S1;
+  int   *c = ctx->c, *fML = ctx->fML, *fM1 = ctx->fM1, *f5 = ctx->f5;
+  int   *cc = ctx->cc, *cc1 = ctx->cc1, *Fmi = ctx->Fmi;
+  int   *DMLi = ctx->DMLi, *DMLi1 = ctx->DMLi1, *DMLi2 = ctx->DMLi2;
+  const int *cand, *cand_p = ctx->cand_p;
+  int   lo[MAXLOOP+2], hi[MAXLOOP+2]; /* cand[] of (p,minq..j-1), by p-i */
 
   length = (int) strlen(string);
+  make_candidates(ctx, length);
+  cand = ctx->cand;    /* may have moved */
 
   max_separation = (int) ((1.-LOCALITY)*(double)(length-2)); /* not in use */
 
   for (j=1; j<=length; j++) {
     Fmi[j]=DMLi[j]=DMLi1[j]=DMLi2[j]=INF;
   }
+  for (j=0; j<=length+1; j++) cc[j]=cc1[j]=0;
    
+  if (energy_only||!uniq_ML) fM1 = NULL;
+
   for (j = 1; j<=length; j++)
     for (i=(j>TURN?(j-TURN):1); i<j; i++) {
-      c[indx[j]+i] = fML[indx[j]+i] = INF;
-      if (uniq_ML) fM1[indx[j]+i] = INF;
+      c[CX(i,j)] = fML[indx[j]+i] = INF;
+      if (fM1!=NULL) fM1[indx[j]+i] = INF;
     }       
   
   for (i = length-TURN-1; i >= 1; i--) { /* i,j in [1..length] */
+    for (k = 1; (k <= MAXLOOP+1) && (i+k <= length); k++)
+      lo[k] = hi[k] = cand_p[i+k];
       
     for (j = i+TURN+1; j <= length; j++) {
-      int p, q, ij;
+      int p, q, ij, pij;
       ij = indx[j]+i;
+      pij = CX(i,j);
       bonus = 0;
-      type = ptype[ij];
+      type = ptype[pij];
 
       /* enforcing structure constraints */
-      if ((BP[i]==j)||(BP[i]==-1)||(BP[i]==-2)) bonus -= BONUS;
-      if ((BP[j]==-1)||(BP[j]==-3)) bonus -= BONUS;
-      if ((BP[i]==-4)||(BP[j]==-4)) type=0;
+      if (!energy_only) {
+	if ((BP[i]==j)||(BP[i]==-1)||(BP[i]==-2)) bonus -= BONUS;
+	if ((BP[j]==-1)||(BP[j]==-3)) bonus -= BONUS;
+	if ((BP[i]==-4)||(BP[j]==-4)) type=0;
+      }
 	 	 
       no_close = (((type==3)||(type==4))&&no_closingGU&&(bonus==0));
 		 
       if (j-i-1 > max_separation) type = 0;  /* forces locality degree */
 
       if (type) {   /* we have a pair */
-	int new_c=0, stackEnergy=INF;
+	int new_c=0, stackEnergy=INF, mm;
 	/* hairpin ----------------------------------------------*/
 	   
 	if (no_close) new_c = FORBIDDEN;
 	else
-	  new_c = HairpinE(j-i-1, type, S1[i+1], S1[j-1], string+i-1);
+	  new_c = HairpinE(P, j-i-1, type, S1[i+1], S1[j-1], string+i-1);
 	   
 	/*--------------------------------------------------------
 	  check for elementary structures involving more than one
 	  closing pair.
 	  --------------------------------------------------------*/
 	   
+	mm = P->mismatchI[type][S1[i+1]][S1[j-1]];
 	for (p = i+1; p <= MIN2(j-2-TURN,i+MAXLOOP+1) ; p++) {
-	  int minq = j-i+p-MAXLOOP-2;
+	  int minq = j-i+p-MAXLOOP-2, n1 = p-i-1, n2, l;
+	  const int *size_e = P->interior[n1];
 	  if (minq<p+1+TURN) minq = p+1+TURN;
-	  for (q = minq; q < j; q++) {
-	    type_2 = ptype[indx[q]+p];
-	       
-	    if (type_2==0) continue;
-	    type_2 = rtype[type_2];
+	  /* only the q that pair with p; minq and j grow with j */
+	  while ((lo[n1+1]<cand_p[p+1])&&(cand[lo[n1+1]]<minq)) lo[n1+1]++;
+	  while ((hi[n1+1]<cand_p[p+1])&&(cand[hi[n1+1]]<j)) hi[n1+1]++;
+	  for (l = lo[n1+1]; l < hi[n1+1]; l++) {
+	    q = cand[l];
+	    type_2 = rtype[(int) ptype[CX(p,q)]];
 
 	    if (no_closingGU) 
 	      if (no_close||(type_2==3)||(type_2==4))
 		if ((p>i+1)||(q<j-1)) continue;  /* continue unless stack */
 	       
-#if 1
-	    energy = LoopEnergy(p-i-1, j-q-1, type, type_2,
-				S1[i+1], S1[j-1], S1[p-1], S1[q+1]);
-#else
-	    /* duplicated code is faster than function call */
-	       
-#endif
-	    new_c = MIN2(energy+c[indx[q]+p], new_c);
+	    /* duplicated code is faster than function call: the generic
+	       interior loops of LoopEnergy() */
+	    n2 = j-q-1;
+	    if ((n1>0)&&(n2>0)&&((n1>2)||(n2>2)))
+	      energy = size_e[n2]+mm+P->mismatchI[type_2][S1[q+1]][S1[p-1]];
+	    else
+	      energy = LoopEnergy(P, n1, n2, type, type_2,
+				  S1[i+1], S1[j-1], S1[p-1], S1[q+1]);
+	    new_c = MIN2(energy+c[CX(p,q)], new_c);
 	    if ((p==i+1)&&(j==q+1)) stackEnergy = energy; /* remember stack energy */
 	       
 	  } /* end q-loop */
@@ -323,13 +556,13 @@ PRIVATE int fill_arrays(const char *string) {
 	if (dangles==3) {
 	  decomp = INF;
 	  for (k = i+2+TURN; k < j-2-TURN; k++) {
-	    type_2 = ptype[indx[k]+i+1]; type_2 = rtype[type_2]; 
+	    type_2 = ptype[CX(i+1,k)]; type_2 = rtype[type_2]; 
 	    if (type_2)
-	      decomp = MIN2(decomp, c[indx[k]+i+1]+P->stack[type][type_2]+
+	      decomp = MIN2(decomp, c[CX(i+1,k)]+P->stack[type][type_2]+
 			    fML[indx[j-1]+k+1]);
-	    type_2 = ptype[indx[j-1]+k+1]; type_2 = rtype[type_2]; 
+	    type_2 = ptype[CX(k+1,j-1)]; type_2 = rtype[type_2]; 
 	    if (type_2)
-	      decomp = MIN2(decomp, c[indx[j-1]+k+1]+P->stack[type][type_2]+
+	      decomp = MIN2(decomp, c[CX(k+1,j-1)]+P->stack[type][type_2]+
 			    fML[indx[k]+i+1]);
 	  }
 	  /* no TermAU penalty if coax stack */
@@ -340,13 +573,13 @@ PRIVATE int fill_arrays(const char *string) {
 	new_c = MIN2(new_c, cc1[j-1]+stackEnergy);
 	cc[j] = new_c + bonus;
 	if (noLonelyPairs)
-	  c[ij] = cc1[j-1]+stackEnergy+bonus;
+	  c[pij] = cc1[j-1]+stackEnergy+bonus;
 	else
-	  c[ij] = cc[j];
+	  c[pij] = cc[j];
 	   
       } /* end >> if (pair) << */
 	 
-      else c[ij] = INF;
+      else c[pij] = INF;
 
 
       /* done with c[i,j], now compute fML[i,j] */
@@ -354,24 +587,24 @@ PRIVATE int fill_arrays(const char *string) {
 
       new_fML = fML[ij+1]+P->MLbase;
       new_fML = MIN2(fML[indx[j-1]+i]+P->MLbase, new_fML);
-      energy = c[ij]+P->MLintern[type];
+      energy = c[pij]+P->MLintern[type];
       if (dangles==2) {  /* double dangles */
 	if (i>1)      energy += P->dangle5[type][S1[i-1]];
 	if (j<length) energy += P->dangle3[type][S1[j+1]];
       }
       new_fML = MIN2(energy, new_fML);
-      if (uniq_ML)
+      if (fM1!=NULL)
 	fM1[ij] = MIN2(fM1[indx[j-1]+i] + P->MLbase, energy);
 
       if (dangles%2==1) {  /* normal dangles */
-	tt = ptype[ij+1]; /* i+1,j */
-	new_fML = MIN2(c[ij+1]+P->dangle5[tt][S1[i]]
+	tt = ptype[CX(i+1,j)];
+	new_fML = MIN2(c[CX(i+1,j)]+P->dangle5[tt][S1[i]]
 		       +P->MLintern[tt]+P->MLbase,new_fML);
-	tt = ptype[indx[j-1]+i]; 
-	new_fML = MIN2(c[indx[j-1]+i]+P->dangle3[tt][S1[j]]
+	tt = ptype[CX(i,j-1)]; 
+	new_fML = MIN2(c[CX(i,j-1)]+P->dangle3[tt][S1[j]]
 		       +P->MLintern[tt]+P->MLbase, new_fML);
-	tt = ptype[indx[j-1]+i+1];
-	new_fML = MIN2(c[indx[j-1]+i+1]+P->dangle5[tt][S1[i]]+
+	tt = ptype[CX(i+1,j-1)];
+	new_fML = MIN2(c[CX(i+1,j-1)]+P->dangle5[tt][S1[i]]+
 		       P->dangle3[tt][S1[j]]+P->MLintern[tt]+2*P->MLbase, new_fML);
       }
       
@@ -387,11 +620,11 @@ PRIVATE int fill_arrays(const char *string) {
       if (dangles==3) { 
 	/* additional ML decomposition as two coaxially stacked helices */
 	for (decomp = INF, k = i+1+TURN; k <= j-2-TURN; k++) {
-	  type = ptype[indx[k]+i]; type = rtype[type];
-	  type_2 = ptype[indx[j]+k+1]; type_2 = rtype[type_2];
+	  type = ptype[CX(i,k)]; type = rtype[type];
+	  type_2 = ptype[CX(k+1,j)]; type_2 = rtype[type_2];
 	  if (type && type_2)
 	    decomp = MIN2(decomp, 
-			  c[indx[k]+i]+c[indx[j]+k+1]+P->stack[type][type_2]);
+			  c[CX(i,k)]+c[CX(k+1,j)]+P->stack[type][type_2]);
 	}
 
 	decomp += 2*P->MLintern[1];  	/* no TermAU penalty if coax stack */
@@ -423,24 +656,24 @@ PRIVATE int fill_arrays(const char *string) {
   f5[TURN+1]=0;
   for (j=TURN+2; j<=length; j++) {
     f5[j] = f5[j-1];
-    type=ptype[indx[j]+1];
+    type=ptype[CX(1,j)];
     if (type) {
-      energy = c[indx[j]+1];
+      energy = c[CX(1,j)];
       if (type>2) energy += P->TerminalAU;
       if ((dangles==2)&&(j<length))  /* double dangles */
 	energy += P->dangle3[type][S1[j+1]];
       f5[j] = MIN2(f5[j], energy);
     }
-    type=ptype[indx[j-1]+1];
+    type=ptype[CX(1,j-1)];
     if ((type)&&(dangles%2==1)) {
-      energy = c[indx[j-1]+1]+P->dangle3[type][S1[j]];
+      energy = c[CX(1,j-1)]+P->dangle3[type][S1[j]];
       if (type>2) energy += P->TerminalAU;
       f5[j] = MIN2(f5[j], energy);
     }
     for (i=j-TURN-1; i>1; i--) {
-      type = ptype[indx[j]+i];
+      type = ptype[CX(i,j)];
       if (type) {
-	energy = f5[i-1]+c[indx[j]+i];
+	energy = f5[i-1]+c[CX(i,j)];
 	if (type>2) energy += P->TerminalAU;
 	if (dangles==2) {
 	  energy += P->dangle5[type][S1[i-1]];
@@ -448,14 +681,14 @@ PRIVATE int fill_arrays(const char *string) {
 	}
 	f5[j] = MIN2(f5[j], energy);
 	if (dangles%2==1) {
-	  energy = f5[i-2]+c[indx[j]+i]+P->dangle5[type][S1[i-1]];
+	  energy = f5[i-2]+c[CX(i,j)]+P->dangle5[type][S1[i-1]];
 	  if (type>2) energy += P->TerminalAU;
 	  f5[j] = MIN2(f5[j], energy);
 	}
       }
-      type = ptype[indx[j-1]+i];
+      type = ptype[CX(i,j-1)];
       if ((type)&&(dangles%2==1)) {
-	energy = c[indx[j-1]+i]+P->dangle3[type][S1[j]];
+	energy = c[CX(i,j-1)]+P->dangle3[type][S1[j]];
 	if (type>2) energy += P->TerminalAU;
 	f5[j] = MIN2(f5[j], f5[i-1]+energy);
 	f5[j] = MIN2(f5[j], f5[i-2]+energy+P->dangle5[type][S1[i-1]]);
@@ -466,7 +699,7 @@ PRIVATE int fill_arrays(const char *string) {
   return f5[length];
 }
 
-PRIVATE void backtrack(const char *string) {
+PRIVATE void backtrack(fold_ctx *ctx, const char *string) {
    
   /*------------------------------------------------------------------
     trace back through the "c", "f5" and "fML" arrays to get the
@@ -484,6 +717,13 @@ PRIVATE void backtrack(const char *string) {
   int   no_close, type, type_2, tt;
   int   bonus;
   int   s=0, b=0;
+  const paramT *P = ctx->P;
+  const int   *indx = ctx->indx, *BP = ctx->BP;
+  const int   *row = ctx->row, *col = ctx->col;
+  const char  *ptype = ctx->ptype;
+  const short *S1 = ctx->S1;
+  const int   *c = ctx->c, *fML = ctx->fML, *f5 = ctx->f5;
+  bondT *bp = ctx->base_pair;
 
   length = strlen(string);
   sector[++s].i = 1;
@@ -498,8 +738,8 @@ PRIVATE void backtrack(const char *string) {
     ml = sector[s--].ml;   /* ml is a flag indicating if backtracking is to 
 			      occur in the fML- (1) or in the f-array (0) */
     if (ml==2) {
-      base_pair[++b].i = i;
-      base_pair[b].j   = j;
+      bp[++b].i = i;
+      bp[b].j   = j;
       goto repeat1; 
     }
 
@@ -520,9 +760,9 @@ PRIVATE void backtrack(const char *string) {
       for (k=j-TURN-1,traced=0; k>=1; k--) {
 	int cc, en;
 	jj = k-1; 
-	type = ptype[indx[j-1]+k];
+	type = ptype[CX(k,j-1)];
 	if((type)&&(dangles%2==1)) {
-	  cc = c[indx[j-1]+k]+P->dangle3[type][S1[j]];
+	  cc = c[CX(k,j-1)]+P->dangle3[type][S1[j]];
 	  if (type>2) cc += P->TerminalAU;
 	  if (fij == cc + f5[k-1]) 
 	    traced=j-1;
@@ -531,9 +771,9 @@ PRIVATE void backtrack(const char *string) {
 	      traced=j-1; jj=k-2;
 	    }
 	}
-	type = ptype[indx[j]+k];
+	type = ptype[CX(k,j)];
 	if (type) {
-	  cc = c[indx[j]+k];
+	  cc = c[CX(k,j)];
 	  if (type>2) cc += P->TerminalAU; 
 	  en = cc + f5[k-1];
 	  if (dangles==2) {
@@ -555,8 +795,8 @@ PRIVATE void backtrack(const char *string) {
       sector[s].ml  = ml;
        
       i=k; j=traced;
-      base_pair[++b].i = i;
-      base_pair[b].j   = j;
+      bp[++b].i = i;
+      bp[b].j   = j;
       goto repeat1;
     }
     else { /* trace back in fML array */
@@ -568,19 +808,19 @@ PRIVATE void backtrack(const char *string) {
 	continue;
       } 
 
-      tt  = ptype[indx[j]+i];
-      cij = c[indx[j]+i] + P->MLintern[tt];
+      tt  = ptype[CX(i,j)];
+      cij = c[CX(i,j)] + P->MLintern[tt];
       if (dangles==2) {       /* double dangles */
 	if (i>1)      cij += P->dangle5[tt][S1[i-1]];
 	if (j<length) cij += P->dangle3[tt][S1[j+1]];
       }
       else if (dangles%2==1) {  /* normal dangles */
-	tt = ptype[indx[j]+i+1];
-	ci1j= c[indx[j]+i+1] + P->dangle5[tt][S1[i]] + P->MLintern[tt]+P->MLbase;
-	tt = ptype[indx[j-1]+i];
-	cij1= c[indx[j-1]+i] + P->dangle3[tt][S1[j]] + P->MLintern[tt]+P->MLbase;
-	tt = ptype[indx[j-1]+i+1];
-	ci1j1=c[indx[j-1]+i+1] + P->dangle5[tt][S1[i]] + P->dangle3[tt][S1[j]]
+	tt = ptype[CX(i+1,j)];
+	ci1j= c[CX(i+1,j)] + P->dangle5[tt][S1[i]] + P->MLintern[tt]+P->MLbase;
+	tt = ptype[CX(i,j-1)];
+	cij1= c[CX(i,j-1)] + P->dangle3[tt][S1[j]] + P->MLintern[tt]+P->MLbase;
+	tt = ptype[CX(i+1,j-1)];
+	ci1j1=c[CX(i+1,j-1)] + P->dangle5[tt][S1[i]] + P->dangle3[tt][S1[j]]
 	  +  P->MLintern[tt] + 2*P->MLbase;
       }
        
@@ -589,8 +829,8 @@ PRIVATE void backtrack(const char *string) {
 	if (fij==ci1j) i++;
 	else if (fij==cij1) j--;
 	else if (fij==ci1j1) {i++; j--;}
-	base_pair[++b].i = i;
-	base_pair[b].j   = j;
+	bp[++b].i = i;
+	bp[b].j   = j;
 	goto repeat1;
       } 
        
@@ -601,10 +841,10 @@ PRIVATE void backtrack(const char *string) {
       if ((dangles==3)&&(k>j-2-TURN)) { /* must be coax stack */
 	ml = 2;
 	for (k = i+1+TURN; k <= j-2-TURN; k++) {
-	  type = ptype[indx[k]+i];  type= rtype[type]; 
-	  type_2 = ptype[indx[j]+k+1]; type_2= rtype[type_2];
+	  type = ptype[CX(i,k)];  type= rtype[type]; 
+	  type_2 = ptype[CX(k+1,j)]; type_2= rtype[type_2];
 	  if (type && type_2)
-	    if (fij == c[indx[k]+i]+c[indx[j]+k+1]+P->stack[type][type_2]+
+	    if (fij == c[CX(i,k)]+c[CX(k+1,j)]+P->stack[type][type_2]+
 		       2*P->MLintern[1])
 	      break;
 	}
@@ -624,9 +864,9 @@ PRIVATE void backtrack(const char *string) {
   repeat1:
       
     /*----- begin of "repeat:" -----*/
-    if (canonical)  cij = c[indx[j]+i];
+    if (canonical)  cij = c[CX(i,j)];
      
-    type = ptype[indx[j]+i];
+    type = ptype[CX(i,j)];
      
     bonus = 0;
      
@@ -634,13 +874,13 @@ PRIVATE void backtrack(const char *string) {
     if ((BP[j]==-1)||(BP[j]==-3)) bonus -= BONUS;
      
     if (noLonelyPairs) 
-      if (cij == c[indx[j]+i]) {
+      if (cij == c[CX(i,j)]) {
 	/* (i.j) closes canonical structures, thus
 	   (i+1.j-1) must be a pair                */
-	type_2 = ptype[indx[j-1]+i+1]; type_2 = rtype[type_2];
+	type_2 = ptype[CX(i+1,j-1)]; type_2 = rtype[type_2];
 	cij -= P->stack[type][type_2] + bonus;
-	base_pair[++b].i = i+1;
-	base_pair[b].j   = j-1;
+	bp[++b].i = i+1;
+	bp[b].j   = j-1;
 	i++; j--;
 	canonical=0;
 	goto repeat1;
@@ -652,7 +892,7 @@ PRIVATE void backtrack(const char *string) {
     if (no_close) {
       if (cij == FORBIDDEN) continue;
     } else
-      if (cij == HairpinE(j-i-1, type, S1[i+1], S1[j-1],string+i-1)+bonus)
+      if (cij == HairpinE(P, j-i-1, type, S1[i+1], S1[j-1],string+i-1)+bonus)
 	continue;
      
     for (p = i+1; p <= MIN2(j-2-TURN,i+MAXLOOP+1); p++) {
@@ -661,7 +901,7 @@ PRIVATE void backtrack(const char *string) {
       if (minq<p+1+TURN) minq = p+1+TURN;
       for (q = j-1; q >= minq; q--) {
 	 
-	type_2 = ptype[indx[q]+p];
+	type_2 = ptype[CX(p,q)];
 	if (type_2==0) continue;
 	type_2 = rtype[type_2]; 
 	if (no_closingGU) 
@@ -669,14 +909,14 @@ PRIVATE void backtrack(const char *string) {
 	    if ((p>i+1)||(q<j-1)) continue;  /* continue unless stack */
 	 
 	/* energy = oldLoopEnergy(i, j, p, q, type, type_2); */
-	energy = LoopEnergy(p-i-1, j-q-1, type, type_2,
+	energy = LoopEnergy(P, p-i-1, j-q-1, type, type_2,
 			    S1[i+1], S1[j-1], S1[p-1], S1[q+1]);
 	 
-	new = energy+c[indx[q]+p]+bonus;
+	new = energy+c[CX(p,q)]+bonus;
 	traced = (cij == new);
 	if (traced) {
-	  base_pair[++b].i = p;
-	  base_pair[b].j   = q;
+	  bp[++b].i = p;
+	  bp[b].j   = q;
 	  i = p, j = q;
 	  goto repeat1;
 	}
@@ -717,18 +957,18 @@ PRIVATE void backtrack(const char *string) {
       /* coaxial stacking of (i.j) with (i+1.k) or (k.j-1) */
       /* use MLintern[1] since coax stacked pairs don't get TerminalAU */
       if (dangles==3) {
-	type_2 = ptype[indx[k]+i+1]; type_2 = rtype[type_2];
+	type_2 = ptype[CX(i+1,k)]; type_2 = rtype[type_2];
 	if (type_2) {
-	  en = c[indx[k]+i+1]+P->stack[type][type_2]+fML[indx[j-1]+k+1];
+	  en = c[CX(i+1,k)]+P->stack[type][type_2]+fML[indx[j-1]+k+1];
 	  if (cij == en+2*P->MLintern[1]+P->MLclosing) {
 	    ml = 2;
 	    sector[s+1].ml  = 2;
 	    break;
 	  }
 	}
-	type_2 = ptype[indx[j-1]+k+1]; type_2 = rtype[type_2];
+	type_2 = ptype[CX(k+1,j-1)]; type_2 = rtype[type_2];
 	if (type_2) {
-	  en = c[indx[j-1]+k+1]+P->stack[type][type_2]+fML[indx[k]+i+1];
+	  en = c[CX(k+1,j-1)]+P->stack[type][type_2]+fML[indx[k]+i+1];
 	  if (cij == en+2*P->MLintern[1]+P->MLclosing) {
 	    sector[s+2].ml = 2;
 	    break;
@@ -768,27 +1008,37 @@ PRIVATE void backtrack(const char *string) {
      
   }
 
-  base_pair[0].i = b;    /* save the total number of base pairs */
+  bp[0].i = b;    /* save the total number of base pairs */
 }
 
 /*---------------------------------------------------------------------------*/
 
-inline int HairpinE(int size, int type, int si1, int sj1, const char *string) {
+inline int HairpinE(const paramT *P, int size, int type, int si1, int sj1, const char *string) {
   int energy;
   energy = (size <= 30) ? P->hairpin[size] :
     P->hairpin[30]+(int)(P->lxc*log((size)/30.));
   if (tetra_loop)
     if (size == 4) { /* check for tetraloop bonus */
-      char tl[7]={0}, *ts;
-      strncpy(tl, string, 6);
-      if ((ts=strstr(P->Tetraloops, tl))) 
-	energy += P->TETRA_ENERGY[(ts - P->Tetraloops)/7];
+      if (P->loop_codes) {
+	int code = loop_code(string, 6);
+	if (code>=0) energy += P->tetra_bonus[code];
+      } else {
+	char tl[7]={0}, *ts;
+	strncpy(tl, string, 6);
+	if ((ts=strstr(P->Tetraloops, tl))) 
+	  energy += P->TETRA_ENERGY[(ts - P->Tetraloops)/7];
+      }
     }
   if (size == 3) {
-    char tl[6]={0,0,0,0,0,0}, *ts;
-    strncpy(tl, string, 5);
-    if ((ts=strstr(P->Triloops, tl))) 
-      energy += P->Triloop_E[(ts - P->Triloops)/6];
+    if (P->loop_codes) {
+      int code = loop_code(string, 5);
+      if (code>=0) energy += P->tri_bonus[code];
+    } else {
+      char tl[6]={0,0,0,0,0,0}, *ts;
+      strncpy(tl, string, 5);
+      if ((ts=strstr(P->Triloops, tl))) 
+	energy += P->Triloop_E[(ts - P->Triloops)/6];
+    }
     
     if (type>2)  /* neither CG nor GC */
       energy += P->TerminalAU; /* penalty for closing AU GU pair */
@@ -843,7 +1093,7 @@ inline PRIVATE int oldLoopEnergy(int i, int j, int p, int q, int type, int type_
 
 /*--------------------------------------------------------------------------*/
 
-inline int LoopEnergy(int n1, int n2, int type, int type_2,
+inline int LoopEnergy(const paramT *P, int n1, int n2, int type, int type_2,
 		      int si1, int sj1, int sp1, int sq1) {
   /* compute energy of degree 2 loop (stack bulge or interior) */
   int nl, ns, energy;
@@ -855,7 +1105,7 @@ inline int LoopEnergy(int n1, int n2, int type, int type_2,
     return P->stack[type][type_2];    /* stack */
 
   if (ns==0) {                       /* bulge */
-    energy = (nl<=MAXLOOP)?P->bulge[nl]:
+    energy = (nl<=MAXLOOP)?P->interior[n1][n2]:
       (P->bulge[30]+(int)(P->lxc*log(nl/30.)));
     if (nl==1) energy += P->stack[type][type_2];
     else {
@@ -879,10 +1129,12 @@ inline int LoopEnergy(int n1, int n2, int type, int type_2,
     else if (n1==2 && n2==2)         /* 2x2 loop */
       return P->int22[type][type_2][si1][sp1][sq1][sj1];
     { /* generic interior loop (no else here!)*/
-      energy = (n1+n2<=MAXLOOP)?(P->internal_loop[n1+n2]):
-	(P->internal_loop[30]+(int)(P->lxc*log((n1+n2)/30.)));
-      
-      energy += MIN2(MAX_NINIO, (nl-ns)*P->F_ninio[2]);
+      if (nl<=MAXLOOP)
+	energy = P->interior[n1][n2];
+      else {
+	energy = P->internal_loop[30]+(int)(P->lxc*log((n1+n2)/30.));
+	energy += MIN2(MAX_NINIO, (nl-ns)*P->F_ninio[2]);
+      }
       
       energy += P->mismatchI[type][si1][sj1]+
 	P->mismatchI[type_2][sq1][sp1];
@@ -894,12 +1146,10 @@ inline int LoopEnergy(int n1, int n2, int type, int type_2,
 
 /*---------------------------------------------------------------------------*/
 
-PRIVATE void encode_seq(const char *sequence) {
+PRIVATE void encode_seq(const char *sequence, short *S, short *S1) {
   unsigned int i,l;
 
   l = strlen(sequence);
-  S = (short *) space(sizeof(short)*(l+1));
-  S1= (short *) space(sizeof(short)*(l+1));
   /* S1 exists only for the special X K and I bases and energy_set!=0 */
   S[0] = S1[0] = (short) l;
   
@@ -911,16 +1161,16 @@ PRIVATE void encode_seq(const char *sequence) {
 
 /*---------------------------------------------------------------------------*/
 
-PRIVATE void letter_structure(char *structure, int length)
+PRIVATE void letter_structure(const bondT *bp, char *structure, int length)
 {
   int n, k, x, y;
   
   for (n = 0; n <= length-1; structure[n++] = ' ') ;
   structure[length] = '\0';
   
-  for (n = 0, k = 1; k <= base_pair[0].i; k++) {
-    y = base_pair[k].j;
-    x = base_pair[k].i;
+  for (n = 0, k = 1; k <= bp[0].i; k++) {
+    y = bp[k].j;
+    x = bp[k].i;
     if (x-1 > 0 && y+1 <= length) {
       if (structure[x-2] != ' ' && structure[y] == structure[x-2]) {
 	structure[x-1] = structure[x-2];
@@ -941,44 +1191,51 @@ PRIVATE void letter_structure(char *structure, int length)
 
 /*---------------------------------------------------------------------------*/
 
-PRIVATE void parenthesis_structure(char *structure, int length)
+PRIVATE void parenthesis_structure(const bondT *bp, char *structure, int length)
 {
   int n, k;
   
   for (n = 0; n <= length-1; structure[n++] = '.') ;
   structure[length] = '\0';
 
-  for (k = 1; k <= base_pair[0].i; k++) {
-    structure[base_pair[k].i-1] = '(';
-    structure[base_pair[k].j-1] = ')';
+  for (k = 1; k <= bp[0].i; k++) {
+    structure[bp[k].i-1] = '(';
+    structure[bp[k].j-1] = ')';
   }
 }
 /*---------------------------------------------------------------------------*/
 	   
 PUBLIC void update_fold_params(void)
 {
-  P = scale_parameters();
+  /* e.g. after read_parameter_file(): the contexts of all threads and
+     energy_of_struct() take freshly scaled sets from now on */
+  new_scaled_parameters();
+  P = get_scaled_parameters();
   make_pair_matrix();
-  if (init_length < 0) init_length=0;
+  if (default_ctx!=NULL) default_ctx->P = P;
 }
 
 /*---------------------------------------------------------------------------*/
-PRIVATE short  *pair_table;
+PRIVATE THREAD_LOCAL short  *pair_table;
 
 float energy_of_struct(const char *string, const char *structure)
 {
   int   energy;
   short *ss, *ss1;
 
-  if ((init_length<0)||(P==NULL)) update_fold_params();
-  if (fabs(P->temperature - temperature)>1e-6) update_fold_params();
+  if ((P==NULL)||!scaled_parameters_current(P)) {
+    P = get_scaled_parameters();
+    make_pair_matrix();
+  }
 
   if (strlen(structure)!=strlen(string))
     nrerror("energy_of_struct: string and structure have unequal length");
 
   /* save the S and S1 pointers in case they were already in use */
   ss = S; ss1 = S1;
-  encode_seq(string);
+  S = (short *) space(sizeof(short)*(strlen(string)+1));
+  S1= (short *) space(sizeof(short)*(strlen(string)+1));
+  encode_seq(string, S, S1);
    
   pair_table = make_pair_table(structure);
 
@@ -1045,7 +1302,7 @@ PRIVATE int stack_energy(int i, const char *string)
     }
     /* energy += LoopEnergy(i, j, p, q, type, type_2); */
     if ( SAME_STRAND(i,p) && SAME_STRAND(q,j) )
-      ee = LoopEnergy(p-i-1, j-q-1, type, type_2,
+      ee = LoopEnergy(P, p-i-1, j-q-1, type, type_2,
 		      S1[i+1], S1[j-1], S1[p-1], S1[q+1]);
     else 
       ee = ML_Energy(cut_in_loop(i), 1);
@@ -1060,7 +1317,7 @@ PRIVATE int stack_energy(int i, const char *string)
   
   if (p>q) {                       /* hair pin */
     if (SAME_STRAND(i,j))
-      ee = HairpinE(j-i-1, type, S1[i+1], S1[j-1], string+i-1);
+      ee = HairpinE(P, j-i-1, type, S1[i+1], S1[j-1], string+i-1);
     else
       ee = ML_Energy(cut_in_loop(i), 1);
     energy += ee;
@@ -1245,8 +1502,11 @@ PRIVATE int cut_in_loop(int i) {
 
 /*---------------------------------------------------------------------------*/
 
-PRIVATE void make_ptypes(const short *S, const char *structure) {
+PRIVATE void make_ptypes(fold_ctx *ctx, const short *S, const char *structure) {
   int n,i,j,k,l;
+  const int *row = ctx->row, *col = ctx->col;
+  char *ptype = ctx->ptype;
+  int  *BP = ctx->BP;
   
   n=S[0];
   for (k=1; k<n-TURN; k++) 
@@ -1258,7 +1518,7 @@ PRIVATE void make_ptypes(const short *S, const char *structure) {
         if ((i>1)&&(j<n)) ntype = pair[S[i-1]][S[j+1]];
         if (noLonelyPairs && (!otype) && (!ntype)) 
           type = 0; /* i.j can only form isolated pairs */
-        ptype[indx[j]+i] = (char) type;
+        ptype[CX(i,j)] = (char) type;
         otype =  type;
         type  = ntype;
         i--; j++;
@@ -1274,14 +1534,14 @@ PRIVATE void make_ptypes(const short *S, const char *structure) {
       switch (structure[j-1]) {
       case '|': BP[j] = -1; break;
       case 'x': /* can't pair */ 
-        for (l=1; l<j-TURN; l++) ptype[indx[j]+l] = 0;
-        for (l=j+TURN+1; l<=n; l++) ptype[indx[l]+j] = 0;
+        for (l=1; l<j-TURN; l++) ptype[CX(l,j)] = 0;
+        for (l=j+TURN+1; l<=n; l++) ptype[CX(j,l)] = 0;
         break;
       case '(':
         stack[hx++]=j;
         /* fallthrough */
       case '<': /* pairs upstream */
-        for (l=1; l<j-TURN; l++) ptype[indx[j]+l] = 0;
+        for (l=1; l<j-TURN; l++) ptype[CX(l,j)] = 0;
         break;
       case ')':
         if (hx<=0) {
@@ -1289,19 +1549,19 @@ PRIVATE void make_ptypes(const short *S, const char *structure) {
           nrerror("unbalanced brackets in constraints");
         }
         i = stack[--hx];
-        type = ptype[indx[j]+i];
-	for (k=i+1; k<=n; k++) ptype[indx[k]+i] = 0;
+        type = ptype[CX(i,j)];
+	for (k=i+1; k<=n; k++) ptype[CX(i,k)] = 0;
 	/* don't allow pairs i<k<j<l */
         for (l=j; l<=n; l++)
-	  for (k=i+1; k<=j; k++) ptype[indx[l]+k] = 0;
+	  for (k=i+1; k<=j; k++) ptype[CX(k,l)] = 0;
 	/* don't allow pairs k<i<l<j */
 	for (l=i; l<=j; l++)
-	  for (k=1; k<=i; k++) ptype[indx[l]+k] = 0;
-	for (k=1; k<j; k++) ptype[indx[j]+k] = 0;
-        ptype[indx[j]+i] = (type==0)?7:type;
+	  for (k=1; k<=i; k++) ptype[CX(k,l)] = 0;
+	for (k=1; k<j; k++) ptype[CX(k,j)] = 0;
+        ptype[CX(i,j)] = (type==0)?7:type;
         /* fallthrough */
       case '>': /* pairs downstream */
-        for (l=j+TURN+1; l<=n; l++) ptype[indx[l]+j] = 0;
+        for (l=j+TURN+1; l<=n; l++) ptype[CX(j,l)] = 0;
         break;
       }
     }
@@ -1312,3 +1572,26 @@ PRIVATE void make_ptypes(const short *S, const char *structure) {
     free(stack);
   }
 }
+
+/*---------------------------------------------------------------------------*/
+
+PRIVATE void make_candidates(fold_ctx *ctx, int length) {
+  /* the pairs (p,q) of ptype[] row by row, so that the interior loops of
+     fill_arrays() go over pairs only and skip the empty (p,q) */
+  const int *row = ctx->row, *col = ctx->col;
+  const char *ptype = ctx->ptype;
+  int p, q, n;
+
+  for (n=0, p=1; p<=length; p++) {
+    ctx->cand_p[p] = n;
+    for (q=p+TURN+1; q<=length; q++)
+      if (ptype[CX(p,q)]) {
+	if (n==ctx->cand_size) {
+	  ctx->cand_size *= 2;
+	  ctx->cand = (int *) xrealloc(ctx->cand, sizeof(int)*ctx->cand_size);
+	}
+	ctx->cand[n++] = q;
+      }
+  }
+  ctx->cand_p[length+1] = n;
+}
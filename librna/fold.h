@@ -1,8 +1,33 @@
 /* function from fold.c */
 extern float  fold(const char *sequence, char *structure); 
 /* calculate mfe-structure of sequence */
+typedef struct fold_ctx fold_ctx;
+/* workspace of one mfe folding; fold() uses a default one per thread,
+   but also fills the global base_pair, so threads call fold_r() */
+extern fold_ctx *fold_ctx_create(int length); /* arrays for up to length nt */
+extern float  fold_r(fold_ctx *ctx, const char *sequence, char *structure);
+/* reentrant fold(), arrays of ctx are enlarged as needed */
+extern float  fold_energy_only(fold_ctx *ctx, const char *sequence);
+/* mfe only, without structure and constraints; ctx==NULL: default one */
+extern void   fold_ctx_destroy(fold_ctx *ctx);
 extern float  energy_of_struct(const char *string, const char *structure);
 /* calculate energy of string on structure */
 extern void   free_arrays(void);           /* free arrays for mfe folding */
+extern void   free_fold_workspaces(void);  /* free everything at the end */
 extern void   initialize_fold(int length); /* allocate arrays for folding */
 extern void   update_fold_params(void);    /* recalculate parameters */
+extern int    row_major_dp;  /* keep c[] and pair types of fold() and alifold()
+				by rows instead of columns (default 0) */
+extern void   dp_layout(int size, int row_major, int *row, int *col);
+/* (i,j) is at row[i]+col[j] in that layout */
+
+/* function from fold_batch.c */
+#define FOLD_BATCH 8    /* sequences folded together */
+typedef struct fold_batch_ctx fold_batch_ctx;
+extern fold_batch_ctx *fold_batch_ctx_create(int length);
+extern void   fold_batch_energies(fold_batch_ctx *ctx, const char **sequences,
+				  int n, float *energies);
+/* fold_energy_only() of n<=FOLD_BATCH sequences of the same length */
+extern void   fold_batch_ctx_destroy(fold_batch_ctx *ctx);
+extern int    fold_batch_simd; /* 0: contexts made from now on use the
+				  generic kernels only (default 1) */
@@ -0,0 +1,593 @@
+/*
+		  minimum free energy of several sequences
+		  of the same length folded in lockstep
+
+		  The sequences go through the recursions of
+		  fill_arrays() in fold.c together, every array
+		  holds the FOLD_BATCH entries of one cell next to
+		  each other. Loops over (i,j,p,q) are the same for
+		  all sequences, only pair types and energies
+		  differ, so the minima are taken over all lanes at
+		  once. Energies are integers, the results are the
+		  same as from fold_energy_only().
+
+		  Generic interior loops and bulges are the bulk of
+		  the work. Their energy is a term of the loop size,
+		  a term of the closing pair and one of the inner
+		  pair (mismatches or AU penalties). The last one is
+		  added to c[] when a cell is done (cm[] and cb[]
+		  below), so each candidate is one load and two adds.
+*/
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <ctype.h>
+#include <string.h>
+#include "utils.h"
+#include "energy_par.h"
+#include "fold_vars.h"
+#include "pair_mat.h"
+#include "params.h"
+#include "fold.h"
+
+#ifdef HAVE_SIMD_DISPATCH
+#include <immintrin.h>
+#endif
+
+#define PUBLIC
+#define PRIVATE static
+
+PUBLIC int fold_batch_simd=1;  /* use the AVX2 kernels where the CPU has them */
+
+#define LANES FOLD_BATCH
+#define MIN2(A, B)      ((A) < (B) ? (A) : (B))
+/* the lanes of entry k of an array */
+#define AT(A, k)        ((A)+(size_t)(k)*LANES)
+
+extern int  LoopEnergy(const paramT *P, int n1, int n2, int type, int type_2,
+		       int si1, int sj1, int sp1, int sq1);
+extern int  HairpinE(const paramT *P, int size, int type, int si1, int sj1,
+		     const char *string);
+
+/* minima over interior loops and the multi-loop decomposition, see
+   below */
+typedef void (*row_run_fn)(const int *X, const int *indx, int p, int j,
+			   int qlo, int qhi, const int *s, const int *m,
+			   int *best);
+typedef void (*col_run_fn)(const int *X, int cell, int klo, int khi,
+			   const int *s, const int *m, int *best);
+typedef void (*ml_decomp_fn)(const int *Fmi, const int *fML, int cell,
+			     int klo, int khi, int *best);
+
+struct fold_batch_ctx {
+  const paramT *P;   /* scaled energy parameters, shared */
+  int   length;      /* arrays are allocated for sequences up to length */
+  int   *indx;       /* index of the triangle matrices, as in fold.c */
+  int   *c;          /* energy given that i-j pair */
+  int   *cm;         /* c[] plus the mismatch of i-j as inner pair of
+			an interior loop, INF if i,j can't pair */
+  int   *cb;         /* c[] plus the AU penalty of i-j as inner pair of
+			a bulge, INF if i,j can't pair */
+  int   *fML;        /* multi-loop auxiliary energy array */
+  int   *f5;         /* energy of 5' end */
+  int   *cc, *cc1;   /* linear arrays for canonical structures */
+  int   *Fmi, *DMLi, *DMLi1, *DMLi2;
+  char  *ptype;      /* pair types */
+  short *S, *S1;     /* encoded sequences */
+  row_run_fn row_run;  /* kernels for the CPU we run on */
+  col_run_fn col_run;
+  ml_decomp_fn ml_decomp;
+};
+
+PRIVATE void select_kernels(fold_batch_ctx *ctx);
+
+PRIVATE void get_arrays(fold_batch_ctx *ctx, unsigned int size)
+{
+  unsigned int n;
+  size_t cells = (size*(size+1))/2+2;
+
+  ctx->indx  = (int *) space(sizeof(int)*(size+1));
+  ctx->c     = (int *) space(sizeof(int)*LANES*cells);
+  ctx->cm    = (int *) space(sizeof(int)*LANES*cells);
+  ctx->cb    = (int *) space(sizeof(int)*LANES*cells);
+  ctx->fML   = (int *) space(sizeof(int)*LANES*cells);
+  ctx->ptype = (char *) space(sizeof(char)*LANES*cells);
+  ctx->f5    = (int *) space(sizeof(int)*LANES*(size+2));
+  ctx->cc    = (int *) space(sizeof(int)*LANES*(size+2));
+  ctx->cc1   = (int *) space(sizeof(int)*LANES*(size+2));
+  ctx->Fmi   = (int *) space(sizeof(int)*LANES*(size+1));
+  ctx->DMLi  = (int *) space(sizeof(int)*LANES*(size+1));
+  ctx->DMLi1 = (int *) space(sizeof(int)*LANES*(size+1));
+  ctx->DMLi2 = (int *) space(sizeof(int)*LANES*(size+1));
+  ctx->S     = (short *) space(sizeof(short)*LANES*(size+2));
+  ctx->S1    = (short *) space(sizeof(short)*LANES*(size+2));
+
+  for (n = 1; n <= size; n++)
+    ctx->indx[n] = (n*(n-1)) >> 1;        /* n(n-1)/2 */
+  ctx->length = (int) size;
+}
+
+PRIVATE void release_arrays(fold_batch_ctx *ctx)
+{
+  free(ctx->indx); free(ctx->c); free(ctx->cm); free(ctx->cb); free(ctx->fML);
+  free(ctx->ptype); free(ctx->f5); free(ctx->cc); free(ctx->cc1);
+  free(ctx->Fmi); free(ctx->DMLi); free(ctx->DMLi1); free(ctx->DMLi2);
+  free(ctx->S); free(ctx->S1);
+  ctx->length = 0;
+}
+
+/*--------------------------------------------------------------------------*/
+
+PUBLIC fold_batch_ctx *fold_batch_ctx_create(int length)
+{
+  fold_batch_ctx *ctx;
+
+  ctx = (fold_batch_ctx *) space(sizeof(fold_batch_ctx));
+  ctx->P = get_scaled_parameters();
+  select_kernels(ctx);
+  if (length>0) get_arrays(ctx, (unsigned) length);
+  return ctx;
+}
+
+PUBLIC void fold_batch_ctx_destroy(fold_batch_ctx *ctx)
+{
+  if (ctx==NULL) return;
+  if (ctx->length>0) release_arrays(ctx);
+  free(ctx);
+}
+
+/*--------------------------------------------------------------------------*/
+
+PRIVATE void encode_lane(fold_batch_ctx *ctx, int l, const char *sequence,
+			 int length)
+{
+  int i;
+
+  AT(ctx->S, 0)[l] = AT(ctx->S1, 0)[l] = (short) length;
+  for (i=1; i<=length; i++) {
+    AT(ctx->S, i)[l] = (short) encode_char(toupper(sequence[i-1]));
+    AT(ctx->S1, i)[l] = alias[AT(ctx->S, i)[l]];
+  }
+}
+
+/* pair types of one lane, make_ptypes() without constraints */
+PRIVATE void make_ptypes_lane(fold_batch_ctx *ctx, int l, int n)
+{
+  int i,j,k,m;
+  const int *indx = ctx->indx;
+
+  for (k=1; k<n-TURN; k++)
+    for (m=1; m<=2; m++) {
+      int type,ntype=0,otype=0;
+      i=k; j = i+TURN+m; if (j>n) continue;
+      type = pair[AT(ctx->S, i)[l]][AT(ctx->S, j)[l]];
+      while ((i>=1)&&(j<=n)) {
+	if ((i>1)&&(j<n)) ntype = pair[AT(ctx->S, i-1)[l]][AT(ctx->S, j+1)[l]];
+	if (noLonelyPairs && (!otype) && (!ntype))
+	  type = 0; /* i.j can only form isolated pairs */
+	AT(ctx->ptype, indx[j]+i)[l] = (char) type;
+	otype =  type;
+	type  = ntype;
+	i--; j++;
+      }
+    }
+}
+
+/*--------------------------------------------------------------------------*/
+
+/* The interior loops closed by (i,j) whose inner pairs (p,q) are in
+   row p, qlo<=q<=qhi: best = MIN(best, X[p,q] + m + s[j-q-1]). X holds
+   c plus the part of the energy that depends on (p,q) only, m the part
+   that depends on (i,j) only and s the part of the loop size. */
+
+PRIVATE void row_run_generic(const int *X, const int *indx, int p, int j,
+			     int qlo, int qhi, const int *s, const int *m,
+			     int *best)
+{
+  const int *x;
+  int q, l;
+
+  for (q = qlo; q <= qhi; q++) {
+    x = AT(X, indx[q]+p);
+    for (l=0; l<LANES; l++)
+      best[l] = MIN2(best[l], x[l]+m[l]+s[j-q-1]);
+  }
+}
+
+/* The same for the cells klo..khi of one column, which follow each
+   other: best = MIN(best, X[cell+k] + m + s[k-klo]) */
+
+PRIVATE void col_run_generic(const int *X, int cell, int klo, int khi,
+			     const int *s, const int *m, int *best)
+{
+  const int *x;
+  int k, l;
+
+  for (k = klo; k <= khi; k++) {
+    x = AT(X, cell+k);
+    for (l=0; l<LANES; l++)
+      best[l] = MIN2(best[l], x[l]+m[l]+s[k-klo]);
+  }
+}
+
+/* best = MIN(best, Fmi[k]+fML[cell+k]) for klo<=k<=khi */
+
+PRIVATE void ml_decomp_generic(const int *Fmi, const int *fML, int cell,
+			       int klo, int khi, int *best)
+{
+  const int *f, *m;
+  int k, l;
+
+  for (k = klo; k <= khi; k++) {
+    f = AT(Fmi, k);
+    m = AT(fML, cell+k);
+    for (l=0; l<LANES; l++)
+      best[l] = MIN2(best[l], f[l]+m[l]);
+  }
+}
+
+#ifdef HAVE_SIMD_DISPATCH
+
+/* one AVX2 register holds the 8 lanes of a cell */
+
+__attribute__ ((target ("avx2")))
+PRIVATE void row_run_avx2(const int *X, const int *indx, int p, int j,
+			  int qlo, int qhi, const int *s, const int *m,
+			  int *best)
+{
+  __m256i b, mv;
+  int q;
+
+  b = _mm256_loadu_si256((const __m256i *) best);
+  mv = _mm256_loadu_si256((const __m256i *) m);
+  for (q = qlo; q <= qhi; q++)
+    b = _mm256_min_epi32(b, _mm256_add_epi32(
+	  _mm256_loadu_si256((const __m256i *) AT(X, indx[q]+p)),
+	  _mm256_add_epi32(mv, _mm256_set1_epi32(s[j-q-1]))));
+  _mm256_storeu_si256((__m256i *) best, b);
+}
+
+__attribute__ ((target ("avx2")))
+PRIVATE void col_run_avx2(const int *X, int cell, int klo, int khi,
+			  const int *s, const int *m, int *best)
+{
+  __m256i b, mv;
+  int k;
+
+  b = _mm256_loadu_si256((const __m256i *) best);
+  mv = _mm256_loadu_si256((const __m256i *) m);
+  for (k = klo; k <= khi; k++)
+    b = _mm256_min_epi32(b, _mm256_add_epi32(
+	  _mm256_loadu_si256((const __m256i *) AT(X, cell+k)),
+	  _mm256_add_epi32(mv, _mm256_set1_epi32(s[k-klo]))));
+  _mm256_storeu_si256((__m256i *) best, b);
+}
+
+__attribute__ ((target ("avx2")))
+PRIVATE void ml_decomp_avx2(const int *Fmi, const int *fML, int cell,
+			    int klo, int khi, int *best)
+{
+  __m256i b;
+  int k;
+
+  b = _mm256_loadu_si256((const __m256i *) best);
+  for (k = klo; k <= khi; k++)
+    b = _mm256_min_epi32(b, _mm256_add_epi32(
+	  _mm256_loadu_si256((const __m256i *) AT(Fmi, k)),
+	  _mm256_loadu_si256((const __m256i *) AT(fML, cell+k))));
+  _mm256_storeu_si256((__m256i *) best, b);
+}
+
+#endif
+
+/* Picks the kernels for the CPU we are running on */
+
+PRIVATE void select_kernels(fold_batch_ctx *ctx)
+{
+  ctx->row_run = row_run_generic;
+  ctx->col_run = col_run_generic;
+  ctx->ml_decomp = ml_decomp_generic;
+#ifdef HAVE_SIMD_DISPATCH
+  __builtin_cpu_init();
+  if (fold_batch_simd && (LANES == 8) && __builtin_cpu_supports("avx2")) {
+    ctx->row_run = row_run_avx2;
+    ctx->col_run = col_run_avx2;
+    ctx->ml_decomp = ml_decomp_avx2;
+  }
+#endif
+}
+
+/*--------------------------------------------------------------------------*/
+
+/* fill_arrays() of fold.c for all lanes at once; dangles 0, 1 or 2,
+   no constraints and no_closingGU off */
+
+PRIVATE void fill_batch(fold_batch_ctx *ctx, const char **string, int length)
+{
+  int   i, j, l, p, q, n1, ij, minq, qs, qe, pmax;
+  const paramT *P = ctx->P;
+  const int *indx = ctx->indx;
+  const char *ptype = ctx->ptype;
+  const short *S1 = ctx->S1;
+  int   *c = ctx->c, *cm = ctx->cm, *cb = ctx->cb, *fML = ctx->fML;
+  int   *f5 = ctx->f5;
+  int   *cc = ctx->cc, *cc1 = ctx->cc1, *Fmi = ctx->Fmi;
+  int   *DMLi = ctx->DMLi, *DMLi1 = ctx->DMLi1, *DMLi2 = ctx->DMLi2;
+  int   type[LANES], new_c[LANES], stackEnergy[LANES], mm[LANES], mb[LANES];
+  int   new_fML[LANES], decomp[LANES];
+
+  for (j=1; j<=length; j++)
+    for (l=0; l<LANES; l++)
+      AT(Fmi,j)[l]=AT(DMLi,j)[l]=AT(DMLi1,j)[l]=AT(DMLi2,j)[l]=INF;
+  for (j=0; j<=length+1; j++)
+    for (l=0; l<LANES; l++) AT(cc,j)[l]=AT(cc1,j)[l]=0;
+
+  for (j = 1; j<=length; j++)
+    for (i=(j>TURN?(j-TURN):1); i<j; i++)
+      for (l=0; l<LANES; l++)
+	AT(c,indx[j]+i)[l] = AT(cm,indx[j]+i)[l] = AT(cb,indx[j]+i)[l] =
+	  AT(fML,indx[j]+i)[l] = INF;
+
+  for (i = length-TURN-1; i >= 1; i--) { /* i,j in [1..length] */
+
+    for (j = i+TURN+1; j <= length; j++) {
+      const short *si1 = AT(S1,i+1), *sj1 = AT(S1,j-1);
+      int any = 0;
+
+      ij = indx[j]+i;
+      for (l=0; l<LANES; l++) {
+	type[l] = AT(ptype,ij)[l];
+	any |= type[l];
+      }
+
+      if (any) {   /* a pair in some lane */
+	/* hairpin ----------------------------------------------*/
+	for (l=0; l<LANES; l++) {
+	  stackEnergy[l] = INF;
+	  new_c[l] = type[l] ?
+	    HairpinE(P, j-i-1, type[l], si1[l], sj1[l], string[l]+i-1) : INF;
+	  mm[l] = P->mismatchI[type[l]][si1[l]][sj1[l]];
+	  mb[l] = (type[l]>2) ? P->TerminalAU : 0;
+	}
+
+	/* Generic interior loops and bulges over all lanes, stacks,
+	   bulges of size 1 and the 1x1, 2x1 and 2x2 loops one lane
+	   after the other -------------------------------------*/
+	pmax = MIN2(j-2-TURN, i+MAXLOOP+1);
+	for (p = i+1; p <= pmax; p++) {
+	  minq = j-i+p-MAXLOOP-2;
+	  if (minq<p+1+TURN) minq = p+1+TURN;
+	  n1 = p-i-1;
+	  qs = (n1==0) ? j-2 : ((n1<=2) ? j-3 : j-1);
+	  if (n1==0)
+	    ctx->row_run(cb, indx, p, j, minq, qs-1, P->bulge, mb, new_c);
+	  else
+	    ctx->row_run(cm, indx, p, j, minq, qs-1, P->interior[n1],
+			 mm, new_c);
+
+	  /* with n1>=2 the bulge at q=j-1 is left to col_run() */
+	  qe = (n1>=2) ? j-2 : j-1;
+	  for (q = (qs>minq) ? qs : minq; q <= qe; q++) {
+	    const char *pt = AT(ptype, indx[q]+p);
+	    const int *cpq = AT(c, indx[q]+p);
+	    int energy;
+	    for (l=0; l<LANES; l++) {
+	      if ((type[l]==0)||(pt[l]==0)) continue;
+	      energy = LoopEnergy(P, n1, j-q-1, type[l], rtype[(int) pt[l]],
+				  si1[l], sj1[l], AT(S1,p-1)[l], AT(S1,q+1)[l]);
+	      new_c[l] = MIN2(energy+cpq[l], new_c[l]);
+	      if ((p==i+1)&&(j==q+1)) stackEnergy[l] = energy;
+	    }
+	  }
+	}
+	/* bulges (i+3..pmax, j-1), which follow each other in c[] */
+	if (pmax>=i+3)
+	  ctx->col_run(cb, indx[j-1], i+3, pmax, P->bulge+2, mb, new_c);
+
+	/* multi-loop decomposition ------------------------*/
+	for (l=0; l<LANES; l++) {
+	  int MLenergy, dec, tt, d3, d5;
+	  if (type[l]==0) continue;
+	  dec = AT(DMLi1,j-1)[l];
+	  if (dangles) {
+	    tt = rtype[type[l]];
+	    d3 = P->dangle3[tt][si1[l]];
+	    d5 = P->dangle5[tt][sj1[l]];
+	    if (dangles==2) /* double dangles */
+	      dec += d5 + d3;
+	    else {          /* normal dangles */
+	      dec = MIN2(AT(DMLi2,j-1)[l]+d3+P->MLbase, dec);
+	      dec = MIN2(AT(DMLi1,j-2)[l]+d5+P->MLbase, dec);
+	      dec = MIN2(AT(DMLi2,j-2)[l]+d5+d3+2*P->MLbase, dec);
+	    }
+	  }
+	  MLenergy = P->MLclosing+P->MLintern[type[l]]+dec;
+	  new_c[l] = MLenergy < new_c[l] ? MLenergy : new_c[l];
+	}
+
+	for (l=0; l<LANES; l++) {
+	  if (type[l]==0) {
+	    AT(c,ij)[l] = INF;
+	    continue;
+	  }
+	  new_c[l] = MIN2(new_c[l], AT(cc1,j-1)[l]+stackEnergy[l]);
+	  AT(cc,j)[l] = new_c[l];
+	  if (noLonelyPairs)
+	    AT(c,ij)[l] = AT(cc1,j-1)[l]+stackEnergy[l];
+	  else
+	    AT(c,ij)[l] = new_c[l];
+	}
+      } /* end >> if (pair) << */
+
+      else
+	for (l=0; l<LANES; l++) AT(c,ij)[l] = INF;
+
+      /* (i,j) as the inner pair of an interior loop or bulge */
+      for (l=0; l<LANES; l++) {
+	AT(cm,ij)[l] = ((type[l]==0)||(i==1)||(j==length)) ? INF :
+	  AT(c,ij)[l] +
+	  P->mismatchI[rtype[type[l]]][AT(S1,j+1)[l]][AT(S1,i-1)[l]];
+	AT(cb,ij)[l] = (type[l]==0) ? INF :
+	  AT(c,ij)[l] + ((rtype[type[l]]>2) ? P->TerminalAU : 0);
+      }
+
+      /* done with c[i,j], now compute fML[i,j] */
+      /* free ends ? -----------------------------------------*/
+      for (l=0; l<LANES; l++) {
+	int energy, tt, t = type[l];
+	new_fML[l] = AT(fML,ij+1)[l]+P->MLbase;
+	new_fML[l] = MIN2(AT(fML,indx[j-1]+i)[l]+P->MLbase, new_fML[l]);
+	energy = AT(c,ij)[l]+P->MLintern[t];
+	if (dangles==2) {  /* double dangles */
+	  if (i>1)      energy += P->dangle5[t][AT(S1,i-1)[l]];
+	  if (j<length) energy += P->dangle3[t][AT(S1,j+1)[l]];
+	}
+	new_fML[l] = MIN2(energy, new_fML[l]);
+
+	if (dangles%2==1) {  /* normal dangles */
+	  tt = AT(ptype,ij+1)[l]; /* i+1,j */
+	  new_fML[l] = MIN2(AT(c,ij+1)[l]+P->dangle5[tt][AT(S1,i)[l]]
+			    +P->MLintern[tt]+P->MLbase,new_fML[l]);
+	  tt = AT(ptype,indx[j-1]+i)[l];
+	  new_fML[l] = MIN2(AT(c,indx[j-1]+i)[l]+P->dangle3[tt][AT(S1,j)[l]]
+			    +P->MLintern[tt]+P->MLbase, new_fML[l]);
+	  tt = AT(ptype,indx[j-1]+i+1)[l];
+	  new_fML[l] = MIN2(AT(c,indx[j-1]+i+1)[l]+P->dangle5[tt][AT(S1,i)[l]]+
+			    P->dangle3[tt][AT(S1,j)[l]]+P->MLintern[tt]
+			    +2*P->MLbase, new_fML[l]);
+	}
+	decomp[l] = INF;
+      }
+
+      /* modular decomposition -------------------------------*/
+      ctx->ml_decomp(Fmi, fML, indx[j]+1, i+1+TURN, j-2-TURN, decomp);
+
+      for (l=0; l<LANES; l++) {
+	AT(DMLi,j)[l] = decomp[l];    /* store for use in ML decompositon */
+	new_fML[l] = MIN2(new_fML[l], decomp[l]);
+	AT(fML,ij)[l] = AT(Fmi,j)[l] = new_fML[l];     /* substring energy */
+      }
+    }
+
+    {
+      int *FF; /* rotate the auxilliary arrays */
+      FF = DMLi2; DMLi2 = DMLi1; DMLi1 = DMLi; DMLi = FF;
+      FF = cc1; cc1=cc; cc=FF;
+      for (j=1; j<=length; j++)
+	for (l=0; l<LANES; l++) AT(cc,j)[l]=AT(Fmi,j)[l]=AT(DMLi,j)[l]=INF;
+    }
+  }
+
+  /* calculate energies of 5' fragments, one lane after the other */
+  for (l=0; l<LANES; l++) {
+    int t, energy;
+#define F5(x)  AT(f5,x)[l]
+#define C(x)   AT(c,x)[l]
+#define PT(x)  AT(ptype,x)[l]
+#define SEQ(x) AT(S1,x)[l]
+    F5(TURN+1)=0;
+    for (j=TURN+2; j<=length; j++) {
+      F5(j) = F5(j-1);
+      t=PT(indx[j]+1);
+      if (t) {
+	energy = C(indx[j]+1);
+	if (t>2) energy += P->TerminalAU;
+	if ((dangles==2)&&(j<length))  /* double dangles */
+	  energy += P->dangle3[t][SEQ(j+1)];
+	F5(j) = MIN2(F5(j), energy);
+      }
+      t=PT(indx[j-1]+1);
+      if ((t)&&(dangles%2==1)) {
+	energy = C(indx[j-1]+1)+P->dangle3[t][SEQ(j)];
+	if (t>2) energy += P->TerminalAU;
+	F5(j) = MIN2(F5(j), energy);
+      }
+      for (i=j-TURN-1; i>1; i--) {
+	t = PT(indx[j]+i);
+	if (t) {
+	  energy = F5(i-1)+C(indx[j]+i);
+	  if (t>2) energy += P->TerminalAU;
+	  if (dangles==2) {
+	    energy += P->dangle5[t][SEQ(i-1)];
+	    if (j<length) energy += P->dangle3[t][SEQ(j+1)];
+	  }
+	  F5(j) = MIN2(F5(j), energy);
+	  if (dangles%2==1) {
+	    energy = F5(i-2)+C(indx[j]+i)+P->dangle5[t][SEQ(i-1)];
+	    if (t>2) energy += P->TerminalAU;
+	    F5(j) = MIN2(F5(j), energy);
+	  }
+	}
+	t = PT(indx[j-1]+i);
+	if ((t)&&(dangles%2==1)) {
+	  energy = C(indx[j-1]+i)+P->dangle3[t][SEQ(j)];
+	  if (t>2) energy += P->TerminalAU;
+	  F5(j) = MIN2(F5(j), F5(i-1)+energy);
+	  F5(j) = MIN2(F5(j), F5(i-2)+energy+P->dangle5[t][SEQ(i-1)]);
+	}
+      }
+    }
+#undef F5
+#undef C
+#undef PT
+#undef SEQ
+  }
+}
+
+/*--------------------------------------------------------------------------*/
+
+/* Minimum free energies of the n<=FOLD_BATCH sequences, which must all
+   have the same length, the same as fold_energy_only() gives */
+
+PUBLIC void fold_batch_energies(fold_batch_ctx *ctx, const char **sequences,
+				int n, float *energies)
+{
+  const char *lane[LANES];
+  int l, length, e;
+
+  if ((n<1)||(n>LANES))
+    nrerror("fold_batch_energies: 1 to FOLD_BATCH sequences at a time");
+  length = (int) strlen(sequences[0]);
+  for (l=1; l<n; l++)
+    if ((int) strlen(sequences[l])!=length)
+      nrerror("fold_batch_energies: sequences of different length");
+
+  /* coaxial stacking and no_closingGU are left to fold_energy_only(),
+     as are sequences too short for any pair */
+  if ((dangles==3)||no_closingGU||(length<=TURN+1)) {
+    for (l=0; l<n; l++)
+      energies[l] = fold_energy_only(NULL, sequences[l]);
+    return;
+  }
+
+  if (length>ctx->length) {
+    if (ctx->length>0) release_arrays(ctx);
+    get_arrays(ctx, (unsigned) length);
+  }
+  if (!scaled_parameters_current(ctx->P))
+    ctx->P = get_scaled_parameters();
+  make_pair_matrix();
+
+  /* unused lanes fold the first sequence again */
+  for (l=0; l<LANES; l++) lane[l] = sequences[(l<n) ? l : 0];
+
+  memset(ctx->ptype, 0, sizeof(char)*LANES*(ctx->indx[length]+length+1));
+  for (l=0; l<LANES; l++) {
+    encode_lane(ctx, l, lane[l], length);
+    make_ptypes_lane(ctx, l, length);
+  }
+
+  fill_batch(ctx, lane, length);
+
+  for (l=0; l<n; l++) {
+    if (backtrack_type=='C')
+      e = AT(ctx->c, ctx->indx[length]+1)[l];
+    else if (backtrack_type=='M')
+      e = AT(ctx->fML, ctx->indx[length]+1)[l];
+    else
+      e = AT(ctx->f5, length)[l];
+    energies[l] = (float) e/100.;
+  }
+}
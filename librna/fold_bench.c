@@ -0,0 +1,147 @@
+/*
+		  timing of fold_r() and alifold_r() with the
+		  column-major and the row-major layout of c[]
+
+		  fold_bench [seed [gc]]
+
+		  Folds the same random sequences and alignments
+		  in both layouts, checks that energies and
+		  structures agree and prints the time per call.
+		  gc is the G+C content of the sequences (0.5).
+		  Not installed, build with "make fold_bench".
+*/
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "utils.h"
+#include "fold_vars.h"
+#include "fold.h"
+#include "alifold.h"
+
+#define PRIVATE static
+#define N_SEQ 4      /* sequences per alignment */
+
+PRIVATE int lengths[] = {50, 100, 200, 400, 700, 1000, 0};
+PRIVATE double gc = 0.5;
+
+PRIVATE char random_base(void)
+{
+  if (urn()<gc) return (urn()<0.5) ? 'G' : 'C';
+  return (urn()<0.5) ? 'A' : 'U';
+}
+
+PRIVATE char *random_sequence(int length)
+{
+  char *seq;
+  int i;
+
+  seq = (char *) space(length+1);
+  for (i=0; i<length; i++) seq[i] = random_base();
+  return seq;
+}
+
+/* rows of an alignment, each base of the first row mutated with
+   probability 0.15 */
+PRIVATE char **random_alignment(int length)
+{
+  char **aln;
+  int s, i;
+
+  aln = (char **) space(sizeof(char *)*(N_SEQ+1));
+  aln[0] = random_sequence(length);
+  for (s=1; s<N_SEQ; s++) {
+    aln[s] = strdup(aln[0]);
+    for (i=0; i<length; i++)
+      if (urn()<0.15) aln[s][i] = random_base();
+  }
+  return aln;
+}
+
+PRIVATE double seconds(clock_t start)
+{
+  return (double) (clock()-start)/CLOCKS_PER_SEC;
+}
+
+int main(int argc, char *argv[])
+{
+  int k, n, s, layout, reps;
+  char **seqs, ***alns, *structure[2];
+  float e[2];
+  double t[2], ta[2];
+
+  if (argc>1) {
+    unsigned long seed = strtoul(argv[1], NULL, 10);
+    xsubi[0] = xsubi[1] = xsubi[2] = (unsigned short) seed;
+  } else init_rand();
+  if (argc>2) gc = atof(argv[2]);
+  dangles = 2;
+  update_fold_params();
+
+  printf("%6s %6s %12s %12s %12s %12s\n", "length", "reps",
+	 "fold col", "fold row", "alifold col", "alifold row");
+  for (k=0; lengths[k]; k++) {
+    int length = lengths[k];
+    fold_ctx *ctx = fold_ctx_create(length);
+    alifold_ctx *actx = alifold_ctx_create(length, N_SEQ);
+
+    reps = 500000/(length*length);
+    if (reps<2) reps = 2;
+    seqs = (char **) space(sizeof(char *)*reps);
+    alns = (char ***) space(sizeof(char **)*reps);
+    for (n=0; n<reps; n++) {
+      seqs[n] = random_sequence(length);
+      alns[n] = random_alignment(length);
+    }
+    structure[0] = (char *) space(length+1);
+    structure[1] = (char *) space(length+1);
+
+    for (layout=0; layout<2; layout++) {
+      clock_t start;
+
+      row_major_dp = layout;
+      start = clock();
+      for (n=0; n<reps; n++) fold_r(ctx, seqs[n], structure[layout]);
+      t[layout] = seconds(start)/reps;
+      start = clock();
+      for (n=0; n<reps; n++) alifold_r(actx, alns[n], structure[layout]);
+      ta[layout] = seconds(start)/reps;
+    }
+
+    /* the timed calls only keep the last structure, compare all */
+    for (n=0; n<reps; n++) {
+      for (layout=0; layout<2; layout++) {
+	row_major_dp = layout;
+	e[layout] = fold_r(ctx, seqs[n], structure[layout]);
+      }
+      if (e[0]!=e[1] || strcmp(structure[0], structure[1])) {
+	fprintf(stderr, "fold differs for\n%s\n", seqs[n]);
+	return 1;
+      }
+      for (layout=0; layout<2; layout++) {
+	row_major_dp = layout;
+	e[layout] = alifold_r(actx, alns[n], structure[layout]);
+      }
+      if (e[0]!=e[1] || strcmp(structure[0], structure[1])) {
+	fprintf(stderr, "alifold differs for\n%s\n", alns[n][0]);
+	return 1;
+      }
+    }
+
+    printf("%6d %6d %10.3fms %10.3fms %10.3fms %10.3fms\n", length, reps,
+	   1e3*t[0], 1e3*t[1], 1e3*ta[0], 1e3*ta[1]);
+
+    for (n=0; n<reps; n++) {
+      free(seqs[n]);
+      for (s=0; s<N_SEQ; s++) free(alns[n][s]);
+      free(alns[n]);
+    }
+    free(seqs); free(alns);
+    free(structure[0]); free(structure[1]);
+    fold_ctx_destroy(ctx);
+    alifold_ctx_destroy(actx);
+  }
+  return 0;
+}
@@ -0,0 +1,106 @@
+/*
+		  check of fold_batch_energies() against
+		  fold_r() and energy_of_struct()
+
+		  fold_check [seed]
+
+		  Folds random sequences (lengths 5 to 300, some
+		  with N) in batches of 1 to FOLD_BATCH, with the
+		  generic kernels and with the AVX2 ones if the CPU
+		  has them, for dangles 0 to 3, with and without
+		  lonely pairs and closing GU pairs. Each energy must
+		  be the one fold_r() and fold_energy_only() give
+		  for the sequence alone, and energy_of_struct() of
+		  the fold_r() structure. energy_of_struct() does
+		  not know coaxial stacking, so it is left out for
+		  dangles 3. Run by "make check".
+*/
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "utils.h"
+#include "fold_vars.h"
+#include "fold.h"
+
+#define PRIVATE static
+#define TRIALS 32    /* batches per dangles, lonely and GU pairs */
+
+PRIVATE char *random_sequence(int length, double gc)
+{
+  char *seq;
+  int i;
+
+  seq = (char *) space(length+1);
+  for (i=0; i<length; i++) {
+    if (urn()<0.02) seq[i] = 'N';
+    else if (urn()<gc) seq[i] = (urn()<0.5) ? 'G' : 'C';
+    else seq[i] = (urn()<0.5) ? 'A' : 'U';
+  }
+  return seq;
+}
+
+int main(int argc, char *argv[])
+{
+  fold_ctx *ctx;
+  fold_batch_ctx *batch[2];
+  char *seqs[FOLD_BATCH], *structure;
+  float e[2][FOLD_BATCH], ref;
+  int simd, d, nlp, gu, trial, n, l, length, batches=0;
+  double gc;
+
+  if (argc>1) {
+    unsigned long seed = strtoul(argv[1], NULL, 10);
+    xsubi[0] = xsubi[1] = xsubi[2] = (unsigned short) seed;
+  } else xsubi[0] = xsubi[1] = xsubi[2] = 4711;
+
+  /* the kernels are picked when a context is made */
+  for (simd=0; simd<2; simd++) {
+    fold_batch_simd = simd;
+    batch[simd] = fold_batch_ctx_create(0);
+  }
+  fold_batch_simd = 1;
+  ctx = fold_ctx_create(0);
+  structure = (char *) space(301);
+
+  for (d=0; d<=3; d++)
+    for (nlp=0; nlp<2; nlp++)
+      for (gu=0; gu<2; gu++) {
+	dangles = d;
+	noLonelyPairs = nlp;
+	no_closingGU = gu;
+	for (trial=0; trial<TRIALS; trial++) {
+	  /* every batch size, and some longer sequences */
+	  n = trial%FOLD_BATCH+1;
+	  length = (trial%10==9) ? int_urn(150,300) : int_urn(5,150);
+	  gc = urn();
+	  for (l=0; l<n; l++) seqs[l] = random_sequence(length, gc);
+	  for (simd=0; simd<2; simd++)
+	    fold_batch_energies(batch[simd], (const char **) seqs, n, e[simd]);
+	  for (l=0; l<n; l++) {
+	    ref = fold_r(ctx, seqs[l], structure);
+	    if (e[0][l]!=ref || e[1][l]!=ref ||
+		fold_energy_only(NULL, seqs[l])!=ref ||
+		(d!=3 && energy_of_struct(seqs[l], structure)!=ref)) {
+	      fprintf(stderr, "dangles %d, noLP %d, noGU %d, lane %d of %d:"
+		      " batch %6.2f (generic) %6.2f (simd),"
+		      " fold_energy_only %6.2f, fold_r %6.2f,"
+		      " energy_of_struct %6.2f\n%s\n%s\n", d, nlp, gu, l, n,
+		      e[0][l], e[1][l], fold_energy_only(NULL, seqs[l]), ref,
+		      energy_of_struct(seqs[l], structure), seqs[l], structure);
+	      return 1;
+	    }
+	    free(seqs[l]);
+	  }
+	  batches++;
+	}
+      }
+
+  printf("%d batches, the same energies as fold_r()\n", batches);
+  fold_batch_ctx_destroy(batch[0]);
+  fold_batch_ctx_destroy(batch[1]);
+  fold_ctx_destroy(ctx);
+  free(structure);
+  return 0;
+}
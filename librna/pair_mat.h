@@ -15,10 +15,14 @@ static int BP_pair[NBASES][NBASES]=
 
 #define MAXALPHA 20       /* maximal length of alphabet */
 
-static short alias[MAXALPHA+1];
-static int pair[MAXALPHA+1][MAXALPHA+1];
+#ifndef THREAD_LOCAL     /* from config.h, without it one table for all */
+#define THREAD_LOCAL
+#endif
+
+static THREAD_LOCAL short alias[MAXALPHA+1];
+static THREAD_LOCAL int pair[MAXALPHA+1][MAXALPHA+1];
 /* rtype[pair[i][j]]:=pair[j][i] */
-static int rtype[8] = {0, 2, 1, 4, 3, 6, 5, 7}; 
+static THREAD_LOCAL int rtype[8] = {0, 2, 1, 4, 3, 6, 5, 7}; 
 
 /* for backward compatibility */
 #define ENCODE(C) encode_char(c)
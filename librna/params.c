@@ -14,6 +14,9 @@
 #include "fold_vars.h"
 #include "utils.h"
 #include "params.h"
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
 /*@unused@*/
 static char rcsid[] UNUSED = "$Id: params.c,v 1.1.1.1 2004/09/18 13:25:52 wash Exp $";
 
@@ -22,8 +25,63 @@ static char rcsid[] UNUSED = "$Id: params.c,v 1.1.1.1 2004/09/18 13:25:52 wash E
 
 #define MIN2(A, B)      ((A) < (B) ? (A) : (B))
 
-PRIVATE paramT p;
-PRIVATE int id=-1;
+PRIVATE THREAD_LOCAL paramT p;
+PRIVATE THREAD_LOCAL int id=-1;
+
+/* parameter sets handed out by get_scaled_parameters(), one per
+   temperature and generation; they are never changed once made, sets
+   of older generations are only freed at the end */
+struct scaled_set {
+  paramT P;
+  struct scaled_set *next;
+};
+PRIVATE struct scaled_set *scaled_sets = NULL;
+PRIVATE int scaled_generation = 0;
+#ifdef HAVE_PTHREAD
+PRIVATE pthread_mutex_t scaled_sets_lock = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+PRIVATE void  make_loop_bonus(const char *loops, int n, const int *E,
+			      int *bonus);
+
+/*--------------------------------------------------------------------------*/
+
+PUBLIC int loop_code(const char *loop, int n)
+{
+  int k, code = 0;
+
+  for (k=0; k<n; k++) {
+    code <<= 2;
+    switch (loop[k]) {
+    case 'A': break;
+    case 'C': code |= 1; break;
+    case 'G': code |= 2; break;
+    case 'U': code |= 3; break;
+    default: return -1;
+    }
+  }
+  return code;
+}
+
+/*--------------------------------------------------------------------------*/
+
+PRIVATE void make_loop_bonus(const char *loops, int n, const int *E,
+			     int *bonus)
+{
+  /* bonus[] by the code of the n bases (closing pair included), for the
+     list of loops as in Tetraloops[]: n bases and a blank each. Where a
+     loop occurs twice strstr() finds the first one, so that one counts. */
+  int i, code;
+
+  memset(bonus, 0, sizeof(int)*(1<<(2*n)));
+  for (i=(int) strlen(loops)/(n+1)-1; i>=0; i--) {
+    code = loop_code(loops+i*(n+1), n);
+    if (code<0) p.loop_codes = 0;
+    else bonus[code] = E[i];
+  }
+}
+
+/*--------------------------------------------------------------------------*/
 
 PUBLIC paramT *scale_parameters(void)
 {
@@ -45,6 +103,19 @@ PUBLIC paramT *scale_parameters(void)
   }
   for (i=0; i<5; i++)
     p.F_ninio[i] = (int) F_ninio37[i]*tempf;
+
+  /* the terms of LoopEnergy() that depend on the loop sizes only */
+  for (i=0; i<=MAXLOOP; i++)
+    for (j=0; j<=MAXLOOP; j++) {
+      int nl = (i>j) ? i : j, ns = (i>j) ? j : i;
+      if (ns==0)
+	p.interior[i][j] = p.bulge[nl];
+      else {
+	p.interior[i][j] = (i+j<=MAXLOOP) ? p.internal_loop[i+j] :
+	  (p.internal_loop[30]+(int)(p.lxc*log((i+j)/30.)));
+	p.interior[i][j] += MIN2(MAX_NINIO, (nl-ns)*p.F_ninio[2]);
+      }
+    }
    
   for (i=0; (i*7)<strlen(Tetraloops); i++) 
     p.TETRA_ENERGY[i] = TETRA_ENTH37 - (TETRA_ENTH37-TETRA_ENERGY37[i])*tempf;
@@ -120,6 +191,13 @@ PUBLIC paramT *scale_parameters(void)
   strncpy(p.Tetraloops, Tetraloops, 1400);
   strncpy(p.Triloops, Triloops, 240);
 
+  /* HairpinE() looks the special loops up by their code, unless the
+     lists hold something else than A, C, G and U */
+  p.loop_codes = 1;
+  make_loop_bonus(p.Tetraloops, 6, p.TETRA_ENERGY, p.tetra_bonus);
+  make_loop_bonus(p.Triloops, 5, p.Triloop_E, p.tri_bonus);
+  if (strlen(p.Tetraloops)%7 || strlen(p.Triloops)%6) p.loop_codes = 0;
+
   p.temperature = temperature;
   p.id = ++id;
   return &p;
@@ -134,6 +212,74 @@ PUBLIC paramT *copy_parameters(void) {
   return copy;
 }
 
+PUBLIC const paramT *get_scaled_parameters(void) {
+  /* read-only parameters for the current temperature, shared by all
+     threads, so they are scaled only once per temperature and process */
+  struct scaled_set *set;
+
+#ifdef HAVE_PTHREAD
+  pthread_mutex_lock(&scaled_sets_lock);
+#endif
+  for (set=scaled_sets; set!=NULL; set=set->next)
+    if ((fabs(set->P.temperature - temperature)<1e-6) &&
+	(set->P.generation == scaled_generation)) break;
+  if (set==NULL) {
+    set = (struct scaled_set *) space(sizeof(struct scaled_set));
+    memcpy(&set->P, scale_parameters(), sizeof(paramT));
+    set->P.generation = scaled_generation;
+    set->next = scaled_sets;
+    scaled_sets = set;
+  }
+#ifdef HAVE_PTHREAD
+  pthread_mutex_unlock(&scaled_sets_lock);
+#endif
+  return &set->P;
+}
+
+PUBLIC int scaled_parameters_current(const paramT *P) {
+  /* the contexts of fold(), alifold() and fold_batch_energies() ask
+     this before each folding */
+  int current;
+
+#ifdef HAVE_PTHREAD
+  pthread_mutex_lock(&scaled_sets_lock);
+#endif
+  current = (fabs(P->temperature - temperature)<1e-6) &&
+    (P->generation == scaled_generation);
+#ifdef HAVE_PTHREAD
+  pthread_mutex_unlock(&scaled_sets_lock);
+#endif
+  return current;
+}
+
+PUBLIC void new_scaled_parameters(void) {
+  /* e.g. after read_parameter_file(); the sets made so far may still be
+     in use, so they are only passed over */
+#ifdef HAVE_PTHREAD
+  pthread_mutex_lock(&scaled_sets_lock);
+#endif
+  scaled_generation++;
+#ifdef HAVE_PTHREAD
+  pthread_mutex_unlock(&scaled_sets_lock);
+#endif
+}
+
+PUBLIC void free_scaled_parameters(void) {
+  /* only call when no folding context uses the shared sets any more */
+  struct scaled_set *set;
+
+#ifdef HAVE_PTHREAD
+  pthread_mutex_lock(&scaled_sets_lock);
+#endif
+  while ((set=scaled_sets)!=NULL) {
+    scaled_sets = set->next;
+    free(set);
+  }
+#ifdef HAVE_PTHREAD
+  pthread_mutex_unlock(&scaled_sets_lock);
+#endif
+}
+
 PUBLIC paramT *set_parameters(paramT *dest) {
 
   memcpy(&p, dest, sizeof(paramT));
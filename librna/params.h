@@ -14,6 +14,8 @@ typedef struct {
   int int21[NBPAIRS+1][NBPAIRS+1][5][5][5];
   int int22[NBPAIRS+1][NBPAIRS+1][5][5][5][5];
   int F_ninio[5];
+  int interior[MAXLOOP+1][MAXLOOP+1]; /* n1 x n2 loops: bulge[] if n1 or
+		  n2 is 0, else internal_loop[] and asymmetry (ninio) */
   double lxc;
   int MLbase;
   int MLintern[NBPAIRS+1];
@@ -23,9 +25,21 @@ typedef struct {
   char Tetraloops[1401];
   int Triloop_E[40];
   char Triloops[241];
+  int loop_codes;     /* nonzero if the loops below are complete */
+  int tetra_bonus[1<<12]; /* TETRA_ENERGY of a tetraloop by loop_code() */
+  int tri_bonus[1<<10];   /* Triloop_E of a triloop by loop_code() */
   double temperature;
+  int generation;     /* of the sets of get_scaled_parameters() */
 }  paramT;
 
 extern paramT *scale_parameters(void);
 extern paramT *copy_parameters(void);
+extern const paramT *get_scaled_parameters(void); /* shared, read-only */
+extern int scaled_parameters_current(const paramT *P);
+/* P is the set get_scaled_parameters() gives now */
+extern void new_scaled_parameters(void);
+/* the energies have changed, later calls make new sets */
+extern void free_scaled_parameters(void);
 extern paramT *set_parameters(paramT *dest);
+extern int loop_code(const char *loop, int n);
+/* the n bases of loop with 2 bits each, -1 if one is not A, C, G or U */
@@ -0,0 +1,120 @@
+#!/usr/bin/perl
+
+# Converts the libsvm models compiled into RNAz (the C strings in
+# models/*.inc) into precomputed model images, so that RNAz only has to
+# copy a few arrays at startup instead of parsing the model text.
+#
+# usage: ModelImage.pl model.inc [model.inc ...] > model_images.c
+#
+# For a string "char* NAME_string=" an image "NAME_image" of type
+# struct svm_model_image (see rnaz/svm_helper.h) is written. Support
+# vectors are stored as one dense row-major matrix; features missing in
+# the sparse libsvm format are 0. Numbers are copied verbatim from the
+# model text, so the compiler gives exactly the doubles sscanf() gave.
+
+use strict;
+use warnings;
+
+my %svm_types = (c_svc => 0, nu_svc => 1, one_class => 2,
+                 epsilon_svr => 3, nu_svr => 4);
+my %kernel_types = (linear => 0, polynomial => 1, rbf => 2, sigmoid => 3);
+
+print "/* Generated by models/ModelImage.pl, do not edit. */\n\n";
+print "#include <stdlib.h>\n";
+print "#include \"svm.h\"\n";
+print "#include \"svm_helper.h\"\n";
+
+foreach my $file (@ARGV) {
+
+  open (FILE, "<$file") or die "Could not open $file: $!\n";
+  my $name;
+  my @lines;
+  while (my $line = <FILE>) {
+    if ($line =~ /^char\*\s*(\w+)_string\s*=/) {
+      $name = $1;
+    } elsif ($line =~ /^"(.*)\\n";?\s*$/) {
+      push @lines, $1;
+    }
+  }
+  close FILE;
+  die "No model string found in $file\n" if (!defined $name || !@lines);
+
+  my %header = (svm_type => 'c_svc', kernel_type => 'rbf', degree => 0,
+                gamma => 0, coef0 => 0);
+  while (@lines) {
+    my $line = shift @lines;
+    last if ($line eq 'SV');
+    my ($key, @values) = split ' ', $line;
+    $header{$key} = [@values];
+  }
+  foreach my $key ('svm_type', 'kernel_type', 'degree', 'gamma', 'coef0') {
+    $header{$key} = $header{$key}->[0] if (ref $header{$key});
+  }
+  die "Unknown svm type in $file\n"
+    if (!exists $svm_types{$header{svm_type}});
+  die "Unknown kernel type in $file\n"
+    if (!exists $kernel_types{$header{kernel_type}});
+
+  my $nr_class = $header{nr_class}->[0];
+  my $l = $header{total_sv}->[0];
+  my $m = $nr_class - 1;
+
+  # read the sparse support vectors
+  my (@coef, @sv);
+  my $dim = 0;
+  foreach my $i (0 .. $l-1) {
+    my @fields = split ' ', $lines[$i];
+    foreach my $k (0 .. $m-1) {
+      $coef[$k][$i] = $fields[$k];
+    }
+    my %x;
+    foreach my $field (@fields[$m .. $#fields]) {
+      my ($index, $value) = split /:/, $field;
+      $x{$index} = $value;
+      $dim = $index if ($index > $dim);
+    }
+    $sv[$i] = \%x;
+  }
+
+  print "\n/* $name: $header{svm_type}, $l support vectors, $dim features */\n";
+
+  print "static const double ${name}_sv[] MODEL_ALIGN = {\n";
+  foreach my $i (0 .. $l-1) {
+    my @row = map { exists $sv[$i]->{$_} ? $sv[$i]->{$_} : '0' } (1 .. $dim);
+    print join(',', @row), ",\n";
+  }
+  print "};\n";
+
+  print "static const double ${name}_coef[] MODEL_ALIGN = {\n";
+  foreach my $k (0 .. $m-1) {
+    foreach my $i (0 .. $l-1) {
+      print $coef[$k][$i], ($i % 8 == 7) ? ",\n" : ",";
+    }
+    print "\n" if ($l % 8);
+  }
+  print "};\n";
+
+  my %arrays;
+  foreach my $key ('rho', 'probA', 'probB') {
+    next if (!exists $header{$key});
+    print "static const double ${name}_$key\[\] = {",
+      join(',', @{$header{$key}}), "};\n";
+    $arrays{$key} = "${name}_$key";
+  }
+  foreach my $key ('label', 'nr_sv') {
+    next if (!exists $header{$key});
+    print "static const int ${name}_$key\[\] = {",
+      join(',', @{$header{$key}}), "};\n";
+    $arrays{$key} = "${name}_$key";
+  }
+  die "No rho in $file\n" if (!exists $arrays{rho});
+
+  print "const struct svm_model_image ${name}_image = {\n";
+  print "  $svm_types{$header{svm_type}}, $kernel_types{$header{kernel_type}}, ",
+    int($header{degree}), ", $header{gamma}, $header{coef0},\n";
+  print "  $nr_class, $l, $dim,\n";
+  print "  ${name}_sv, ${name}_coef, $arrays{rho},\n";
+  print "  ", join(', ', map { exists $arrays{$_} ? $arrays{$_} : 'NULL' }
+                   ('probA', 'probB', 'label', 'nr_sv')), "\n";
+  print "};\n";
+}
@@ -904,6 +904,28 @@ sub pruneAln{
 
 }
 
+######################################################################
+#
+# getNextRNAz($fh filehandle)
+#
+# Reads the next result of RNAz from $fh (default STDIN): a text report
+# or a single record written with --format=tsv, jsonl or bin. The
+# format is recognized from the first line. Binary records are returned
+# as tsv lines with the values rounded as in the text report.
+#
+# Returns the result as string, an empty string at the end of the input.
+#
+######################################################################
+
+# Format of each file handle and the columns of the last tsv header
+my %rnazFormat=();
+our @recordFields=();
+
+my @binaryFields=qw(refSeqStart refSeqEnd N columns refSeqStrand strand
+		    identity entropy GC meanMFE consensusMFE energy
+		    covariance combPerPair z sci decValue P
+		    refSeqName consensusSeq consensusFold);
+
 sub getNextRNAz{
 
   my $fh=shift;
@@ -912,26 +934,105 @@ sub getNextRNAz{
   }
 
   my $out='';
+  my $format=$rnazFormat{$fh};
+
+  if (!defined $format){
+	while (<$fh>){
+	  next if /^\s?$/;
+	  if (/^\#RNAz binary records/){
+		$format='bin';
+		binmode($fh);
+	  } elsif (/^\#(refSeqName\t.*?)\r?$/){
+		$format='tsv';
+		@recordFields=split(/\t/,$1);
+	  } elsif (/^\{/){
+		$format='jsonl';
+		$out=$_;
+	  } else {
+		$format='text';
+		$out=$_;
+	  }
+	  last;
+	}
+	return '' if (!defined $format);
+	$rnazFormat{$fh}=$format;
+	return $out if ($format eq 'jsonl');
+  }
 
-  while (<$fh>){
+  if ($format eq 'bin'){
+	$out=readRNAzBinary($fh);
+  } elsif ($format ne 'text'){
+	while (<$fh>){
+	  next if /^\s?$/;
+	  if (/^\#(refSeqName\t.*?)\r?$/){
+		@recordFields=split(/\t/,$1);
+		next;
+	  }
+	  next if /^\#/;
+	  $out=$_;
+	  last;
+	}
+  } else {
+	while (<$fh>){
 
-	next if /^\s?$/;
+	  next if /^\s?$/;
 	
-	last if /^\#.*RNAz.*\#$/ and $out ne '';
+	  last if /^\#.*RNAz.*\#$/ and $out ne '';
 	
-	$out.=$_;
+	  $out.=$_;
 	
-	last if eof; #seems to be necessary if <> does not read from stdin
-	             #but from real file given without "<" at the
-	             #commandline
+	  last if eof; #seems to be necessary if <> does not read from stdin
+	               #but from real file given without "<" at the
+	               #commandline
+	}
   }
+
+  delete $rnazFormat{$fh} if ($out eq '');
   return $out;
 }
 
+# One binary record as tsv line, see append_record() in RNAz.c
+
+sub readRNAzBinary{
+
+  my $fh=shift;
+  my $buffer;
+
+  return '' if (read($fh,$buffer,4)!=4);
+  my $size=unpack('L',$buffer);
+  if (read($fh,$buffer,$size)!=$size){
+	die("Truncated binary record in RNAz output\n");
+  }
+
+  my %record=();
+  @record{@binaryFields}=unpack('l4 a a d12 L/a L/a L/a',$buffer);
+
+  foreach my $key (qw(identity meanMFE consensusMFE energy covariance
+		      combPerPair z sci decValue)){
+	$record{$key}=sprintf("%.2f",$record{$key});
+  }
+  $record{entropy}=sprintf("%.5f",$record{entropy});
+  $record{GC}=sprintf("%.5f",$record{GC});
+  $record{P}=sprintf("%f",$record{P});
+
+  @recordFields=qw(refSeqName refSeqStart refSeqEnd refSeqStrand strand N
+		   columns identity entropy GC meanMFE consensusMFE energy
+		   covariance combPerPair z sci decValue P);
+  if ($record{consensusSeq} ne ''){
+	push @recordFields, qw(consensusSeq consensusFold);
+  }
+
+  return join("\t",@record{@recordFields})."\n";
+}
+
 sub parseRNAz{
 
   my $rnaz=shift;
 
+  if ($rnaz=~/^\{/ or ($rnaz!~/\n./ and $rnaz=~/\t/)){
+	return parseRNAzRecord($rnaz);
+  }
+
   my @rnaz=split(/^/, $rnaz);
   my ($N,$identity,$columns,$decValue,$P,$z,$sci,$energy,$strand,
       $covariance,$combPerPair,$meanMFE,$consensusMFE,$consensusSeq,
@@ -1013,8 +1114,62 @@ sub parseRNAz{
 	  "rawOutput"=>$rnaz,
       "strand" => $strand,
 	  "GC"=>$GCcontent,
-	  "entropy"=>$ShannonEntropy};
+	  "entropy"=>$ShannonEntropy,
+	  "format"=>'text'};
+
+}
+
+# A tsv or jsonl record; gives the same keys as a text report, only the
+# alignment is missing
+
+sub parseRNAzRecord{
+
+  my $line=shift;
+  my %record=();
+  my $format;
+
+  chomp($line);
+
+  if ($line=~/^\{/){
+	$format='jsonl';
+	while ($line=~/"(\w+)":(?:"((?:[^"\\]|\\.)*)"|([^,}]*))/g){
+	  my ($key,$string,$number)=($1,$2,$3);
+	  if (defined $string){
+		$string=~s/\\(?:u([0-9a-fA-F]{4})|(.))/defined $1 ? chr(hex($1)) : $2/ge;
+		$record{$key}=$string;
+	  } else {
+		$record{$key}=($number eq 'null') ? undef : $number;
+	  }
+	}
+  } else {
+	$format='tsv';
+	@record{@recordFields}=split(/\t/,$line);
+  }
 
+  return {"N"=>$record{N},
+	  "identity"=>$record{identity},
+	  "decValue"=>$record{decValue},
+	  "columns"=>$record{columns},
+	  "P"=>$record{P},
+	  "z"=>$record{z},
+	  "sci"=>$record{sci},
+	  "energy"=>$record{energy},
+	  "covariance"=>$record{covariance},
+	  "combPerPair"=>$record{combPerPair},
+	  "consensusMFE"=>$record{consensusMFE},
+	  "meanMFE"=>$record{meanMFE},
+	  "consensusSeq"=>$record{consensusSeq},
+	  "consensusFold"=>$record{consensusFold},
+	  "refSeqName"=>$record{refSeqName},
+	  "refSeqStart"=>$record{refSeqStart},
+	  "refSeqEnd"=>$record{refSeqEnd},
+	  "refSeqStrand"=>$record{refSeqStrand},
+	  "aln"=>[],
+	  "rawOutput"=>"$line\n",
+	  "strand"=>$record{strand},
+	  "GC"=>$record{GC},
+	  "entropy"=>$record{entropy},
+	  "format"=>$format};
 }
 
 ######################################################################
@@ -157,6 +157,10 @@ while (my $rnazString=getNextRNAz($fh)){
 
   my $results=parseRNAz($rnazString);
 
+  if ($html and $results->{format} ne 'text'){
+	die("The --html output needs the text output of RNAz, not --format=$results->{format}\n");
+  }
+
   $currStart=$results->{refSeqStart};
   $currEnd=$results->{refSeqEnd};
   $currName=$results->{refSeqName};
@@ -737,7 +741,8 @@ adjust the locations of these programs directly in the
 C<rnazCluster.pl> script. Please note that if you use this option the
 program will get B<very slow> because the figures have to be
 generated. It is also important that you have run RNAz with the
-B<C<--show-gaps>> option!
+B<C<--show-gaps>> option! The records of
+B<C<--format>> do not contain the alignments and can't be used here.
 
 =item B<--html-dir>
 
@@ -771,6 +776,10 @@ original alignments you scored with RNAz (i.e. MAF files with a
 reference sequence). Moreover, the original input alignments have to
 be B<ordered by the genomic location of the reference sequence>.
 
+Besides the text reports, the records written by RNAz with
+C<--format=tsv>, C<jsonl> or C<bin> are read directly, which is much
+faster for large outputs.
+
 If you want HTML output please see the notes for the C<--html> option
 above.
 
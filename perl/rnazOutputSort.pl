@@ -38,10 +38,12 @@ if ( !defined $fileName ) {
 }
 
 my %data = ();
+my $format = 'text';
 
 while ( my $rnazString = getNextRNAz($fh) ) {
 
   my $results = parseRNAz($rnazString);
+  $format = $results->{format};
 
   my ( $currStart, $currEnd, $currName, $currStrand );
 
@@ -58,9 +60,17 @@ while ( my $rnazString = getNextRNAz($fh) ) {
 }
 
 
+# Records of --format=tsv/jsonl/bin are printed as they were read
+# (binary records as tsv)
+if ( $format eq 'tsv' ) {
+  print "#" . join( "\t", @RNAz::recordFields ) . "\n";
+}
+
 foreach my $key ( keys %data ) {
   foreach my $item ( sort { $a->{start} <=> $b->{start} } @{ $data{$key} } ) {
-    print "\n\n############################  RNAz ".$RNAz::rnazVersion."  ##############################\n\n";
+    if ( $format eq 'text' ) {
+      print "\n\n############################  RNAz ".$RNAz::rnazVersion."  ##############################\n\n";
+    }
     print $item->{rnazString};
   }
 }
@@ -99,6 +109,8 @@ Prints a detailed manual page and exits.
 C<rnazOutputSort.pl> - Sorts output of RNAz by genomic coordinates
 (only needed if input MAFs are unsorted). Reads output from RNAz from
 STDIN or from file given and writes the sorted output to STDOUT.
+Records of C<RNAz --format> are sorted as well and written in the
+same format; binary records are written as tsv.
 
 =head1 EXAMPLES
 
@@ -17,6 +17,7 @@
 #include <ctype.h>
 #include <unistd.h>
 #include <string.h>
+#include <time.h>
 #include "fold.h"
 #include "fold_vars.h"
 #include "utils.h"
@@ -28,9 +29,15 @@
 #include "svm_helper.h"
 #include "cmdline.h"
 #include "strand.h"
+#include "pipeline.h"
+#include "window_stats.h"
+#include "output.h"
 
 #define IN_RANGE(LOWER,VALUE,UPPER) ((VALUE <= UPPER) && (VALUE >= LOWER))
 
+/* Size of the stdio buffer of the output file */
+#define OUTPUT_BUFFER_SIZE (1<<20)
+
 PRIVATE void usage(void);
 PRIVATE void help(void);
 PRIVATE void version(void);
@@ -40,11 +47,153 @@ PRIVATE void classify(double* prob, double* decValue,
 		      double entropy, int decision_model_type);
 PRIVATE void warning(char* string, double id, int n_seq, 
 		     double z, double sci, double entropy,
-		     struct aln *AS[], int decision_model_type);
+		     const struct composition *comps, int decision_model_type);
 
 
 enum {FORWARD=1, REVERSE=2};
 
+/* Output formats: reports or one record per window and strand */
+enum {TEXT_OUT=0, TSV_OUT, JSONL_OUT, BIN_OUT};
+
+/* Values of a record; the reference sequence gives the coordinates */
+struct rnaz_record {
+  const char *name;
+  int nameLength;
+  int start;
+  int end;
+  char refStrand;
+  char strand;
+  int N;
+  int columns;
+  double identity;
+  double entropy;
+  double GC;
+  double meanMFE;
+  double consensusMFE;
+  double energy;
+  double covariance;
+  double combPerPair;
+  double z;
+  double sci;
+  double decValue;
+  double P;
+  const char *consensusSeq;   /* NULL if structures are not shown */
+  const char *consensusFold;
+};
+
+/* Settings and state shared by reader, scoring threads and writer */
+
+struct rnaz_run {
+  struct gengetopt_args_info *args;
+  FILE *clust_file;
+  FILE *out;
+  int (*readFunction)(FILE *clust,struct aln *alignedSeqs[]);
+  struct aln_map *map;  /* NULL if the input is not a regular file */
+  int (*mapFunction)(struct aln_map *map,struct aln_span spans[]);
+  int directions[3];
+  int from;
+  int to;
+  int z_score_type;
+  int decision_model_type;
+  int avoid_shuffle;
+  int format;
+  struct svm_model* decision_model;
+
+  /* sliding windows, windowSize is 0 if alignments are scored as
+     a whole */
+  int windowSize;
+  int windowSlide;
+  struct window_filter filter;
+
+  /* only used by the reader */
+  int countAln;
+  int stop;
+  struct aln *AS[MAX_NUM_NAMES];  /* alignment the windows are cut from */
+  struct aln_span spans[MAX_NUM_NAMES];
+  int n_seq;                      /* 0 if all its windows are read */
+  struct block_stats *stats;      /* its counts, NULL if not available */
+  struct span_offsets offsets;    /* where its last window starts */
+  int alnLength;
+  int windowLength;
+  int sliceStart;
+
+  /* only used by the writer: strand prediction compares the reverse
+     strand to the last reported forward strand */
+  int flushInterval;   /* seconds, -1 to flush after each alignment */
+  time_t lastFlush;
+  double meanMFE_fwd;
+  double consensusMFE_fwd;
+  double sci_fwd;
+  double z_fwd;
+};
+
+/* One alignment (or slice of it) and the report generated for it */
+
+struct rnaz_job {
+  struct aln *window[MAX_NUM_NAMES];
+  int n_seq;
+  int length;
+  int from;
+  int to;
+  const char *error;  /* fatal error, raised when the job is written */
+  struct window_values *values;  /* statistics from the counts of the
+                                    alignment, NULL if not available */
+
+  struct out_buffer report;  /* formatted output for all reading directions */
+  int blockEnd;       /* last job of an input alignment; with no
+                         sequences (n_seq 0) when its last window was
+                         filtered out */
+
+  /* values for the strand predictor, per reading direction */
+  int reported[3];
+  double meanMFE[3];
+  double consensusMFE[3];
+  double sci[3];
+  double z[3];
+  double id[3];
+};
+
+/* Per-sequence results of one reading direction; the blocks after the
+   report are only made from them for directions that are shown */
+struct strand_blocks {
+  struct aln *window[MAX_NUM_NAMES];  /* the alignment as folded */
+  int ownWindow;                      /* window is a copy */
+  char *singleStrucs[MAX_NUM_NAMES];
+  double singleMFEs[MAX_NUM_NAMES];
+  double singleZs[MAX_NUM_NAMES];
+  int z_score_types[MAX_NUM_NAMES];
+  char *consensus;
+  char *structure;
+  double min_en;
+};
+
+/* Scratch space of one worker, kept for all alignments it scores */
+struct rnaz_worker {
+  fold_ctx *fold;
+  alifold_ctx *alifold;
+};
+
+PRIVATE void *read_job(void *data);
+PRIVATE void *read_window_job(struct rnaz_run *run);
+PRIVATE void score_job(void *item, void **worker, void *data);
+PRIVATE void write_job(void *item, void *data);
+PRIVATE void free_worker(void *worker, void *data);
+PRIVATE double consensus_energy(struct aln *window[], const char *structure);
+PRIVATE void append_blocks(struct out_buffer *output,
+                           const struct strand_blocks *blocks, int n_seq,
+                           int coordinates, double real_en);
+PRIVATE void free_blocks(struct strand_blocks *blocks, int n_seq);
+PRIVATE void record_coordinates(const struct rnaz_job *job, int window_given,
+                               int direction, struct rnaz_record *rec);
+PRIVATE void report_value(struct out_buffer *report, const char *label,
+                          double value, int width, int decimals);
+PRIVATE void report_count(struct out_buffer *report, const char *label,
+                          int count);
+PRIVATE void write_header(FILE *out, int format, int structures);
+PRIVATE void append_record(struct rnaz_job *job, int format,
+                           const struct rnaz_record *rec);
+
+
 /********************************************************************
  *                                                                  *
  * main -- main program                                             *
@@ -54,47 +203,20 @@ enum {FORWARD=1, REVERSE=2};
 int main(int argc, char *argv[])
 {
 
-  struct svm_model* decision_model; /* SVM classification model */
-
-  /* Command line options */
-  int from=-1;       /* Scan slice from-to  */
-  int to=-1;
-
-  FILE *clust_file=stdin; /* Input file */
-  FILE *out=stdout; /* Output file */
+  struct rnaz_run run;
+  struct gengetopt_args_info args;
+  int threads=1;
 
-  struct aln *AS[MAX_NUM_NAMES];     
-  struct aln *window[MAX_NUM_NAMES]; 
-  char *tmpAln[MAX_NUM_NAMES];
+  extern int eos_debug;
 
-  int n_seq;  /* number of input sequences */
-  int length; /* length of alignment/window */
-  int z_score_type;
-  int decision_model_type;
+  memset(&run,0,sizeof(run));
+  run.args=&args;
+  run.clust_file=stdin; /* Input file */
+  run.out=stdout; /* Output file */
+  run.from=-1;  /* Scan slice from-to  */
+  run.to=-1;
+  run.directions[0]=FORWARD;
 
-  char *structure=NULL;
-  char *singleStruc,*gapStruc, *output,*woGapsSeq;
-  char strand[8];
-  char warningString[2000];
-  char warningString_regression[2000];
-  char *string=NULL;
-  double singleMFE,sumMFE,singleZ,sumZ,z,sci,id,decValue,prob,comb,entropy,GC;
-  double min_en, real_en;
-  unsigned outputSize=0;
-  int i,j,k,l,ll,countAln,nonGaps,singleGC;
-  int (*readFunction)(FILE *clust,struct aln *alignedSeqs[]);
-  int directions[3]={FORWARD,0,0};
-  int currDirection;
-  struct gengetopt_args_info args;
-
-  double meanMFE_fwd=0;
-  double consensusMFE_fwd=0;
-  double sci_fwd=0;
-  double z_fwd=0;
-  int strandGuess;
-  int avoid_shuffle=0;
-  double strandProb,strandDec;
-  
   if (cmdline_parser (argc, argv, &args) != 0){
     usage();
     exit(EXIT_FAILURE);
@@ -111,399 +233,1167 @@ int main(int argc, char *argv[])
   }
 
   if (args.outfile_given){
-    out = fopen(args.outfile_arg, "w");
-    if (out == NULL){
+    run.out = fopen(args.outfile_arg, "w");
+    if (run.out == NULL){
       fprintf(stderr, "ERROR: Can't open output file %s\n", args.outfile_arg);
       exit(1);
     }
   }
-    
+  setvbuf(run.out, NULL, _IOFBF, OUTPUT_BUFFER_SIZE);
+
 
   /* Strand prediction implies both strands scored */
   if (args.predict_strand_flag){
     args.both_strands_flag=1;
   }
-  
-  
+
+
   if (args.forward_flag && !args.reverse_flag){
-    directions[0]=FORWARD;
-    directions[1]=directions[2]=0;
+    run.directions[0]=FORWARD;
+    run.directions[1]=run.directions[2]=0;
   }
   if (!args.forward_flag && args.reverse_flag){
-    directions[0]=REVERSE;
-    directions[1]=directions[2]=0;
+    run.directions[0]=REVERSE;
+    run.directions[1]=run.directions[2]=0;
   }
   if ((args.forward_flag && args.reverse_flag) || args.both_strands_flag){
-    directions[0]=FORWARD;
-    directions[1]=REVERSE;
+    run.directions[0]=FORWARD;
+    run.directions[1]=REVERSE;
+  }
+
+  if (strcmp(args.format_arg,"text")==0){
+    run.format=TEXT_OUT;
+  } else if (strcmp(args.format_arg,"tsv")==0){
+    run.format=TSV_OUT;
+  } else if (strcmp(args.format_arg,"jsonl")==0){
+    run.format=JSONL_OUT;
+  } else if (strcmp(args.format_arg,"bin")==0){
+    run.format=BIN_OUT;
+  } else {
+    nrerror("ERROR: Invalid --format command. "
+            "Use text, tsv, jsonl or bin.\n");
+  }
+  if (run.format!=TEXT_OUT && args.predict_strand_flag){
+    nrerror("ERROR: --predict-strand only works with the text format.\n");
   }
 
   if (args.window_given){
-    if (sscanf(args.window_arg,"%d-%d",&from,&to)!=2){
+    if (sscanf(args.window_arg,"%d-%d",&run.from,&run.to)!=2){
       nrerror("ERROR: Invalid --window/-w command. "
               "Use it like '--window 100-200'\n");
     }
-    printf("from:%d,to:%d\n",from,to);
+    if (run.format==TEXT_OUT){
+      printf("from:%d,to:%d\n",run.from,run.to);
+    }
   }
 
-  
+  if (args.window_size_given){
+    if (args.window_given){
+      nrerror("ERROR: --window/-w and --window-size can't be used together.\n");
+    }
+    if (args.window_size_arg<1){
+      nrerror("ERROR: Invalid --window-size command. "
+              "The window needs at least one column.\n");
+    }
+    if (args.window_slide_arg<1){
+      nrerror("ERROR: Invalid --window-slide command. "
+              "The step size must be positive.\n");
+    }
+    if (args.min_seqs_arg<2 || args.max_seqs_arg<args.min_seqs_arg){
+      nrerror("ERROR: Invalid --min-seqs/--max-seqs command. "
+              "At least two sequences are needed.\n");
+    }
+    run.windowSize=args.window_size_arg;
+    run.windowSlide=args.window_slide_arg;
+    run.filter.minLength=args.min_length_arg;
+    run.filter.maxGap=args.max_gap_arg;
+    run.filter.maxMasked=args.max_masked_arg;
+    run.filter.minSeqs=args.min_seqs_arg;
+    run.filter.maxSeqs=args.max_seqs_arg;
+    run.filter.minID=args.min_id_arg;
+    run.filter.optID=args.opt_id_arg;
+    run.filter.maxID=args.max_id_arg;
+    run.filter.reference=!args.no_reference_flag;
+    run.filter.rangeCheck=!args.no_rangecheck_flag;
+  }
+
+  run.flushInterval=-1;
+  if (args.flush_interval_given){
+    if (args.flush_interval_arg<0){
+      nrerror("ERROR: Invalid --flush-interval command. "
+              "The interval can't be negative.\n");
+    }
+    run.flushInterval=args.flush_interval_arg;
+    run.lastFlush=time(NULL);
+  }
+
+  if (args.threads_given){
+    if (args.threads_arg<1){
+      nrerror("ERROR: Invalid --threads/-t command. "
+              "At least one thread is needed.\n");
+    }
+    threads=args.threads_arg;
+#ifndef HAVE_PTHREAD
+    if (threads>1){
+      fprintf(stderr, "WARNING: RNAz was compiled without thread support. "
+              "Using a single thread.\n");
+    }
+#endif
+  }
+
+  if (args.shuffle_threads_given){
+    if (args.shuffle_threads_arg<1){
+      nrerror("ERROR: Invalid --shuffle-threads command. "
+              "At least one thread is needed.\n");
+    }
+    shuffle_threads=args.shuffle_threads_arg;
+#ifndef HAVE_PTHREAD
+    if (shuffle_threads>1){
+      fprintf(stderr, "WARNING: RNAz was compiled without thread support. "
+              "Shuffling in a single thread.\n");
+    }
+#endif
+  }
+
+  if (args.shuffle_samples_given){
+    if (sscanf(args.shuffle_samples_arg,"%d-%d",&shuffle_min,&shuffle_max)!=2 ||
+        shuffle_min<2 || shuffle_max<shuffle_min){
+      nrerror("ERROR: Invalid --shuffle-samples command. "
+              "Use it like '--shuffle-samples 100-1000'\n");
+    }
+  }
+
+  if (args.seed_given){
+    shuffle_seed=(unsigned long long)args.seed_arg;
+  }
+
+  if (args.shuffle_stop_given){
+    if (args.shuffle_stop_arg<=0){
+      nrerror("ERROR: Invalid --shuffle-stop command. "
+              "The precision must be positive.\n");
+    }
+    shuffle_stop=args.shuffle_stop_arg;
+  }
+
+
   if (args.inputs_num>=1){
-    clust_file = fopen(args.inputs[0], "r"); 
-    if (clust_file == NULL){
+    run.clust_file = fopen(args.inputs[0], "r");
+    if (run.clust_file == NULL){
       fprintf(stderr, "ERROR: Can't open input file %s\n", args.inputs[0]);
       exit(1);
     }
   }
 
- 
+
   /* Global RNA package variables */
-  do_backtrack = 1; 
+  do_backtrack = 1;
   dangles=2;
+  eos_debug=-1; /* shut off warnings about nonstandard pairs */
 
-  switch(checkFormat(clust_file)){
+  switch(checkFormat(run.clust_file)){
   case CLUSTAL:
-    readFunction=&read_clustal;
+    run.readFunction=&read_clustal;
+    run.mapFunction=&read_clustal_mapped;
     break;
   case MAF:
-    readFunction=&read_maf;
+    run.readFunction=&read_maf;
+    run.mapFunction=&read_maf_mapped;
     break;
   case 0:
     nrerror("ERROR: Unknown alignment file format. Use Clustal W or MAF format.\n");
   }
 
+  /* Regular files are scanned in memory, alignments are only copied
+     when they are scored */
+  run.map=mapAlnFile(run.clust_file);
+
   /* Set z-score type (mono/dinucleotide) here */
-  z_score_type = 2;
+  run.z_score_type = 2;
 
-  if (args.mononucleotide_given) z_score_type = 0;
+  if (args.mononucleotide_given) run.z_score_type = 0;
 
 
   /* now let's decide which decision model to take */
   /* decision_model_type = 1 for normal model used in RNAz 1.0 */
   /* decision_model_type = 2 for normal model using dinucelotide background */
   /* decision_model_type = 3 for structural model using dinucelotide background */
-  decision_model_type = 2;
-  if (args.mononucleotide_given) decision_model_type = 1;
-  if (args.locarnate_given) decision_model_type = 3;
+  run.decision_model_type = 2;
+  if (args.mononucleotide_given) run.decision_model_type = 1;
+  if (args.locarnate_given) run.decision_model_type = 3;
   if ((args.mononucleotide_given) && args.locarnate_given){
-    z_score_type=2;
+    run.z_score_type=2;
     nrerror("ERROR: Structural decision model only trained with dinucleotide background model.\n");
   }
 
-  if (args.no_shuffle_given) avoid_shuffle = 1;
+  if (args.no_shuffle_given) run.avoid_shuffle = 1;
 
-  decision_model=get_decision_model(NULL, decision_model_type);
+  run.decision_model=get_decision_model(NULL, run.decision_model_type);
 
   /* Initialize Regression Models for mononucleotide */
   /* Not needed if we score with dinucleotides */
-  if (z_score_type == 0) regression_svm_init();
-  
-  countAln=0;
+  if (run.z_score_type == 0) regression_svm_init();
+
+  write_header(run.out, run.format, args.structures_flag);
+
+  pipeline_run(threads, read_job, score_job, write_job, free_worker, &run);
+
+  unmapAlnFile(run.map);
+  if (args.inputs_num>=1){
+    fclose(run.clust_file);
+  }
+  stop_shuffle_threads();
+  free_shuffle_workspace();
+  free_fold_workspaces();
+  cmdline_parser_free (&args);
+
+  if (run.countAln==0){
+	nrerror("ERROR: Empty alignment file\n");
+  }
+
+
+  svm_destroy_model(run.decision_model);
+  regression_svm_free();
+
+
+  return 0;
+}
+
+
+/********************************************************************
+ *                                                                  *
+ * read_job -- reads the next alignment and cuts the window to score*
+ *                                                                  *
+ ********************************************************************/
+
+PRIVATE void *read_job(void *data){
+
+  struct rnaz_run *run=(struct rnaz_run *)data;
+  struct rnaz_job *job;
+  struct aln *AS[MAX_NUM_NAMES];
+  struct aln_span spans[MAX_NUM_NAMES];
+  int n_seq;
+
+  if (run->stop) return NULL;
 
-  while ((n_seq=readFunction(clust_file, AS))!=0){
+  if (run->windowSize>0) return read_window_job(run);
 
-	if (n_seq ==1){
-	  nrerror("ERROR: You need at least two sequences in the alignment.\n");
+  if (run->map!=NULL){
+	AS[0]=NULL;
+	if ((n_seq=run->mapFunction(run->map, spans))==0) return NULL;
+  } else {
+	if ((n_seq=run->readFunction(run->clust_file, AS))==0) return NULL;
+	alnSpans((const struct aln **)AS, spans);
+  }
+
+  job=(struct rnaz_job *)space(sizeof(struct rnaz_job));
+  job->n_seq=n_seq;
+
+  /* Errors are raised by the writer, i.e. after all alignments
+     before this one have been reported. */
+  if (n_seq ==1){
+	job->error="ERROR: You need at least two sequences in the alignment.\n";
+	run->stop=1;
+	freeAln((struct aln **)AS);
+	return job;
+  }
+
+  run->countAln++;
+
+  job->length = spans[0].seqLength;
+
+  /* if a slice is specified by the user */
+
+  if ((run->from!=-1 || run->to!=-1) && (run->countAln==1)){
+
+	if ((run->from>=run->to)||(run->from<=0)||(run->to>job->length)){
+	  nrerror("ERROR: Invalid window range given.\n");
 	}
-	
-	countAln++;
-	
-	length = (int) strlen(AS[0]->seq);
-	
-	/* if a slice is specified by the user */
-  
-	if ((from!=-1 || to!=-1) && (countAln==1)){
-      
-	  if ((from>=to)||(from<=0)||(to>length)){
-		nrerror("ERROR: Invalid window range given.\n");
+
+	sliceSpans(spans, n_seq, (struct aln **)job->window, run->from, run->to);
+	job->length=run->to-run->from+1;
+  } else { /* take complete alignment */
+	/* window=AS does not work..., deep copy seems not necessary here*/
+	run->from=1;
+	run->to=job->length;
+	sliceSpans(spans, n_seq, (struct aln **)job->window, 1, job->length);
+  }
+  job->from=run->from;
+  job->to=run->to;
+  job->blockEnd=1;
+
+  freeAln((struct aln **)AS);
+
+  return job;
+}
+
+
+/********************************************************************
+ *                                                                  *
+ * read_window_job -- cuts the next window that passes the filters  *
+ *                    from the current alignment, reads the next    *
+ *                    alignment when all windows are done           *
+ *                                                                  *
+ ********************************************************************/
+
+PRIVATE void *read_window_job(struct rnaz_run *run){
+
+  struct rnaz_job *job;
+  int rows[MAX_NUM_NAMES];
+  int sliceEnd, n_seq;
+
+  while (1){
+
+	if (run->n_seq==0){
+	  run->AS[0]=NULL;
+	  if (run->map!=NULL){
+		n_seq=run->mapFunction(run->map, run->spans);
+	  } else {
+		n_seq=run->readFunction(run->clust_file, run->AS);
+		if (n_seq>0) alnSpans((const struct aln **)run->AS, run->spans);
 	  }
-	  
-	  sliceAln((const struct aln**)AS, (struct aln **)window, from, to);
-	  length=to-from+1;
-	} else { /* take complete alignment */
-	  /* window=AS does not work..., deep copy seems not necessary here*/
-	  from=1;
-	  to=length;
-	  sliceAln((const struct aln **)AS, (struct aln **)window, 1, length);
+	  if (n_seq==0) return NULL;
+
+	  run->countAln++;
+	  run->n_seq=n_seq;
+	  run->alnLength=run->spans[0].seqLength;
+	  run->sliceStart=0;
+	  run->stats=block_stats_create(run->spans, n_seq);
+	  memset(&run->offsets,0,sizeof(run->offsets));
+
+	  /* Short alignments are scored as a whole */
+	  run->windowLength=run->windowSize;
+	  if (run->alnLength<=run->windowSize) run->windowLength=run->alnLength;
 	}
 
-	 /* Convert all Us to Ts for RNAalifold. There is a slight
-	    difference in the results. During training we used alignments
-	    with Ts, so we use Ts here as well. */
+	/* The last window ends with the alignment */
+	sliceEnd=run->sliceStart+run->windowLength;
+	if (sliceEnd>run->alnLength){
+	  sliceEnd=run->alnLength;
+	  run->sliceStart=run->alnLength-run->windowLength;
+	}
 
-	for (i=0;i<n_seq;i++){
-	  j=0;
-	  while (window[i]->seq[j]){
-		window[i]->seq[j]=toupper(window[i]->seq[j]);
-		if (window[i]->seq[j]=='U') window[i]->seq[j]='T';
-		++j;
-	  }
+	job=(struct rnaz_job *)space(sizeof(struct rnaz_job));
+	job->n_seq=windowSpans(run->spans, run->n_seq, (struct aln **)job->window,
+						   rows, run->sliceStart+1, sliceEnd, &run->filter,
+						   &run->offsets);
+	if (job->n_seq>0 && run->stats!=NULL){
+	  job->values=window_values_create(run->stats, rows, job->n_seq,
+									   run->sliceStart+1, sliceEnd);
+	}
+	job->from=run->sliceStart+1;
+	job->to=sliceEnd;
+
+	run->sliceStart+=run->windowSlide;
+	if (sliceEnd==run->alnLength || run->sliceStart>=run->alnLength){
+	  job->blockEnd=1;
+	  freeAln((struct aln **)run->AS);
+	  block_stats_free(run->stats);
+	  run->stats=NULL;
+	  run->n_seq=0;
 	}
-	
-	k=0;
-	while ((currDirection=directions[k++])!=0){
-	  
-	  if (currDirection==REVERSE){
-		revAln((struct aln **)window);
-		strcpy(strand,"reverse");
-	  } else {
-		strcpy(strand,"forward");
-	  }
 
-	  structure = (char *) space((unsigned) length+1);
+	if (job->n_seq>0){
+	  job->length=strlen(job->window[0]->seq);
+	  return job;
+	}
+	/* The last window was filtered out: pass on an empty job, so the
+	   end of the alignment still reaches the writer */
+	if (job->blockEnd) return job;
+	free(job);
+  }
+}
 
-	  for (i=0;window[i]!=NULL;i++){
-		tmpAln[i]=window[i]->seq;
-	  }
-	  tmpAln[i]=NULL;
-
-	  min_en = alifold(tmpAln, structure);
-	  free_alifold_arrays();
-
-	  comb=combPerPair(window,structure);
-	  
-	  sumZ=0.0;
-	  sumMFE=0.0;
-	  GC=0.0;
-
-      /* output=(char *)space(sizeof(char)*(length+160)*(n_seq+1)*3); */
-
-	  strcpy(warningString,"");
-	  strcpy(warningString_regression,"");
-
-	  for (i=0;i<n_seq;i++){
-		singleStruc = space(strlen(window[i]->seq)+1);
-		woGapsSeq = space(strlen(window[i]->seq)+1);
-		j=0;
-		nonGaps=0;
-		singleGC=0;
-		while (window[i]->seq[j]){
-		  /* Convert all Ts to Us for RNAfold. There is a difference
-		     between the results. With U in the function call, we get
-		     the results as RNAfold gives on the command line. Since
-		     this variant was also used during training, we use it here
-		     as well. */
-		  if (window[i]->seq[j]=='T') window[i]->seq[j]='U';
-		  if (window[i]->seq[j]=='C') singleGC++;
-		  if (window[i]->seq[j]=='G') singleGC++;
-		  if (window[i]->seq[j]!='-'){
-		    nonGaps++;
-		    woGapsSeq[strlen(woGapsSeq)]=window[i]->seq[j];
-		    woGapsSeq[strlen(woGapsSeq)]='\0';
-		  }
-		  ++j;
-		}
-		
-		/* z-score is calculated here! */
-		singleMFE = fold(woGapsSeq, singleStruc);
-		free_arrays();
-		/* z-score type may be overwritten. If it is out of training
-		   bounds, we switch to shuffling if allowed (avoid_shuffle). */
-		int z_score_type_orig = z_score_type;
-
-
-		singleZ=mfe_zscore(woGapsSeq,singleMFE, &z_score_type, avoid_shuffle, warningString_regression);
-
-		GC+=(double) singleGC/nonGaps;
-		sumZ+=singleZ;
-        sumMFE+=singleMFE;
-
-        if (window[1]->strand!='?' && !args.window_given){
-          appendf(&output, &outputSize,
-            ">%s %d %d %c %d\n",
-            window[i]->name,
-            window[i]->start,
-            window[i]->length,window[i]->strand,
-            window[i]->fullLength);
-          /* sprintf(output+strlen(output),
-                  ">%s %d %d %c %d\n",
-                  window[i]->name,window[i]->start,
-                  window[i]->length,window[i]->strand,
-                  window[i]->fullLength); */
-		} else {
-          appendf( &output, &outputSize, ">%s\n", window[i]->name);
-          /*sprintf(output+strlen(output),">%s\n", window[i]->name); */
-		}
 
+/********************************************************************
+ *                                                                  *
+ * score_job -- folds and classifies one alignment; the report is   *
+ *              stored in the job. May run in several threads.      *
+ *              *worker holds the folding workspaces of the thread.  *
+ *                                                                  *
+ ********************************************************************/
+
+PRIVATE void score_job(void *item, void **worker, void *data){
 
-    gapStruc= (char *) space(sizeof(char)*(strlen(window[i]->seq)+1));
+  struct rnaz_run *run=(struct rnaz_run *)data;
+  struct rnaz_job *job=(struct rnaz_job *)item;
+  struct gengetopt_args_info *args=run->args;
+  struct aln **window=job->window;
+  char *tmpAln[MAX_NUM_NAMES];
+  char *woGapsSeqs[MAX_NUM_NAMES];
+  double singleGCs[MAX_NUM_NAMES];
+  struct composition comps[MAX_NUM_NAMES];
+  struct strand_blocks *blocks, *pending=NULL;
 
-    l=ll=0;
+  int n_seq=job->n_seq;
+  int length=job->length;
+  int z_score_type=run->z_score_type;
+  int decision_model_type=run->decision_model_type;
 
-    while (window[i]->seq[l]!='\0'){
-			if (window[i]->seq[l]!='-'){
-			  gapStruc[l]=singleStruc[ll];
-			  l++;
-			  ll++;
-			} else {
-			  gapStruc[l]='-';
-			  l++;
-			}
-    }
-    char ch;
-    ch = 'R';
-    if (z_score_type == 1 || z_score_type == 3) ch = 'S';
-		  		  
-    appendf( &output, &outputSize, "%s\n%s ( %6.2f, z-score = %6.2f, %c)\n",
-            window[i]->seq,gapStruc,singleMFE,singleZ,ch);
-    /* sprintf(output+strlen(output),"%s\n%s ( %6.2f, z-score = %6.2f, %c)\n",
-            window[i]->seq,gapStruc,singleMFE,singleZ,ch); */
-    z_score_type = z_score_type_orig;
-		  
-
-		free(woGapsSeq);
-        free(singleStruc);
-        free(gapStruc);
-		
-	  }
+  char *structure=NULL;
+  char strand[8];
+  char warningString[2000];
+  char warningString_regression[2000];
+  char *string=NULL;
+  double sumMFE,sumZ,z,sci,id,decValue,prob,comb,entropy,GC;
+  double min_en, real_en;
+  struct out_buffer output={NULL,0,0};
+  struct out_buffer *report=&job->report;
+  int i,j,k;
+  int currDirection, coordinates;
+  struct rnaz_worker *work;
+  struct aln_columns *cols;
+  struct rnaz_record rec;
+
+  if (job->error!=NULL || n_seq==0) return;
+
+  if (*worker==NULL){
+    work=(struct rnaz_worker *)space(sizeof(struct rnaz_worker));
+    work->fold=fold_ctx_create(length);
+    work->alifold=alifold_ctx_create(length,n_seq);
+    *worker=work;
+  }
+  work=(struct rnaz_worker *)*worker;
+
+  /* Convert all Us to Ts for RNAalifold. There is a slight
+	 difference in the results. During training we used alignments
+	 with Ts, so we use Ts here as well. */
+
+  for (i=0;i<n_seq;i++){
+	j=0;
+	while (window[i]->seq[j]){
+	  window[i]->seq[j]=toupper(window[i]->seq[j]);
+	  if (window[i]->seq[j]=='U') window[i]->seq[j]='T';
+	  ++j;
+	}
+  }
 
-	  {
-		int i; double s=0;
-		extern int eos_debug;
-		eos_debug=-1; /* shut off warnings about nonstandard pairs */
-		for (i=0; window[i]!=NULL; i++) 
-		  s += energy_of_struct(window[i]->seq, structure);
-		real_en = s/i;
-	  }
+  /* The per-sequence blocks show the coordinates of MAF entries */
+  coordinates=(window[1]->strand!='?' && !args->window_given);
+
+  blocks=(struct strand_blocks *)space(sizeof(struct strand_blocks));
+
+  k=0;
+  while ((currDirection=run->directions[k++])!=0){
+
+	if (currDirection==REVERSE){
+	  revAln((struct aln **)window);
+	  strcpy(strand,"reverse");
+	} else {
+	  strcpy(strand,"forward");
+	}
+
+	structure = (char *) space((unsigned) length+1);
+
+	for (i=0;window[i]!=NULL;i++){
+	  tmpAln[i]=window[i]->seq;
+	}
+	tmpAln[i]=NULL;
+
+	min_en = alifold_r(work->alifold, tmpAln, structure);
 
-	  string = consensus((const struct aln**) window);
-      appendf( &output, &outputSize,
-               ">consensus\n%s\n%s (%6.2f = %6.2f + %6.2f) \n",
-               string, structure, min_en, real_en, min_en-real_en );
-      /* sprintf(output+strlen(output),
-			  ">consensus\n%s\n%s (%6.2f = %6.2f + %6.2f) \n",
-              string, structure, min_en, real_en, min_en-real_en ); */
-	  free(string);
-
-	  id=meanPairID((const struct aln**)window);
-	  entropy=NormShannonEntropy((const struct aln**)window);
-	  z=sumZ/n_seq;
-	  GC=(double)GC/n_seq;
-
-	  if (sumMFE==0){ 
-		/*Set SCI to 0 in the weird case of no structure in single
-		  sequences*/
-		sci=0;
+	/* letter counts of the columns for the alignment statistics; T
+	   becomes U below, which does not change them */
+	cols=alnColumns((const struct aln **)window);
+
+	sumZ=0.0;
+	sumMFE=0.0;
+	GC=0.0;
+
+	strcpy(warningString,"");
+	strcpy(warningString_regression,"");
+
+	for (i=0;i<n_seq;i++){
+	  blocks->singleStrucs[i] = space(strlen(window[i]->seq)+1);
+	  woGapsSeqs[i] = space(strlen(window[i]->seq)+1);
+
+	  /* Convert all Ts to Us for RNAfold. There is a difference
+		 between the results. With U in the function call, we get
+		 the results as RNAfold gives on the command line. Since
+		 this variant was also used during training, we use it here
+		 as well. The same pass counts the bases for the z-score,
+		 the G+C content and the warnings. */
+	  if (job->values!=NULL){
+		if (currDirection==FORWARD){
+		  comps[i]=job->values->comps[i];
+		} else {
+		  reverse_composition(&job->values->comps[i], &comps[i]);
+		}
+		sequence_composition(window[i]->seq, window[i]->seq, woGapsSeqs[i],
+							 NULL);
 	  } else {
-		sci=min_en/(sumMFE/n_seq);
+		sequence_composition(window[i]->seq, window[i]->seq, woGapsSeqs[i],
+							 &comps[i]);
 	  }
 
-	  
-	  	  
-	  decValue=999;
-	  prob=0;
-	
-	  classify(&prob,&decValue,decision_model,id,n_seq,z,sci,entropy,decision_model_type);
+	  blocks->singleMFEs[i] = fold_r(work->fold, woGapsSeqs[i], blocks->singleStrucs[i]);
+	  singleGCs[i] = (double) (comps[i].bases[1]+comps[i].bases[2])/comps[i].length;
+	  blocks->z_score_types[i] = z_score_type;
+	}
+
+	/* z-scores are calculated here, for all sequences at once! The
+	   z-score type of a sequence may be overwritten. If it is out of
+	   training bounds, we switch to shuffling if allowed
+	   (avoid_shuffle). */
+	mfe_zscore_batch((const char **)woGapsSeqs, comps, blocks->singleMFEs, n_seq,
+					 blocks->singleZs, blocks->z_score_types, run->avoid_shuffle,
+					 warningString_regression);
+
+	for (i=0;i<n_seq;i++){
+	  GC+=singleGCs[i];
+	  sumZ+=blocks->singleZs[i];
+	  sumMFE+=blocks->singleMFEs[i];
+	  free(woGapsSeqs[i]);
+	}
+
+	if (job->values!=NULL){
+	  id=job->values->id;
+	  entropy=job->values->entropy[currDirection-1];
+	} else {
+	  id=meanPairIDColumns(cols);
+	  entropy=NormShannonEntropyColumns(cols);
+	}
+	z=sumZ/n_seq;
+	GC=(double)GC/n_seq;
+
+	if (sumMFE==0){
+	  /*Set SCI to 0 in the weird case of no structure in single
+		sequences*/
+	  sci=0;
+	} else {
+	  sci=min_en/(sumMFE/n_seq);
+	}
+
+	decValue=999;
+	prob=0;
+
+	classify(&prob,&decValue,run->decision_model,id,n_seq,z,sci,entropy,decision_model_type);
 
-	  if (args.cutoff_given){
-		if (prob<args.cutoff_arg){
-		  continue;
+	for (i=0;i<=n_seq;i++){
+	  blocks->window[i]=window[i];
+	}
+	blocks->structure=structure;
+	blocks->min_en=min_en;
+
+	/* What follows is only needed for the output, so it is skipped
+	   for directions below the cutoff. Their per-sequence blocks are
+	   still shown in the report of the next direction, so they are
+	   kept until then. */
+	if (args->cutoff_given){
+	  if (prob<args->cutoff_arg){
+		if (run->format==TEXT_OUT && run->directions[k]!=0){
+		  for (i=0;i<n_seq;i++){
+			blocks->window[i]=createAlnEntry(strdup(window[i]->name),
+											 strdup(window[i]->seq),
+											 window[i]->start,
+											 window[i]->length,
+											 window[i]->fullLength,
+											 window[i]->strand);
+		  }
+		  blocks->ownWindow=1;
+		  if (job->values!=NULL){
+			blocks->consensus=strdup(job->values->consensus[currDirection-1]);
+		  } else {
+			blocks->consensus=consensusColumns(cols);
+		  }
+		  pending=blocks;
+		  blocks=(struct strand_blocks *)space(sizeof(struct strand_blocks));
+		} else {
+		  free_blocks(blocks,n_seq);
 		}
+		freeAlnColumns(cols);
+		continue;
 	  }
+	}
 
-	  warning(warningString,id,n_seq,z,sci,entropy,(struct aln **)window,decision_model_type);
-	  
-
- 	  fprintf(out,"\n############################  RNAz "PACKAGE_VERSION"  ##############################\n\n"); 
- 	  fprintf(out," Sequences: %u\n", n_seq); 
-
- 	  if (args.window_given){ 
- 		fprintf(out," Slice: %u to %u\n",from,to); 
- 	  } 
- 	  fprintf(out," Columns: %u\n",length);
- 	  fprintf(out," Reading direction: %s\n",strand); 
-	  fprintf(out," Mean pairwise identity: %6.2f\n", id);
-	  fprintf(out," Shannon entropy: %2.5f\n", entropy);
-	  fprintf(out," G+C content: %2.5f\n", GC);
- 	  fprintf(out," Mean single sequence MFE: %6.2f\n", sumMFE/n_seq); 
- 	  fprintf(out," Consensus MFE: %6.2f\n",min_en); 
- 	  fprintf(out," Energy contribution: %6.2f\n",real_en); 
- 	  fprintf(out," Covariance contribution: %6.2f\n",min_en-real_en); 
- 	  fprintf(out," Combinations/Pair: %6.2f\n",comb); 
-	  fprintf(out," Mean z-score: %6.2f\n",z);
-	  fprintf(out," Structure conservation index: %6.2f\n",sci);
+	comb=combPerPairColumns(window,cols,structure);
+	real_en=consensus_energy(window,structure);
+
+	if (job->values!=NULL){
+	  string = strdup(job->values->consensus[currDirection-1]);
+	} else {
+	  string = consensusColumns(cols);
+	}
+	blocks->consensus=string;
+	freeAlnColumns(cols);
+
+	if (run->format!=TEXT_OUT){
+	  record_coordinates(job, args->window_given, currDirection, &rec);
+	  rec.N=n_seq;
+	  rec.columns=length;
+	  rec.identity=id;
+	  rec.entropy=entropy;
+	  rec.GC=GC;
+	  rec.meanMFE=sumMFE/n_seq;
+	  rec.consensusMFE=min_en;
+	  rec.energy=real_en;
+	  rec.covariance=min_en-real_en;
+	  rec.combPerPair=comb;
+	  rec.z=z;
+	  rec.sci=sci;
+	  rec.decValue=decValue;
+	  rec.P=prob;
+	  rec.consensusSeq=NULL;
+	  rec.consensusFold=NULL;
+	  if (args->structures_flag){
+		rec.consensusSeq=string;
+		rec.consensusFold=structure;
+	  }
+	  append_record(job, run->format, &rec);
+	} else {
+	  if (pending!=NULL){
+		append_blocks(&output, pending, n_seq, coordinates,
+					  consensus_energy(pending->window, pending->structure));
+		free_blocks(pending,n_seq);
+		free(pending);
+		pending=NULL;
+	  }
+	  append_blocks(&output, blocks, n_seq, coordinates, real_en);
+
+	  warning(warningString,id,n_seq,z,sci,entropy,comps,decision_model_type);
+
+	  out_puts(report,"\n############################  RNAz "PACKAGE_VERSION"  ##############################\n\n");
+	  report_count(report," Sequences: ",n_seq);
+
+	  if (args->window_given){
+		out_puts(report," Slice: ");
+		out_int(report,job->from);
+		out_puts(report," to ");
+		out_int(report,job->to);
+		out_putc(report,'\n');
+	  }
+	  report_count(report," Columns: ",length);
+	  out_puts(report," Reading direction: ");
+	  out_puts(report,strand);
+	  out_putc(report,'\n');
+	  report_value(report," Mean pairwise identity: ",id,6,2);
+	  report_value(report," Shannon entropy: ",entropy,2,5);
+	  report_value(report," G+C content: ",GC,2,5);
+	  report_value(report," Mean single sequence MFE: ",sumMFE/n_seq,6,2);
+	  report_value(report," Consensus MFE: ",min_en,6,2);
+	  report_value(report," Energy contribution: ",real_en,6,2);
+	  report_value(report," Covariance contribution: ",min_en-real_en,6,2);
+	  report_value(report," Combinations/Pair: ",comb,6,2);
+	  report_value(report," Mean z-score: ",z,6,2);
+	  report_value(report," Structure conservation index: ",sci,6,2);
 	  if (decision_model_type == 1) {
-	    fprintf(out," Background model: mononucleotide\n");
-	    fprintf(out," Decision model: sequence based alignment quality\n");
+		out_puts(report," Background model: mononucleotide\n");
+		out_puts(report," Decision model: sequence based alignment quality\n");
 	  }
 	  if (decision_model_type == 2) {
-	    fprintf(out," Background model: dinucleotide\n");
-	    fprintf(out," Decision model: sequence based alignment quality\n");
+		out_puts(report," Background model: dinucleotide\n");
+		out_puts(report," Decision model: sequence based alignment quality\n");
 	  }
 	  if (decision_model_type == 3) {
-	    fprintf(out," Background model: dinucleotide\n");
-	    fprintf(out," Decision model: structural RNA alignment quality\n");
+		out_puts(report," Background model: dinucleotide\n");
+		out_puts(report," Decision model: structural RNA alignment quality\n");
+	  }
+	  report_value(report," SVM decision value: ",decValue,6,2);
+	  report_value(report," SVM RNA-class probability: ",prob,6,6);
+	  if (prob>0.5){
+		out_puts(report," Prediction: RNA\n");
 	  }
- 	  fprintf(out," SVM decision value: %6.2f\n",decValue); 
- 	  fprintf(out," SVM RNA-class probability: %6f\n",prob); 
- 	  if (prob>0.5){ 
- 		fprintf(out," Prediction: RNA\n"); 
- 	  } 
- 	  else { 
- 		fprintf(out," Prediction: OTHER\n"); 
- 	  } 
-
-	  fprintf(out,"%s",warningString_regression);
-
-	  fprintf(out,"%s",warningString);
-	  
- 	  fprintf(out,"\n######################################################################\n\n"); 
-
-      fprintf(out,"%s",output);
-	
-	  fflush(out);
-
-	  free(structure);
-      /*
-       * No need to free output yet. By setting the first char of buffer to 0,
-       * the entire buffer will be overwritten during the next iteration.
-       */
-      output[0] = 0;
-      /* free(output); */
-
-	  if (currDirection==FORWARD && args.predict_strand_flag){
-		meanMFE_fwd=sumMFE/n_seq;
-		consensusMFE_fwd=min_en;
-		sci_fwd=sci;
-		z_fwd=z;
+	  else {
+		out_puts(report," Prediction: OTHER\n");
 	  }
 
-	  if (currDirection==REVERSE && args.predict_strand_flag){
+	  out_puts(report,warningString_regression);
 
-		if (predict_strand(sci_fwd-sci, meanMFE_fwd-(sumMFE/n_seq),
-						   consensusMFE_fwd-min_en, z_fwd-z, n_seq, id, 
-						   &strandGuess, &strandProb, &strandDec, NULL)){
-		  if (strandGuess==1){
-			fprintf(out, "\n# Strand winner: forward (%.2f)\n",strandProb);
-		  } else {
-			fprintf(out, "\n# Strand winner: reverse (%.2f)\n",1-strandProb);
-		  }
+	  out_puts(report,warningString);
+
+	  out_puts(report,"\n######################################################################\n\n");
+
+	  out_putn(report,output.text,output.length);
+	}
+
+	/* Start the per-sequence blocks of the next direction */
+	out_clear(&output);
+
+	free_blocks(blocks,n_seq);
+
+	job->reported[currDirection]=1;
+	job->meanMFE[currDirection]=sumMFE/n_seq;
+	job->consensusMFE[currDirection]=min_en;
+	job->sci[currDirection]=sci;
+	job->z[currDirection]=z;
+	job->id[currDirection]=id;
+  }
+  if (pending!=NULL){
+	free_blocks(pending,n_seq);
+	free(pending);
+  }
+  free(blocks);
+  freeAln((struct aln **)window);
+  window_values_free(job->values);
+  out_free(&output);
+}
+
+
+/********************************************************************
+ *                                                                  *
+ * consensus_energy -- mean energy of the consensus structure in    *
+ *                     the sequences of an alignment                *
+ *                                                                  *
+ ********************************************************************/
+
+PRIVATE double consensus_energy(struct aln *window[], const char *structure){
+
+  int i;
+  double s=0;
+
+  for (i=0; window[i]!=NULL; i++)
+	s += energy_of_struct(window[i]->seq, structure);
+  return s/i;
+}
+
+
+/********************************************************************
+ *                                                                  *
+ * append_blocks -- adds the sequences with their structures and    *
+ *                  the consensus of one direction to the report    *
+ *                                                                  *
+ ********************************************************************/
+
+PRIVATE void append_blocks(struct out_buffer *output,
+                           const struct strand_blocks *blocks, int n_seq,
+                           int coordinates, double real_en){
+
+  struct aln *const *window=blocks->window;
+  char *gapStruc;
+  const char *singleStruc;
+  char ch;
+  int i,l,ll;
+
+  for (i=0;i<n_seq;i++){
+
+	out_putc(output,'>');
+	out_puts(output,window[i]->name);
+	if (coordinates){
+	  out_putc(output,' ');
+	  out_int(output,window[i]->start);
+	  out_putc(output,' ');
+	  out_int(output,window[i]->length);
+	  out_putc(output,' ');
+	  out_putc(output,window[i]->strand);
+	  out_putc(output,' ');
+	  out_int(output,window[i]->fullLength);
+	}
+	out_putc(output,'\n');
+
+	/* the structure with the gaps of the sequence */
+	singleStruc=blocks->singleStrucs[i];
+	gapStruc= (char *) space(sizeof(char)*(strlen(window[i]->seq)+1));
+
+	l=ll=0;
+
+	while (window[i]->seq[l]!='\0'){
+	  if (window[i]->seq[l]!='-'){
+		gapStruc[l]=singleStruc[ll];
+		l++;
+		ll++;
+	  } else {
+		gapStruc[l]='-';
+		l++;
+	  }
+	}
+
+	ch = 'R';
+	if (blocks->z_score_types[i] == 1 || blocks->z_score_types[i] == 3) ch = 'S';
+
+	out_puts(output,window[i]->seq);
+	out_putc(output,'\n');
+	out_puts(output,gapStruc);
+	out_puts(output," ( ");
+	out_fixed(output,blocks->singleMFEs[i],6,2);
+	out_puts(output,", z-score = ");
+	out_fixed(output,blocks->singleZs[i],6,2);
+	out_puts(output,", ");
+	out_putc(output,ch);
+	out_puts(output,")\n");
+
+	free(gapStruc);
+  }
+
+  out_puts(output,">consensus\n");
+  out_puts(output,blocks->consensus);
+  out_putc(output,'\n');
+  out_puts(output,blocks->structure);
+  out_puts(output," (");
+  out_fixed(output,blocks->min_en,6,2);
+  out_puts(output," = ");
+  out_fixed(output,real_en,6,2);
+  out_puts(output," + ");
+  out_fixed(output,blocks->min_en-real_en,6,2);
+  out_puts(output,") \n");
+}
+
+
+/********************************************************************
+ *                                                                  *
+ * free_blocks -- releases what the blocks of a direction hold; the *
+ *                struct itself can be used again                   *
+ *                                                                  *
+ ********************************************************************/
+
+PRIVATE void free_blocks(struct strand_blocks *blocks, int n_seq){
+
+  int i;
+
+  for (i=0;i<n_seq;i++){
+	free(blocks->singleStrucs[i]);
+	blocks->singleStrucs[i]=NULL;
+  }
+  if (blocks->ownWindow){
+	freeAln(blocks->window);
+	blocks->ownWindow=0;
+  }
+  free(blocks->consensus);
+  free(blocks->structure);
+  blocks->consensus=NULL;
+  blocks->structure=NULL;
+}
+
+
+/********************************************************************
+ *                                                                  *
+ * write_job -- prints the report of a job and frees it. Jobs are   *
+ *              written in the order they were read.                *
+ *                                                                  *
+ ********************************************************************/
+
+PRIVATE void write_job(void *item, void *data){
+
+  struct rnaz_run *run=(struct rnaz_run *)data;
+  struct rnaz_job *job=(struct rnaz_job *)item;
+  FILE *out=run->out;
+  int strandGuess;
+  double strandProb,strandDec;
+
+  if (job->error!=NULL){
+	nrerror(job->error);
+  }
+
+  out_write(&job->report,out);
+
+  if (run->args->predict_strand_flag){
+
+	if (job->reported[FORWARD]){
+	  run->meanMFE_fwd=job->meanMFE[FORWARD];
+	  run->consensusMFE_fwd=job->consensusMFE[FORWARD];
+	  run->sci_fwd=job->sci[FORWARD];
+	  run->z_fwd=job->z[FORWARD];
+	}
+
+	if (job->reported[REVERSE]){
+
+	  if (predict_strand(run->sci_fwd-job->sci[REVERSE],
+						 run->meanMFE_fwd-job->meanMFE[REVERSE],
+						 run->consensusMFE_fwd-job->consensusMFE[REVERSE],
+						 run->z_fwd-job->z[REVERSE], job->n_seq,
+						 job->id[REVERSE],
+						 &strandGuess, &strandProb, &strandDec, NULL)){
+		if (strandGuess==1){
+		  fprintf(out, "\n# Strand winner: forward (%.2f)\n",strandProb);
 		} else {
-		  fprintf(out, "\n# WARNING: No strand prediction (values out of range)\n");
+		  fprintf(out, "\n# Strand winner: reverse (%.2f)\n",1-strandProb);
 		}
+	  } else {
+		fprintf(out, "\n# WARNING: No strand prediction (values out of range)\n");
 	  }
 	}
-	freeAln((struct aln **)AS);
-	freeAln((struct aln **)window);
-    free(output);
-    output     = NULL;
-    outputSize = 0;
-	
   }
-  if (args.inputs_num>=1){
-    fclose(clust_file);
+
+  /* Flushing after each window is slow on network file systems, so it
+     is only done at the end of an input alignment or every
+     --flush-interval seconds (never with 0) */
+  if (run->flushInterval<0){
+	if (job->blockEnd) fflush(out);
+  } else if (run->flushInterval>0 && time(NULL)-run->lastFlush>=run->flushInterval){
+	fflush(out);
+	run->lastFlush=time(NULL);
   }
-  cmdline_parser_free (&args);
 
-  if (countAln==0){
-	nrerror("ERROR: Empty alignment file\n");
+  out_free(&job->report);
+  free(job);
+}
+
+
+/********************************************************************
+ *                                                                  *
+ * report_value, report_count -- one line of the text report        *
+ *                                                                  *
+ ********************************************************************/
+
+PRIVATE void report_value(struct out_buffer *report, const char *label,
+                          double value, int width, int decimals){
+  out_puts(report,label);
+  out_fixed(report,value,width,decimals);
+  out_putc(report,'\n');
+}
+
+PRIVATE void report_count(struct out_buffer *report, const char *label,
+                          int count){
+  out_puts(report,label);
+  out_int(report,count);
+  out_putc(report,'\n');
+}
+
+
+/********************************************************************
+ *                                                                  *
+ * record_coordinates -- name and position of the reference         *
+ *                       sequence (the first one) for a record      *
+ *                                                                  *
+ ********************************************************************
+ *                                                                  *
+ * MAF entries have genomic coordinates. Otherwise the name is      *
+ * split if it ends with /START-END (as the windows of Clustal W    *
+ * alignments are named), else the alignment columns are used.      *
+ * The strands are given as in parseRNAz() of RNAz.pm.              *
+ *                                                                  *
+ ********************************************************************/
+
+PRIVATE void record_coordinates(const struct rnaz_job *job, int window_given,
+                               int direction, struct rnaz_record *rec){
+
+  const struct aln *ref=job->window[0];
+  const char *slash;
+  int from, to, n;
+
+  rec->strand=(direction==FORWARD) ? '+' : '-';
+  rec->name=ref->name;
+  rec->nameLength=strlen(ref->name);
+
+  if (ref->strand!='?' && !window_given){
+	rec->start=ref->start;
+	rec->end=ref->start+ref->length;
+	rec->refStrand=ref->strand;
+	return;
+  }
+
+  rec->start=job->from;
+  rec->end=job->to;
+  rec->refStrand=rec->strand;
+
+  slash=strrchr(ref->name,'/');
+  if (slash!=NULL && sscanf(slash+1,"%d-%d%n",&from,&to,&n)==2 && slash[1+n]=='\0'){
+	rec->nameLength=slash-ref->name;
+	rec->start=from;
+	rec->end=to;
   }
-  
-  
-  svm_destroy_model(decision_model);
-  regression_svm_free();
-  
-  
-  return 0;
+}
+
+
+/********************************************************************
+ *                                                                  *
+ * write_header -- first line of the records: the column names for  *
+ *                 tsv, a magic line for bin, nothing for jsonl     *
+ *                                                                  *
+ ********************************************************************/
+
+PRIVATE const char *record_fields[]={"refSeqName", "refSeqStart", "refSeqEnd",
+  "refSeqStrand", "strand", "N", "columns", "identity", "entropy", "GC",
+  "meanMFE", "consensusMFE", "energy", "covariance", "combPerPair", "z",
+  "sci", "decValue", "P", "consensusSeq", "consensusFold", NULL};
+
+/* Decimals of identity ... P, as in the text report */
+PRIVATE const int record_decimals[12]={2, 5, 5, 2, 2, 2, 2, 2, 2, 2, 2, 6};
+
+PRIVATE void write_header(FILE *out, int format, int structures){
+
+  int i;
+
+  if (format==TSV_OUT){
+	fprintf(out,"#%s",record_fields[0]);
+	for (i=1;record_fields[i]!=NULL;i++){
+	  if (!structures && strcmp(record_fields[i],"consensusSeq")==0) break;
+	  fprintf(out,"\t%s",record_fields[i]);
+	}
+	fprintf(out,"\n");
+  }
+  if (format==BIN_OUT){
+	fprintf(out,"#RNAz binary records 1\n");
+  }
+}
+
+
+/********************************************************************
+ *                                                                  *
+ * append_record -- adds one record to the output of a job          *
+ *                                                                  *
+ ********************************************************************
+ *                                                                  *
+ * tsv and jsonl show the values as the text report does, so        *
+ * rnazCluster.pl gives the same results for all formats. Binary    *
+ * records (native byte order) have the full precision:             *
+ *                                                                  *
+ *   unsigned int   size of the rest of the record                  *
+ *   int            refSeqStart, refSeqEnd, N, columns              *
+ *   char           refSeqStrand, strand                            *
+ *   double         identity ... P in the order of record_fields    *
+ *   unsigned int   length, followed by refSeqName                  *
+ *   unsigned int   length, followed by consensusSeq                *
+ *   unsigned int   length, followed by consensusFold               *
+ *                                                                  *
+ * The consensus has length 0 if structures are not shown.          *
+ *                                                                  *
+ ********************************************************************/
+
+PRIVATE void append_string(struct out_buffer *buf, const char *string,
+                           unsigned length){
+  out_putn(buf,(const char *)&length,sizeof(length));
+  out_putn(buf,string,length);
+}
+
+PRIVATE void append_json_string(struct out_buffer *buf, const char *key,
+                                const char *string, int length){
+  int i;
+
+  out_putc(buf,'"');
+  out_puts(buf,key);
+  out_puts(buf,"\":\"");
+  for (i=0;i<length;i++){
+	if (string[i]=='"' || string[i]=='\\'){
+	  out_putc(buf,'\\');
+	  out_putc(buf,string[i]);
+	} else if ((unsigned char)string[i]<0x20){
+	  out_printf(buf,"\\u%04x",(unsigned char)string[i]);
+	} else {
+	  out_putc(buf,string[i]);
+	}
+  }
+  out_putc(buf,'"');
+}
+
+/* JSON has no NaN or infinity */
+PRIVATE void append_json_number(struct out_buffer *buf, const char *key,
+                                int decimals, double value){
+
+  out_puts(buf,",\"");
+  out_puts(buf,key);
+  out_puts(buf,"\":");
+  if (isfinite(value)){
+	out_fixed(buf,value,0,decimals);
+  } else {
+	out_puts(buf,"null");
+  }
+}
+
+PRIVATE void append_record(struct rnaz_job *job, int format,
+                           const struct rnaz_record *rec){
+
+  struct out_buffer *buf=&job->report;
+  double values[12];
+  int ints[4];
+  unsigned size, consLength;
+  int i;
+
+  consLength=(rec->consensusSeq!=NULL) ? strlen(rec->consensusSeq) : 0;
+
+  values[0]=rec->identity;
+  values[1]=rec->entropy;
+  values[2]=rec->GC;
+  values[3]=rec->meanMFE;
+  values[4]=rec->consensusMFE;
+  values[5]=rec->energy;
+  values[6]=rec->covariance;
+  values[7]=rec->combPerPair;
+  values[8]=rec->z;
+  values[9]=rec->sci;
+  values[10]=rec->decValue;
+  values[11]=rec->P;
+
+  if (format==TSV_OUT){
+	out_putn(buf,rec->name,rec->nameLength);
+	out_putc(buf,'\t');
+	out_int(buf,rec->start);
+	out_putc(buf,'\t');
+	out_int(buf,rec->end);
+	out_putc(buf,'\t');
+	out_putc(buf,rec->refStrand);
+	out_putc(buf,'\t');
+	out_putc(buf,rec->strand);
+	out_putc(buf,'\t');
+	out_int(buf,rec->N);
+	out_putc(buf,'\t');
+	out_int(buf,rec->columns);
+	for (i=0;i<12;i++){
+	  out_putc(buf,'\t');
+	  out_fixed(buf,values[i],0,record_decimals[i]);
+	}
+	if (rec->consensusSeq!=NULL){
+	  out_putc(buf,'\t');
+	  out_puts(buf,rec->consensusSeq);
+	  out_putc(buf,'\t');
+	  out_putn(buf,rec->consensusFold,consLength);
+	}
+	out_putc(buf,'\n');
+	return;
+  }
+
+  if (format==JSONL_OUT){
+	out_putc(buf,'{');
+	append_json_string(buf,"refSeqName",rec->name,rec->nameLength);
+	out_puts(buf,",\"refSeqStart\":");
+	out_int(buf,rec->start);
+	out_puts(buf,",\"refSeqEnd\":");
+	out_int(buf,rec->end);
+	out_puts(buf,",\"refSeqStrand\":\"");
+	out_putc(buf,rec->refStrand);
+	out_puts(buf,"\",\"strand\":\"");
+	out_putc(buf,rec->strand);
+	out_puts(buf,"\",\"N\":");
+	out_int(buf,rec->N);
+	out_puts(buf,",\"columns\":");
+	out_int(buf,rec->columns);
+	for (i=0;i<12;i++){
+	  append_json_number(buf,record_fields[7+i],record_decimals[i],values[i]);
+	}
+	if (rec->consensusSeq!=NULL){
+	  out_putc(buf,',');
+	  append_json_string(buf,"consensusSeq",rec->consensusSeq,consLength);
+	  out_putc(buf,',');
+	  append_json_string(buf,"consensusFold",rec->consensusFold,consLength);
+	}
+	out_puts(buf,"}\n");
+	return;
+  }
+
+  ints[0]=rec->start;
+  ints[1]=rec->end;
+  ints[2]=rec->N;
+  ints[3]=rec->columns;
+
+  size=sizeof(ints)+2+sizeof(values)+3*sizeof(unsigned)
+	+rec->nameLength+2*consLength;
+  out_putn(buf,(const char *)&size,sizeof(size));
+  out_putn(buf,(const char *)ints,sizeof(ints));
+  out_putc(buf,rec->refStrand);
+  out_putc(buf,rec->strand);
+  out_putn(buf,(const char *)values,sizeof(values));
+  append_string(buf,rec->name,rec->nameLength);
+  append_string(buf,rec->consensusSeq,consLength);
+  append_string(buf,rec->consensusFold,consLength);
+}
+
+
+/********************************************************************
+ *                                                                  *
+ * free_worker -- releases the folding workspaces of a worker       *
+ *                                                                  *
+ ********************************************************************/
+
+PRIVATE void free_worker(void *worker, void *data){
+
+  struct rnaz_worker *work=(struct rnaz_worker *)worker;
+
+  fold_ctx_destroy(work->fold);
+  alifold_ctx_destroy(work->alifold);
+  free(work);
+
+  /* mfe_zscore() folds with fold_energy_only(NULL, ...), i.e. with the
+     thread's default arrays, when it is not given the mfe */
+  free_arrays();
+  free_shuffle_workspace();
 }
 
 
@@ -686,14 +1576,13 @@ PRIVATE void classify(double* prob, double* decValue,
 
 PRIVATE void warning(char* string, double id, int n_seq, 
 		     double z, double sci, double entropy,
-		     struct aln *AS[], int decision_model_type){
+		     const struct composition *comps, int decision_model_type){
 
   /* Now we throw warnings fors the old RNAz 1.0 */
   
   if (decision_model_type == 1) {
     double GC,A,C;
-    int i,j,length,n_A,n_C,n_T,n_G;
-    char *seq;
+    int i,length,n_A,n_C,n_T,n_G;
     
     if (id>100.0) {
       strcpy(string," WARNING: Mean pairwise identity too large.\n");
@@ -725,24 +1614,14 @@ PRIVATE void warning(char* string, double id, int n_seq,
       string+=strlen(string);
     }
     
-    for (i=0;AS[i]!=NULL;i++){
-      seq=AS[i]->seq;
-      
-      //printf("SEQ: %s\n",seq);
-      
-      n_A=n_T=n_G=n_C=0;
-      
-      for (j=0; j<strlen(seq); j++) {
-	switch (seq[j]) {
-	case 'A': n_A++; break;
-	case 'C': n_C++; break;
-	case 'G': n_G++; break;
-	case 'T': n_T++; break;
-	case 'U': n_T++; break;  
-	}
-      }
-      
-      length=strlen(seq);
+    for (i=0;i<n_seq;i++){
+      n_A=comps[i].bases[0];
+      n_C=comps[i].bases[1];
+      n_G=comps[i].bases[2];
+      n_T=comps[i].bases[3]+comps[i].bases[4];
+
+      /* with gaps */
+      length=comps[i].length+comps[i].gaps;
       
       GC=((double)(n_G+n_C)/(double)(n_G+n_C+n_A+n_T));
       A=((double)n_A/(n_A+n_T));
@@ -819,6 +1698,26 @@ PRIVATE void help(void){
   printf("%s\n","  -m, --mononucleotide    Use mononucleotide shuffled z-scores");
   printf("%s\n","  -l, --locarnate         Use decision model for structural alignments (default=off)");
   printf("%s\n","  -n, --no-shuffle        Never fall back to shuffling (default=off)");
+  printf("%s\n","  -t, --threads=INT       Number of alignments scored in parallel (default=1)");
+  printf("%s\n","      --format=FORMAT     Output format: text, tsv, jsonl or bin (default=text)");
+  printf("%s\n","      --structures        Add the consensus structure to the records");
+  printf("%s\n","      --flush-interval=INT  Flush the output every INT seconds (default=after each alignment)");
+  printf("%s\n","      --window-size=INT   Score windows of INT columns (default=off)");
+  printf("%s\n","      --window-slide=INT  Step size of the windows (default=40)");
+  printf("%s\n","      --min-length=INT    Minimum number of columns of a window (default=50)");
+  printf("%s\n","      --max-gap=FLOAT     Maximum fraction of gaps of a sequence (default=0.25)");
+  printf("%s\n","      --max-masked=FLOAT  Maximum fraction of masked letters (default=0.1)");
+  printf("%s\n","      --min-seqs=INT      Minimum number of sequences in a window (default=2)");
+  printf("%s\n","      --max-seqs=INT      Maximum number of sequences in a window (default=6)");
+  printf("%s\n","      --min-id=FLOAT      Minimum mean pairwise identity (default=50)");
+  printf("%s\n","      --opt-id=FLOAT      Optimal pairwise identity (default=80)");
+  printf("%s\n","      --max-id=FLOAT      Maximum pairwise identity (default=100)");
+  printf("%s\n","      --no-reference      Do not use the first sequence as reference");
+  printf("%s\n","      --no-rangecheck     Keep sequences outside the training range");
+  printf("%s\n","      --seed=INT          Seed for explicit shuffling (default=1)");
+  printf("%s\n","      --shuffle-threads=INT  Number of threads folding shuffled sequences (default=1)");
+  printf("%s\n","      --shuffle-samples=MIN-MAX  Number of shuffled sequences (default=1000)");
+  printf("%s\n","      --shuffle-stop=FLOAT  Stop shuffling once the z-score is known to +-FLOAT");
   printf("%s\n","  -h, --help              Print this help screen");
   printf("%s\n\n","  -V, --version           Show version information");
 
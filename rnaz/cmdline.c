@@ -32,26 +32,47 @@ const char *gengetopt_args_info_usage = "Usage: " CMDLINE_PARSER_PACKAGE " [OPTI
 const char *gengetopt_args_info_description = "";
 
 const char *gengetopt_args_info_help[] = {
-  "  -h, --help            Print help and exit",
-  "  -V, --version         Print version and exit",
-  "  -f, --forward         Score forward strand  (default=off)",
-  "  -r, --reverse         Score reverse strand  (default=off)",
-  "  -b, --both-strands    Score both strands  (default=off)",
-  "  -o, --outfile=STRING  Output filename",
-  "  -w, --window=STRING   Score window",
-  "  -p, --cutoff=FLOAT    Probability cutoff",
-  "  -s, --predict-strand  Use strand predictor  (default=off)",
-  "  -x, --plot            Generate graphical output  (default=off)",
-  "  -d, --dinucleotide    Use dinucleotide based z-scores (default)  \n                          (default=off)",
-  "  -m, --mononucleotide  Use dinucleotide based z-scores (RNAz 1.0 model)  \n                          (default=off)",
-  "  -l, --locarnate       Use decision model for structural alignments  \n                          (default=off)",
-  "  -n, --no-shuffle      Never do explicit shuffling  (default=off)",
+  "  -h, --help                    Print help and exit",
+  "  -V, --version                 Print version and exit",
+  "  -f, --forward                 Score forward strand  (default=off)",
+  "  -r, --reverse                 Score reverse strand  (default=off)",
+  "  -b, --both-strands            Score both strands  (default=off)",
+  "  -o, --outfile=STRING          Output filename",
+  "  -w, --window=STRING           Score window",
+  "  -p, --cutoff=FLOAT            Probability cutoff",
+  "  -s, --predict-strand          Use strand predictor  (default=off)",
+  "  -x, --plot                    Generate graphical output  (default=off)",
+  "  -d, --dinucleotide            Use dinucleotide based z-scores (default)  \n                                  (default=off)",
+  "  -m, --mononucleotide          Use dinucleotide based z-scores (RNAz 1.0  \n                                  model)  (default=off)",
+  "  -l, --locarnate               Use decision model for structural alignments  \n                                  (default=off)",
+  "  -n, --no-shuffle              Never do explicit shuffling  (default=off)",
+  "  -t, --threads=INT             Number of alignments scored in parallel  \n                                  (default=`1')",
+  "      --shuffle-threads=INT     Number of threads folding shuffled sequences  \n                                  (default=`1')",
+  "      --shuffle-samples=STRING  Minimum and maximum number of shuffled  \n                                  sequences, e.g. 100-1000",
+  "      --shuffle-stop=FLOAT      Stop shuffling once the z-score is known to  \n                                  +-FLOAT",
+  "      --seed=INT                Seed for the random numbers of explicit  \n                                  shuffling  (default=`1')",
+  "      --window-size=INT         Slide a window of INT columns over each  \n                                  alignment",
+  "      --window-slide=INT        Step size of the sliding window  \n                                  (default=`40')",
+  "      --min-length=INT          Minimum number of columns of a window  \n                                  (default=`50')",
+  "      --max-gap=FLOAT           Maximum fraction of gaps in a window sequence  \n                                  (default=`0.25')",
+  "      --max-masked=FLOAT        Maximum fraction of masked (lowercase) letters  \n                                  (default=`0.1')",
+  "      --min-seqs=INT            Minimum number of sequences in a window  \n                                  (default=`2')",
+  "      --max-seqs=INT            Maximum number of sequences in a window  \n                                  (default=`6')",
+  "      --min-id=FLOAT            Minimum mean pairwise identity of a window  \n                                  (default=`50')",
+  "      --opt-id=FLOAT            Optimal pairwise identity when sequences are  \n                                  removed  (default=`80')",
+  "      --max-id=FLOAT            Maximum pairwise identity of two window  \n                                  sequences  (default=`100')",
+  "      --no-reference            Do not use the first sequence as reference  \n                                  (default=off)",
+  "      --no-rangecheck           Keep sequences outside the training range  \n                                  (default=off)",
+  "      --format=STRING           Output format: text, tsv, jsonl or bin  \n                                  (default=`text')",
+  "      --structures              Add the consensus sequence and structure to  \n                                  the records  (default=off)",
+  "      --flush-interval=INT      Flush the output every INT seconds instead of  \n                                  after each alignment",
     0
 };
 
 typedef enum {ARG_NO
   , ARG_FLAG
   , ARG_STRING
+  , ARG_INT
   , ARG_FLOAT
 } cmdline_parser_arg_type;
 
@@ -85,6 +106,26 @@ void clear_given (struct gengetopt_args_info *args_info)
   args_info->mononucleotide_given = 0 ;
   args_info->locarnate_given = 0 ;
   args_info->no_shuffle_given = 0 ;
+  args_info->threads_given = 0 ;
+  args_info->shuffle_threads_given = 0 ;
+  args_info->shuffle_samples_given = 0 ;
+  args_info->shuffle_stop_given = 0 ;
+  args_info->seed_given = 0 ;
+  args_info->window_size_given = 0 ;
+  args_info->window_slide_given = 0 ;
+  args_info->min_length_given = 0 ;
+  args_info->max_gap_given = 0 ;
+  args_info->max_masked_given = 0 ;
+  args_info->min_seqs_given = 0 ;
+  args_info->max_seqs_given = 0 ;
+  args_info->min_id_given = 0 ;
+  args_info->opt_id_given = 0 ;
+  args_info->max_id_given = 0 ;
+  args_info->no_reference_given = 0 ;
+  args_info->no_rangecheck_given = 0 ;
+  args_info->format_given = 0 ;
+  args_info->structures_given = 0 ;
+  args_info->flush_interval_given = 0 ;
 }
 
 static
@@ -105,6 +146,40 @@ void clear_args (struct gengetopt_args_info *args_info)
   args_info->mononucleotide_flag = 0;
   args_info->locarnate_flag = 0;
   args_info->no_shuffle_flag = 0;
+  args_info->threads_arg = 1;
+  args_info->threads_orig = NULL;
+  args_info->shuffle_threads_arg = 1;
+  args_info->shuffle_threads_orig = NULL;
+  args_info->shuffle_samples_arg = NULL;
+  args_info->shuffle_samples_orig = NULL;
+  args_info->shuffle_stop_orig = NULL;
+  args_info->seed_arg = 1;
+  args_info->seed_orig = NULL;
+  args_info->window_size_orig = NULL;
+  args_info->window_slide_arg = 40;
+  args_info->window_slide_orig = NULL;
+  args_info->min_length_arg = 50;
+  args_info->min_length_orig = NULL;
+  args_info->max_gap_arg = 0.25;
+  args_info->max_gap_orig = NULL;
+  args_info->max_masked_arg = 0.1;
+  args_info->max_masked_orig = NULL;
+  args_info->min_seqs_arg = 2;
+  args_info->min_seqs_orig = NULL;
+  args_info->max_seqs_arg = 6;
+  args_info->max_seqs_orig = NULL;
+  args_info->min_id_arg = 50;
+  args_info->min_id_orig = NULL;
+  args_info->opt_id_arg = 80;
+  args_info->opt_id_orig = NULL;
+  args_info->max_id_arg = 100;
+  args_info->max_id_orig = NULL;
+  args_info->no_reference_flag = 0;
+  args_info->no_rangecheck_flag = 0;
+  args_info->format_arg = gengetopt_strdup ("text");
+  args_info->format_orig = NULL;
+  args_info->structures_flag = 0;
+  args_info->flush_interval_orig = NULL;
   
 }
 
@@ -127,6 +202,26 @@ void init_args_info(struct gengetopt_args_info *args_info)
   args_info->mononucleotide_help = gengetopt_args_info_help[11] ;
   args_info->locarnate_help = gengetopt_args_info_help[12] ;
   args_info->no_shuffle_help = gengetopt_args_info_help[13] ;
+  args_info->threads_help = gengetopt_args_info_help[14] ;
+  args_info->shuffle_threads_help = gengetopt_args_info_help[15] ;
+  args_info->shuffle_samples_help = gengetopt_args_info_help[16] ;
+  args_info->shuffle_stop_help = gengetopt_args_info_help[17] ;
+  args_info->seed_help = gengetopt_args_info_help[18] ;
+  args_info->window_size_help = gengetopt_args_info_help[19] ;
+  args_info->window_slide_help = gengetopt_args_info_help[20] ;
+  args_info->min_length_help = gengetopt_args_info_help[21] ;
+  args_info->max_gap_help = gengetopt_args_info_help[22] ;
+  args_info->max_masked_help = gengetopt_args_info_help[23] ;
+  args_info->min_seqs_help = gengetopt_args_info_help[24] ;
+  args_info->max_seqs_help = gengetopt_args_info_help[25] ;
+  args_info->min_id_help = gengetopt_args_info_help[26] ;
+  args_info->opt_id_help = gengetopt_args_info_help[27] ;
+  args_info->max_id_help = gengetopt_args_info_help[28] ;
+  args_info->no_reference_help = gengetopt_args_info_help[29] ;
+  args_info->no_rangecheck_help = gengetopt_args_info_help[30] ;
+  args_info->format_help = gengetopt_args_info_help[31] ;
+  args_info->structures_help = gengetopt_args_info_help[32] ;
+  args_info->flush_interval_help = gengetopt_args_info_help[33] ;
   
 }
 
@@ -215,6 +310,25 @@ cmdline_parser_release (struct gengetopt_args_info *args_info)
   free_string_field (&(args_info->window_arg));
   free_string_field (&(args_info->window_orig));
   free_string_field (&(args_info->cutoff_orig));
+  free_string_field (&(args_info->threads_orig));
+  free_string_field (&(args_info->shuffle_threads_orig));
+  free_string_field (&(args_info->shuffle_samples_arg));
+  free_string_field (&(args_info->shuffle_samples_orig));
+  free_string_field (&(args_info->shuffle_stop_orig));
+  free_string_field (&(args_info->seed_orig));
+  free_string_field (&(args_info->window_size_orig));
+  free_string_field (&(args_info->window_slide_orig));
+  free_string_field (&(args_info->min_length_orig));
+  free_string_field (&(args_info->max_gap_orig));
+  free_string_field (&(args_info->max_masked_orig));
+  free_string_field (&(args_info->min_seqs_orig));
+  free_string_field (&(args_info->max_seqs_orig));
+  free_string_field (&(args_info->min_id_orig));
+  free_string_field (&(args_info->opt_id_orig));
+  free_string_field (&(args_info->max_id_orig));
+  free_string_field (&(args_info->format_arg));
+  free_string_field (&(args_info->format_orig));
+  free_string_field (&(args_info->flush_interval_orig));
   
   
   for (i = 0; i < args_info->inputs_num; ++i)
@@ -278,6 +392,46 @@ cmdline_parser_dump(FILE *outfile, struct gengetopt_args_info *args_info)
     write_into_file(outfile, "locarnate", 0, 0 );
   if (args_info->no_shuffle_given)
     write_into_file(outfile, "no-shuffle", 0, 0 );
+  if (args_info->threads_given)
+    write_into_file(outfile, "threads", args_info->threads_orig, 0);
+  if (args_info->shuffle_threads_given)
+    write_into_file(outfile, "shuffle-threads", args_info->shuffle_threads_orig, 0);
+  if (args_info->shuffle_samples_given)
+    write_into_file(outfile, "shuffle-samples", args_info->shuffle_samples_orig, 0);
+  if (args_info->shuffle_stop_given)
+    write_into_file(outfile, "shuffle-stop", args_info->shuffle_stop_orig, 0);
+  if (args_info->seed_given)
+    write_into_file(outfile, "seed", args_info->seed_orig, 0);
+  if (args_info->window_size_given)
+    write_into_file(outfile, "window-size", args_info->window_size_orig, 0);
+  if (args_info->window_slide_given)
+    write_into_file(outfile, "window-slide", args_info->window_slide_orig, 0);
+  if (args_info->min_length_given)
+    write_into_file(outfile, "min-length", args_info->min_length_orig, 0);
+  if (args_info->max_gap_given)
+    write_into_file(outfile, "max-gap", args_info->max_gap_orig, 0);
+  if (args_info->max_masked_given)
+    write_into_file(outfile, "max-masked", args_info->max_masked_orig, 0);
+  if (args_info->min_seqs_given)
+    write_into_file(outfile, "min-seqs", args_info->min_seqs_orig, 0);
+  if (args_info->max_seqs_given)
+    write_into_file(outfile, "max-seqs", args_info->max_seqs_orig, 0);
+  if (args_info->min_id_given)
+    write_into_file(outfile, "min-id", args_info->min_id_orig, 0);
+  if (args_info->opt_id_given)
+    write_into_file(outfile, "opt-id", args_info->opt_id_orig, 0);
+  if (args_info->max_id_given)
+    write_into_file(outfile, "max-id", args_info->max_id_orig, 0);
+  if (args_info->no_reference_given)
+    write_into_file(outfile, "no-reference", 0, 0 );
+  if (args_info->no_rangecheck_given)
+    write_into_file(outfile, "no-rangecheck", 0, 0 );
+  if (args_info->format_given)
+    write_into_file(outfile, "format", args_info->format_orig, 0);
+  if (args_info->structures_given)
+    write_into_file(outfile, "structures", 0, 0 );
+  if (args_info->flush_interval_given)
+    write_into_file(outfile, "flush-interval", args_info->flush_interval_orig, 0);
   
 
   i = EXIT_SUCCESS;
@@ -435,6 +589,9 @@ int update_arg(void *field, char **orig_field,
   case ARG_FLAG:
     *((int *)field) = !*((int *)field);
     break;
+  case ARG_INT:
+    if (val) *((int *)field) = strtol (val, &stop_char, 0);
+    break;
   case ARG_FLOAT:
     if (val) *((float *)field) = (float)strtod (val, &stop_char);
     break;
@@ -452,6 +609,7 @@ int update_arg(void *field, char **orig_field,
 
   /* check numeric conversion */
   switch(arg_type) {
+  case ARG_INT:
   case ARG_FLOAT:
     if (val && !(stop_char && *stop_char == '\0')) {
       fprintf(stderr, "%s: invalid numeric value: %s\n", package_name, val);
@@ -534,10 +692,30 @@ cmdline_parser_internal (
         { "mononucleotide",	0, NULL, 'm' },
         { "locarnate",	0, NULL, 'l' },
         { "no-shuffle",	0, NULL, 'n' },
+        { "threads",	1, NULL, 't' },
+        { "shuffle-threads",	1, NULL, 0 },
+        { "shuffle-samples",	1, NULL, 0 },
+        { "shuffle-stop",	1, NULL, 0 },
+        { "seed",	1, NULL, 0 },
+        { "window-size",	1, NULL, 0 },
+        { "window-slide",	1, NULL, 0 },
+        { "min-length",	1, NULL, 0 },
+        { "max-gap",	1, NULL, 0 },
+        { "max-masked",	1, NULL, 0 },
+        { "min-seqs",	1, NULL, 0 },
+        { "max-seqs",	1, NULL, 0 },
+        { "min-id",	1, NULL, 0 },
+        { "opt-id",	1, NULL, 0 },
+        { "max-id",	1, NULL, 0 },
+        { "no-reference",	0, NULL, 0 },
+        { "no-rangecheck",	0, NULL, 0 },
+        { "format",	1, NULL, 0 },
+        { "structures",	0, NULL, 0 },
+        { "flush-interval",	1, NULL, 0 },
         { 0,  0, 0, 0 }
       };
 
-      c = getopt_long (argc, argv, "hVfrbo:w:p:sxdmln", long_options, &option_index);
+      c = getopt_long (argc, argv, "hVfrbo:w:p:sxdmlnt:", long_options, &option_index);
 
       if (c == -1) break;	/* Exit from `while (1)' loop.  */
 
@@ -697,8 +875,282 @@ cmdline_parser_internal (
             goto failure;
         
           break;
+        case 't':	/* Number of alignments scored in parallel.  */
+        
+        
+          if (update_arg( (void *)&(args_info->threads_arg), 
+               &(args_info->threads_orig), &(args_info->threads_given),
+              &(local_args_info.threads_given), optarg, 0, "1", ARG_INT,
+              check_ambiguity, override, 0, 0,
+              "threads", 't',
+              additional_error))
+            goto failure;
+        
+          break;
 
         case 0:	/* Long option with no short option */
+          /* Number of threads folding shuffled sequences.  */
+          if (strcmp (long_options[option_index].name, "shuffle-threads") == 0)
+          {
+          
+          
+            if (update_arg( (void *)&(args_info->shuffle_threads_arg), 
+                 &(args_info->shuffle_threads_orig), &(args_info->shuffle_threads_given),
+                &(local_args_info.shuffle_threads_given), optarg, 0, "1", ARG_INT,
+                check_ambiguity, override, 0, 0,
+                "shuffle-threads", '-',
+                additional_error))
+              goto failure;
+          
+          }
+          /* Minimum and maximum number of shuffled sequences, e.g. 100-1000.  */
+          else if (strcmp (long_options[option_index].name, "shuffle-samples") == 0)
+          {
+          
+          
+            if (update_arg( (void *)&(args_info->shuffle_samples_arg), 
+                 &(args_info->shuffle_samples_orig), &(args_info->shuffle_samples_given),
+                &(local_args_info.shuffle_samples_given), optarg, 0, 0, ARG_STRING,
+                check_ambiguity, override, 0, 0,
+                "shuffle-samples", '-',
+                additional_error))
+              goto failure;
+          
+          }
+          /* Stop shuffling once the z-score is known to +-FLOAT.  */
+          else if (strcmp (long_options[option_index].name, "shuffle-stop") == 0)
+          {
+          
+          
+            if (update_arg( (void *)&(args_info->shuffle_stop_arg), 
+                 &(args_info->shuffle_stop_orig), &(args_info->shuffle_stop_given),
+                &(local_args_info.shuffle_stop_given), optarg, 0, 0, ARG_FLOAT,
+                check_ambiguity, override, 0, 0,
+                "shuffle-stop", '-',
+                additional_error))
+              goto failure;
+          
+          }
+          /* Seed for the random numbers of explicit shuffling.  */
+          else if (strcmp (long_options[option_index].name, "seed") == 0)
+          {
+          
+          
+            if (update_arg( (void *)&(args_info->seed_arg), 
+                 &(args_info->seed_orig), &(args_info->seed_given),
+                &(local_args_info.seed_given), optarg, 0, "1", ARG_INT,
+                check_ambiguity, override, 0, 0,
+                "seed", '-',
+                additional_error))
+              goto failure;
+          
+          }
+          /* Slide a window of INT columns over each alignment.  */
+          else if (strcmp (long_options[option_index].name, "window-size") == 0)
+          {
+          
+          
+            if (update_arg( (void *)&(args_info->window_size_arg), 
+                 &(args_info->window_size_orig), &(args_info->window_size_given),
+                &(local_args_info.window_size_given), optarg, 0, 0, ARG_INT,
+                check_ambiguity, override, 0, 0,
+                "window-size", '-',
+                additional_error))
+              goto failure;
+          
+          }
+          /* Step size of the sliding window.  */
+          else if (strcmp (long_options[option_index].name, "window-slide") == 0)
+          {
+          
+          
+            if (update_arg( (void *)&(args_info->window_slide_arg), 
+                 &(args_info->window_slide_orig), &(args_info->window_slide_given),
+                &(local_args_info.window_slide_given), optarg, 0, "40", ARG_INT,
+                check_ambiguity, override, 0, 0,
+                "window-slide", '-',
+                additional_error))
+              goto failure;
+          
+          }
+          /* Minimum number of columns of a window.  */
+          else if (strcmp (long_options[option_index].name, "min-length") == 0)
+          {
+          
+          
+            if (update_arg( (void *)&(args_info->min_length_arg), 
+                 &(args_info->min_length_orig), &(args_info->min_length_given),
+                &(local_args_info.min_length_given), optarg, 0, "50", ARG_INT,
+                check_ambiguity, override, 0, 0,
+                "min-length", '-',
+                additional_error))
+              goto failure;
+          
+          }
+          /* Maximum fraction of gaps in a window sequence.  */
+          else if (strcmp (long_options[option_index].name, "max-gap") == 0)
+          {
+          
+          
+            if (update_arg( (void *)&(args_info->max_gap_arg), 
+                 &(args_info->max_gap_orig), &(args_info->max_gap_given),
+                &(local_args_info.max_gap_given), optarg, 0, "0.25", ARG_FLOAT,
+                check_ambiguity, override, 0, 0,
+                "max-gap", '-',
+                additional_error))
+              goto failure;
+          
+          }
+          /* Maximum fraction of masked (lowercase) letters.  */
+          else if (strcmp (long_options[option_index].name, "max-masked") == 0)
+          {
+          
+          
+            if (update_arg( (void *)&(args_info->max_masked_arg), 
+                 &(args_info->max_masked_orig), &(args_info->max_masked_given),
+                &(local_args_info.max_masked_given), optarg, 0, "0.1", ARG_FLOAT,
+                check_ambiguity, override, 0, 0,
+                "max-masked", '-',
+                additional_error))
+              goto failure;
+          
+          }
+          /* Minimum number of sequences in a window.  */
+          else if (strcmp (long_options[option_index].name, "min-seqs") == 0)
+          {
+          
+          
+            if (update_arg( (void *)&(args_info->min_seqs_arg), 
+                 &(args_info->min_seqs_orig), &(args_info->min_seqs_given),
+                &(local_args_info.min_seqs_given), optarg, 0, "2", ARG_INT,
+                check_ambiguity, override, 0, 0,
+                "min-seqs", '-',
+                additional_error))
+              goto failure;
+          
+          }
+          /* Maximum number of sequences in a window.  */
+          else if (strcmp (long_options[option_index].name, "max-seqs") == 0)
+          {
+          
+          
+            if (update_arg( (void *)&(args_info->max_seqs_arg), 
+                 &(args_info->max_seqs_orig), &(args_info->max_seqs_given),
+                &(local_args_info.max_seqs_given), optarg, 0, "6", ARG_INT,
+                check_ambiguity, override, 0, 0,
+                "max-seqs", '-',
+                additional_error))
+              goto failure;
+          
+          }
+          /* Minimum mean pairwise identity of a window.  */
+          else if (strcmp (long_options[option_index].name, "min-id") == 0)
+          {
+          
+          
+            if (update_arg( (void *)&(args_info->min_id_arg), 
+                 &(args_info->min_id_orig), &(args_info->min_id_given),
+                &(local_args_info.min_id_given), optarg, 0, "50", ARG_FLOAT,
+                check_ambiguity, override, 0, 0,
+                "min-id", '-',
+                additional_error))
+              goto failure;
+          
+          }
+          /* Optimal pairwise identity when sequences are removed.  */
+          else if (strcmp (long_options[option_index].name, "opt-id") == 0)
+          {
+          
+          
+            if (update_arg( (void *)&(args_info->opt_id_arg), 
+                 &(args_info->opt_id_orig), &(args_info->opt_id_given),
+                &(local_args_info.opt_id_given), optarg, 0, "80", ARG_FLOAT,
+                check_ambiguity, override, 0, 0,
+                "opt-id", '-',
+                additional_error))
+              goto failure;
+          
+          }
+          /* Maximum pairwise identity of two window sequences.  */
+          else if (strcmp (long_options[option_index].name, "max-id") == 0)
+          {
+          
+          
+            if (update_arg( (void *)&(args_info->max_id_arg), 
+                 &(args_info->max_id_orig), &(args_info->max_id_given),
+                &(local_args_info.max_id_given), optarg, 0, "100", ARG_FLOAT,
+                check_ambiguity, override, 0, 0,
+                "max-id", '-',
+                additional_error))
+              goto failure;
+          
+          }
+          /* Do not use the first sequence as reference.  */
+          else if (strcmp (long_options[option_index].name, "no-reference") == 0)
+          {
+          
+          
+            if (update_arg((void *)&(args_info->no_reference_flag), 0, &(args_info->no_reference_given),
+                &(local_args_info.no_reference_given), optarg, 0, 0, ARG_FLAG,
+                check_ambiguity, override, 1, 0, "no-reference", '-',
+                additional_error))
+              goto failure;
+          
+          }
+          /* Keep sequences outside the training range.  */
+          else if (strcmp (long_options[option_index].name, "no-rangecheck") == 0)
+          {
+          
+          
+            if (update_arg((void *)&(args_info->no_rangecheck_flag), 0, &(args_info->no_rangecheck_given),
+                &(local_args_info.no_rangecheck_given), optarg, 0, 0, ARG_FLAG,
+                check_ambiguity, override, 1, 0, "no-rangecheck", '-',
+                additional_error))
+              goto failure;
+          
+          }
+          /* Output format: text, tsv, jsonl or bin.  */
+          else if (strcmp (long_options[option_index].name, "format") == 0)
+          {
+          
+          
+            if (update_arg( (void *)&(args_info->format_arg), 
+                 &(args_info->format_orig), &(args_info->format_given),
+                &(local_args_info.format_given), optarg, 0, "text", ARG_STRING,
+                check_ambiguity, override, 0, 0,
+                "format", '-',
+                additional_error))
+              goto failure;
+          
+          }
+          /* Add the consensus sequence and structure to the records.  */
+          else if (strcmp (long_options[option_index].name, "structures") == 0)
+          {
+          
+          
+            if (update_arg((void *)&(args_info->structures_flag), 0, &(args_info->structures_given),
+                &(local_args_info.structures_given), optarg, 0, 0, ARG_FLAG,
+                check_ambiguity, override, 1, 0, "structures", '-',
+                additional_error))
+              goto failure;
+          
+          }
+          /* Flush the output every INT seconds instead of after each alignment.  */
+          else if (strcmp (long_options[option_index].name, "flush-interval") == 0)
+          {
+          
+          
+            if (update_arg( (void *)&(args_info->flush_interval_arg), 
+                 &(args_info->flush_interval_orig), &(args_info->flush_interval_given),
+                &(local_args_info.flush_interval_given), optarg, 0, 0, ARG_INT,
+                check_ambiguity, override, 0, 0,
+                "flush-interval", '-',
+                additional_error))
+              goto failure;
+          
+          }
+          
+          break;
         case '?':	/* Invalid option.  */
           /* `getopt_long' already printed an error message.  */
           goto failure;
@@ -70,6 +70,63 @@ struct gengetopt_args_info
   const char *locarnate_help; /**< @brief Use decision model for structural alignments help description.  */
   int no_shuffle_flag;	/**< @brief Never do explicit shuffling (default=off).  */
   const char *no_shuffle_help; /**< @brief Never do explicit shuffling help description.  */
+  int threads_arg;	/**< @brief Number of alignments scored in parallel (default='1').  */
+  char * threads_orig;	/**< @brief Number of alignments scored in parallel original value given at command line.  */
+  const char *threads_help; /**< @brief Number of alignments scored in parallel help description.  */
+  int shuffle_threads_arg;	/**< @brief Number of threads folding shuffled sequences (default='1').  */
+  char * shuffle_threads_orig;	/**< @brief Number of threads folding shuffled sequences original value given at command line.  */
+  const char *shuffle_threads_help; /**< @brief Number of threads folding shuffled sequences help description.  */
+  char * shuffle_samples_arg;	/**< @brief Minimum and maximum number of shuffled sequences, e.g. 100-1000.  */
+  char * shuffle_samples_orig;	/**< @brief Minimum and maximum number of shuffled sequences, e.g. 100-1000 original value given at command line.  */
+  const char *shuffle_samples_help; /**< @brief Minimum and maximum number of shuffled sequences, e.g. 100-1000 help description.  */
+  float shuffle_stop_arg;	/**< @brief Stop shuffling once the z-score is known to +-FLOAT.  */
+  char * shuffle_stop_orig;	/**< @brief Stop shuffling once the z-score is known to +-FLOAT original value given at command line.  */
+  const char *shuffle_stop_help; /**< @brief Stop shuffling once the z-score is known to +-FLOAT help description.  */
+  int seed_arg;	/**< @brief Seed for the random numbers of explicit shuffling (default='1').  */
+  char * seed_orig;	/**< @brief Seed for the random numbers of explicit shuffling original value given at command line.  */
+  const char *seed_help; /**< @brief Seed for the random numbers of explicit shuffling help description.  */
+  int window_size_arg;	/**< @brief Slide a window of INT columns over each alignment.  */
+  char * window_size_orig;	/**< @brief Slide a window of INT columns over each alignment original value given at command line.  */
+  const char *window_size_help; /**< @brief Slide a window of INT columns over each alignment help description.  */
+  int window_slide_arg;	/**< @brief Step size of the sliding window (default='40').  */
+  char * window_slide_orig;	/**< @brief Step size of the sliding window original value given at command line.  */
+  const char *window_slide_help; /**< @brief Step size of the sliding window help description.  */
+  int min_length_arg;	/**< @brief Minimum number of columns of a window (default='50').  */
+  char * min_length_orig;	/**< @brief Minimum number of columns of a window original value given at command line.  */
+  const char *min_length_help; /**< @brief Minimum number of columns of a window help description.  */
+  float max_gap_arg;	/**< @brief Maximum fraction of gaps in a window sequence (default='0.25').  */
+  char * max_gap_orig;	/**< @brief Maximum fraction of gaps in a window sequence original value given at command line.  */
+  const char *max_gap_help; /**< @brief Maximum fraction of gaps in a window sequence help description.  */
+  float max_masked_arg;	/**< @brief Maximum fraction of masked (lowercase) letters (default='0.1').  */
+  char * max_masked_orig;	/**< @brief Maximum fraction of masked (lowercase) letters original value given at command line.  */
+  const char *max_masked_help; /**< @brief Maximum fraction of masked (lowercase) letters help description.  */
+  int min_seqs_arg;	/**< @brief Minimum number of sequences in a window (default='2').  */
+  char * min_seqs_orig;	/**< @brief Minimum number of sequences in a window original value given at command line.  */
+  const char *min_seqs_help; /**< @brief Minimum number of sequences in a window help description.  */
+  int max_seqs_arg;	/**< @brief Maximum number of sequences in a window (default='6').  */
+  char * max_seqs_orig;	/**< @brief Maximum number of sequences in a window original value given at command line.  */
+  const char *max_seqs_help; /**< @brief Maximum number of sequences in a window help description.  */
+  float min_id_arg;	/**< @brief Minimum mean pairwise identity of a window (default='50').  */
+  char * min_id_orig;	/**< @brief Minimum mean pairwise identity of a window original value given at command line.  */
+  const char *min_id_help; /**< @brief Minimum mean pairwise identity of a window help description.  */
+  float opt_id_arg;	/**< @brief Optimal pairwise identity when sequences are removed (default='80').  */
+  char * opt_id_orig;	/**< @brief Optimal pairwise identity when sequences are removed original value given at command line.  */
+  const char *opt_id_help; /**< @brief Optimal pairwise identity when sequences are removed help description.  */
+  float max_id_arg;	/**< @brief Maximum pairwise identity of two window sequences (default='100').  */
+  char * max_id_orig;	/**< @brief Maximum pairwise identity of two window sequences original value given at command line.  */
+  const char *max_id_help; /**< @brief Maximum pairwise identity of two window sequences help description.  */
+  int no_reference_flag;	/**< @brief Do not use the first sequence as reference (default=off).  */
+  const char *no_reference_help; /**< @brief Do not use the first sequence as reference help description.  */
+  int no_rangecheck_flag;	/**< @brief Keep sequences outside the training range (default=off).  */
+  const char *no_rangecheck_help; /**< @brief Keep sequences outside the training range help description.  */
+  char * format_arg;	/**< @brief Output format: text, tsv, jsonl or bin (default='text').  */
+  char * format_orig;	/**< @brief Output format: text, tsv, jsonl or bin original value given at command line.  */
+  const char *format_help; /**< @brief Output format: text, tsv, jsonl or bin help description.  */
+  int structures_flag;	/**< @brief Add the consensus sequence and structure to the records (default=off).  */
+  const char *structures_help; /**< @brief Add the consensus sequence and structure to the records help description.  */
+  int flush_interval_arg;	/**< @brief Flush the output every INT seconds instead of after each alignment.  */
+  char * flush_interval_orig;	/**< @brief Flush the output every INT seconds instead of after each alignment original value given at command line.  */
+  const char *flush_interval_help; /**< @brief Flush the output every INT seconds instead of after each alignment help description.  */
   
   unsigned int help_given ;	/**< @brief Whether help was given.  */
   unsigned int version_given ;	/**< @brief Whether version was given.  */
@@ -85,6 +142,26 @@ struct gengetopt_args_info
   unsigned int mononucleotide_given ;	/**< @brief Whether mononucleotide was given.  */
   unsigned int locarnate_given ;	/**< @brief Whether locarnate was given.  */
   unsigned int no_shuffle_given ;	/**< @brief Whether no-shuffle was given.  */
+  unsigned int threads_given ;	/**< @brief Whether threads was given.  */
+  unsigned int shuffle_threads_given ;	/**< @brief Whether shuffle-threads was given.  */
+  unsigned int shuffle_samples_given ;	/**< @brief Whether shuffle-samples was given.  */
+  unsigned int shuffle_stop_given ;	/**< @brief Whether shuffle-stop was given.  */
+  unsigned int seed_given ;	/**< @brief Whether seed was given.  */
+  unsigned int window_size_given ;	/**< @brief Whether window-size was given.  */
+  unsigned int window_slide_given ;	/**< @brief Whether window-slide was given.  */
+  unsigned int min_length_given ;	/**< @brief Whether min-length was given.  */
+  unsigned int max_gap_given ;	/**< @brief Whether max-gap was given.  */
+  unsigned int max_masked_given ;	/**< @brief Whether max-masked was given.  */
+  unsigned int min_seqs_given ;	/**< @brief Whether min-seqs was given.  */
+  unsigned int max_seqs_given ;	/**< @brief Whether max-seqs was given.  */
+  unsigned int min_id_given ;	/**< @brief Whether min-id was given.  */
+  unsigned int opt_id_given ;	/**< @brief Whether opt-id was given.  */
+  unsigned int max_id_given ;	/**< @brief Whether max-id was given.  */
+  unsigned int no_reference_given ;	/**< @brief Whether no-reference was given.  */
+  unsigned int no_rangecheck_given ;	/**< @brief Whether no-rangecheck was given.  */
+  unsigned int format_given ;	/**< @brief Whether format was given.  */
+  unsigned int structures_given ;	/**< @brief Whether structures was given.  */
+  unsigned int flush_interval_given ;	/**< @brief Whether flush-interval was given.  */
 
   char **inputs ; /**< @brief unamed options (options without names) */
   unsigned inputs_num ; /**< @brief unamed options number */
@@ -0,0 +1,139 @@
+/*********************************************************************
+ *                                                                   *
+ *                              output.c                             *
+ *                                                                   *
+ *	Growing text buffer the reports and records of one job are   *
+ *	formatted into before they are written.                      *
+ *                                                                   *
+ *	The buffer keeps its length, so appending does not go over   *
+ *	the text again, and the fixed point numbers of the reports   *
+ *	are formatted directly. printf() is only used for the rare   *
+ *	values where the rounding is not clear from a double.        *
+ *                                                                   *
+ *********************************************************************/
+
+#include "config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <math.h>
+#include "utils.h"
+#include "output.h"
+
+#define PRIVATE static
+
+PRIVATE void reserve(struct out_buffer *buf, size_t n){
+
+  if (buf->length+n<=buf->size) return;
+  buf->size=2*(buf->length+n);
+  if (buf->size<1024) buf->size=1024;
+  buf->text=(char *)xrealloc(buf->text,buf->size);
+}
+
+void out_putn(struct out_buffer *buf, const char *string, size_t n){
+
+  if (n==0) return;
+  reserve(buf,n);
+  memcpy(buf->text+buf->length,string,n);
+  buf->length+=n;
+}
+
+void out_puts(struct out_buffer *buf, const char *string){
+  out_putn(buf,string,strlen(string));
+}
+
+void out_putc(struct out_buffer *buf, char c){
+  reserve(buf,1);
+  buf->text[buf->length++]=c;
+}
+
+void out_printf(struct out_buffer *buf, const char *format, ...){
+
+  va_list args;
+  int n;
+
+  va_start(args,format);
+  n=vsnprintf(NULL,0,format,args);
+  va_end(args);
+  if (n<=0) return;
+
+  /* vsnprintf() writes the terminating 0 as well */
+  reserve(buf,n+1);
+  va_start(args,format);
+  vsnprintf(buf->text+buf->length,n+1,format,args);
+  va_end(args);
+  buf->length+=n;
+}
+
+void out_int(struct out_buffer *buf, long value){
+
+  char digits[24], *p=digits+sizeof(digits);
+  unsigned long n;
+
+  n=(value<0) ? -(unsigned long)value : (unsigned long)value;
+  do {
+    *--p='0'+n%10;
+    n/=10;
+  } while (n>0);
+  if (value<0) *--p='-';
+  out_putn(buf,p,digits+sizeof(digits)-p);
+}
+
+void out_fixed(struct out_buffer *buf, double value, int width, int decimals){
+
+  static const double scales[]={1,10,100,1e3,1e4,1e5,1e6};
+  char digits[32], *p=digits+sizeof(digits);
+  double scaled, fraction;
+  unsigned long n;
+  int i, length;
+
+  /* Rounding the scaled value to the nearest integer gives what printf()
+     shows, unless it is close to halfway between two integers (where
+     printf() rounds the exact binary value) or too large to be exact. NaN
+     and infinity go to printf() as well. */
+  scaled=(decimals>=0 && decimals<=6) ? fabs(value)*scales[decimals] : -1;
+  if (!(scaled>=0 && scaled<1e9)){
+    out_printf(buf,"%*.*f",width,decimals,value);
+    return;
+  }
+  fraction=scaled-floor(scaled);
+  if (fabs(fraction-0.5)<1e-6){
+    out_printf(buf,"%*.*f",width,decimals,value);
+    return;
+  }
+
+  n=(unsigned long)floor(scaled)+(fraction>0.5);
+  for (i=0;i<decimals;i++){
+    *--p='0'+n%10;
+    n/=10;
+  }
+  if (decimals>0) *--p='.';
+  do {
+    *--p='0'+n%10;
+    n/=10;
+  } while (n>0);
+  /* printf() keeps the sign of negative values that round to 0 */
+  if (signbit(value)) *--p='-';
+
+  length=digits+sizeof(digits)-p;
+  for (i=length;i<width;i++) out_putc(buf,' ');
+  out_putn(buf,p,length);
+}
+
+size_t out_write(const struct out_buffer *buf, FILE *file){
+
+  if (buf->length==0) return 0;
+  return fwrite(buf->text,1,buf->length,file);
+}
+
+void out_clear(struct out_buffer *buf){
+  buf->length=0;
+}
+
+void out_free(struct out_buffer *buf){
+
+  free(buf->text);
+  buf->text=NULL;
+  buf->length=buf->size=0;
+}
@@ -0,0 +1,44 @@
+/*********************************************************************
+ *                                                                   *
+ *                              output.h                             *
+ *                                                                   *
+ *	Growing text buffer the reports and records of one job are   *
+ *	formatted into before they are written.                      *
+ *                                                                   *
+ *********************************************************************/
+
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+#include <stdio.h>
+
+/* Starts out empty with all fields 0 */
+struct out_buffer {
+  char *text;      /* not 0-terminated */
+  size_t length;
+  size_t size;
+};
+
+void out_putn(struct out_buffer *buf, const char *string, size_t n);
+
+void out_puts(struct out_buffer *buf, const char *string);
+
+void out_putc(struct out_buffer *buf, char c);
+
+void out_printf(struct out_buffer *buf, const char *format, ...);
+
+/* The same as out_printf(buf, "%d", value) */
+void out_int(struct out_buffer *buf, long value);
+
+/* The same as out_printf(buf, "%*.*f", width, decimals, value) for up
+   to 6 decimals, without going through printf for the usual values */
+void out_fixed(struct out_buffer *buf, double value, int width, int decimals);
+
+/* Writes the buffer to file, returns the number of bytes written */
+size_t out_write(const struct out_buffer *buf, FILE *file);
+
+void out_clear(struct out_buffer *buf);
+
+void out_free(struct out_buffer *buf);
+
+#endif
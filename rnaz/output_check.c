@@ -0,0 +1,130 @@
+/*********************************************************************
+ *                                                                   *
+ *                            output_check.c                         *
+ *                                                                   *
+ *	output_check [seed]                                          *
+ *                                                                   *
+ *	out_fixed() and out_int() must append the same text as       *
+ *	printf() with "%*.*f" and "%ld". Tried with the kinds of     *
+ *	numbers the reports print, ties of the rounding and the      *
+ *	doubles next to them, any magnitude, negative zero, NaN and  *
+ *	infinity. Run by "make check".                               *
+ *                                                                   *
+ *********************************************************************/
+
+#include "config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "utils.h"
+#include "output.h"
+
+#define PRIVATE static
+#define FIXED 2000000
+#define INTS 100000
+
+PRIVATE long checked=0;
+
+/* Formats the number both ways into buf, which is cleared first */
+PRIVATE int fixed_as_printf(struct out_buffer *buf, double value,
+							int width, int decimals){
+
+  char expected[512];
+
+  checked++;
+  snprintf(expected,sizeof(expected),"%*.*f",width,decimals,value);
+  out_clear(buf);
+  out_fixed(buf,value,width,decimals);
+  if (buf->length==strlen(expected) && memcmp(buf->text,expected,buf->length)==0){
+	return 1;
+  }
+  fprintf(stderr,"out_fixed(%.17g, %d, %d) gives \"%.*s\", not \"%s\"\n",
+		  value,width,decimals,(int)buf->length,buf->text,expected);
+  return 0;
+}
+
+PRIVATE int int_as_printf(struct out_buffer *buf, long value){
+
+  char expected[32];
+
+  checked++;
+  snprintf(expected,sizeof(expected),"%ld",value);
+  out_clear(buf);
+  out_int(buf,value);
+  if (buf->length==strlen(expected) && memcmp(buf->text,expected,buf->length)==0){
+	return 1;
+  }
+  fprintf(stderr,"out_int(%ld) gives \"%.*s\"\n",value,(int)buf->length,buf->text);
+  return 0;
+}
+
+/* A random number to be printed with the given decimals */
+PRIVATE double random_value(int decimals){
+
+  double scale=pow(10,decimals), v;
+  int n;
+
+  switch (int_urn(0,5)){
+  case 0:  /* z-scores, energies, probabilities */
+	v=(urn()-0.5)*200;
+	break;
+  case 1:
+	v=pow(10,urn()*20-10);
+	break;
+  case 2:  /* G+C contents and identities */
+	n=int_urn(1,1000);
+	v=(double)int_urn(0,n)/n;
+	break;
+  case 3:  /* halfway between two outputs */
+	v=(int_urn(0,2000000)+0.5)/scale;
+	break;
+  case 4:  /* next to halfway */
+	v=nextafter((int_urn(0,2000000)+0.5)/scale,(urn()<0.5) ? 0 : 1e300);
+	break;
+  default: /* sums of printed values */
+	v=(double)int_urn(0,100000)/scale+(double)int_urn(0,100000)/scale;
+	break;
+  }
+  return (urn()<0.3) ? -v : v;
+}
+
+int main(int argc, char *argv[]){
+
+  static const double special[]={0.0,-0.0,1e-7,-1e-7,0.5,1.5,2.5,
+								 999999999.5,1e9,-1e9,1e15,1e300,
+								 NAN,INFINITY,-INFINITY};
+  struct out_buffer buf={NULL,0,0};
+  int i, k, decimals;
+
+  if (argc>1){
+	xsubi[0]=xsubi[1]=xsubi[2]=(unsigned short)strtoul(argv[1],NULL,10);
+  } else xsubi[0]=xsubi[1]=xsubi[2]=4711;
+
+  for (i=0;i<FIXED;i++){
+	decimals=int_urn(0,7);
+	if (!fixed_as_printf(&buf,random_value(decimals),int_urn(0,12),decimals)){
+	  return 1;
+	}
+  }
+
+  /* decimals outside 0..6 go to printf() */
+  for (k=0;k<(int)(sizeof(special)/sizeof(special[0]));k++){
+	for (decimals=-1;decimals<=8;decimals++){
+	  if (!fixed_as_printf(&buf,special[k],6,decimals) ||
+		  !fixed_as_printf(&buf,-special[k],6,decimals)) return 1;
+	}
+  }
+
+  for (i=0;i<INTS;i++){
+	if (!int_as_printf(&buf,(long)((urn()-0.5)*2e12))) return 1;
+  }
+  if (!int_as_printf(&buf,0) || !int_as_printf(&buf,-1) ||
+	  !int_as_printf(&buf,2147483647L) || !int_as_printf(&buf,-2147483647L-1)){
+	return 1;
+  }
+
+  out_free(&buf);
+  printf("%ld numbers, all formatted as by printf()\n",checked);
+  return 0;
+}
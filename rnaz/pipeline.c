@@ -0,0 +1,237 @@
+/*********************************************************************
+ *                                                                   *
+ *                              pipeline.c                           *
+ *                                                                   *
+ *	Ordered reader/worker/writer pipeline used to score          *
+ *	several alignments at the same time.                         *
+ *                                                                   *
+ *	A reader thread fills a bounded ring of items, the worker    *
+ *	threads take them in input order and the calling thread      *
+ *	writes them out again in exactly that order, so the output   *
+ *	does not depend on the number of threads.                    *
+ *                                                                   *
+ *********************************************************************/
+
+#include "config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include "utils.h"
+#include "pipeline.h"
+
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
+
+#define PRIVATE static
+
+/* Number of items in flight (read but not yet written) per worker */
+#define ITEMS_PER_THREAD 4
+
+/********************************************************************
+ *                                                                  *
+ * run_serial -- read, process and write one item after the other   *
+ *                                                                  *
+ ********************************************************************/
+
+PRIVATE void run_serial(pipeline_read_fn read_item,
+                        pipeline_work_fn work_item,
+                        pipeline_write_fn write_item,
+                        pipeline_free_fn free_worker, void *data){
+  void *item, *worker=NULL;
+
+  while ((item=read_item(data))!=NULL){
+    work_item(item,&worker,data);
+    write_item(item,data);
+  }
+  if (free_worker!=NULL && worker!=NULL) free_worker(worker,data);
+}
+
+#ifdef HAVE_PTHREAD
+
+struct pipeline {
+  pthread_mutex_t lock;
+  pthread_cond_t  slot_free;   /* reader waits for the writer */
+  pthread_cond_t  item_ready;  /* workers wait for the reader */
+  pthread_cond_t  item_done;   /* writer waits for the workers */
+
+  void **items;                /* ring buffer of items in flight */
+  int *done;                   /* done[k] != 0 if items[k] is processed */
+  unsigned long capacity;
+
+  unsigned long n_read;        /* items put into the ring so far */
+  unsigned long n_claimed;     /* items taken by a worker so far */
+  unsigned long n_written;     /* items written (and removed) so far */
+  int eof;                     /* reader has seen the end of input */
+
+  pipeline_read_fn read_item;
+  pipeline_work_fn work_item;
+  pipeline_free_fn free_worker;
+  void *data;
+};
+
+PRIVATE void *reader_thread(void *arg){
+
+  struct pipeline *pl=(struct pipeline *)arg;
+  void *item;
+  unsigned long slot;
+
+  while (1){
+    pthread_mutex_lock(&pl->lock);
+    while (pl->n_read - pl->n_written >= pl->capacity)
+      pthread_cond_wait(&pl->slot_free,&pl->lock);
+    pthread_mutex_unlock(&pl->lock);
+
+    item=pl->read_item(pl->data);
+
+    pthread_mutex_lock(&pl->lock);
+    if (item==NULL){
+      pl->eof=1;
+      pthread_cond_broadcast(&pl->item_ready);
+      pthread_cond_signal(&pl->item_done);
+      pthread_mutex_unlock(&pl->lock);
+      break;
+    }
+    slot=pl->n_read % pl->capacity;
+    pl->items[slot]=item;
+    pl->done[slot]=0;
+    pl->n_read++;
+    pthread_cond_signal(&pl->item_ready);
+    pthread_mutex_unlock(&pl->lock);
+  }
+  return NULL;
+}
+
+PRIVATE void *worker_thread(void *arg){
+
+  struct pipeline *pl=(struct pipeline *)arg;
+  void *item, *worker=NULL;
+  unsigned long slot;
+
+  while (1){
+    pthread_mutex_lock(&pl->lock);
+    while (pl->n_claimed == pl->n_read && !pl->eof)
+      pthread_cond_wait(&pl->item_ready,&pl->lock);
+    if (pl->n_claimed == pl->n_read){
+      pthread_mutex_unlock(&pl->lock);
+      break;
+    }
+    slot=(pl->n_claimed++) % pl->capacity;
+    item=pl->items[slot];
+    pthread_mutex_unlock(&pl->lock);
+
+    pl->work_item(item,&worker,pl->data);
+
+    pthread_mutex_lock(&pl->lock);
+    pl->done[slot]=1;
+    pthread_cond_signal(&pl->item_done);
+    pthread_mutex_unlock(&pl->lock);
+  }
+  if (pl->free_worker!=NULL && worker!=NULL) pl->free_worker(worker,pl->data);
+  return NULL;
+}
+
+#endif
+
+/********************************************************************
+ *                                                                  *
+ * pipeline_run -- process all items, using 'threads' workers       *
+ *                                                                  *
+ ********************************************************************
+ *                                                                  *
+ * read_item ... returns the next item, NULL at the end of input    *
+ * work_item ... processes an item (may run concurrently)           *
+ * write_item ... writes and frees an item (called in input order)  *
+ * free_worker ... releases a worker's scratch space (may be NULL)  *
+ * data ... passed unchanged to the callbacks                       *
+ *                                                                  *
+ * With threads<=1, or if RNAz was built without thread support,    *
+ * everything runs sequentially in the calling thread.              *
+ *                                                                  *
+ ********************************************************************/
+
+void pipeline_run(int threads, pipeline_read_fn read_item,
+                  pipeline_work_fn work_item, pipeline_write_fn write_item,
+                  pipeline_free_fn free_worker, void *data){
+
+#ifdef HAVE_PTHREAD
+
+  struct pipeline pl;
+  pthread_t reader, *workers;
+  unsigned long slot;
+  void *item;
+  int i;
+
+  if (threads<=1){
+    run_serial(read_item,work_item,write_item,free_worker,data);
+    return;
+  }
+
+  pthread_mutex_init(&pl.lock,NULL);
+  pthread_cond_init(&pl.slot_free,NULL);
+  pthread_cond_init(&pl.item_ready,NULL);
+  pthread_cond_init(&pl.item_done,NULL);
+
+  pl.capacity=(unsigned long)threads*ITEMS_PER_THREAD;
+  pl.items=(void **)space(sizeof(void *)*pl.capacity);
+  pl.done=(int *)space(sizeof(int)*pl.capacity);
+  pl.n_read=pl.n_claimed=pl.n_written=0;
+  pl.eof=0;
+  pl.read_item=read_item;
+  pl.work_item=work_item;
+  pl.free_worker=free_worker;
+  pl.data=data;
+
+  workers=(pthread_t *)space(sizeof(pthread_t)*threads);
+
+  if (pthread_create(&reader,NULL,reader_thread,&pl)!=0){
+    nrerror("ERROR: Could not start reader thread.\n");
+  }
+  for (i=0;i<threads;i++){
+    if (pthread_create(&workers[i],NULL,worker_thread,&pl)!=0){
+      nrerror("ERROR: Could not start worker thread.\n");
+    }
+  }
+
+  /* The calling thread is the writer */
+  while (1){
+    pthread_mutex_lock(&pl.lock);
+    slot=pl.n_written % pl.capacity;
+    while (!(pl.n_written < pl.n_read && pl.done[slot]) &&
+           !(pl.eof && pl.n_written == pl.n_read))
+      pthread_cond_wait(&pl.item_done,&pl.lock);
+    if (pl.n_written == pl.n_read){
+      pthread_mutex_unlock(&pl.lock);
+      break;
+    }
+    item=pl.items[slot];
+    pthread_mutex_unlock(&pl.lock);
+
+    write_item(item,data);
+
+    pthread_mutex_lock(&pl.lock);
+    pl.items[slot]=NULL;
+    pl.n_written++;
+    pthread_cond_signal(&pl.slot_free);
+    pthread_mutex_unlock(&pl.lock);
+  }
+
+  pthread_join(reader,NULL);
+  for (i=0;i<threads;i++){
+    pthread_join(workers[i],NULL);
+  }
+
+  pthread_mutex_destroy(&pl.lock);
+  pthread_cond_destroy(&pl.slot_free);
+  pthread_cond_destroy(&pl.item_ready);
+  pthread_cond_destroy(&pl.item_done);
+  free(pl.items);
+  free(pl.done);
+  free(workers);
+
+#else
+
+  (void) threads;
+  run_serial(read_item,work_item,write_item,free_worker,data);
+
+#endif
+}
@@ -0,0 +1,26 @@
+/*********************************************************************
+ *                                                                   *
+ *                              pipeline.h                           *
+ *                                                                   *
+ *	Ordered reader/worker/writer pipeline used to score          *
+ *	several alignments at the same time.                         *
+ *                                                                   *
+ *********************************************************************/
+
+/* Returns the next item to process or NULL at the end of input */
+typedef void *(*pipeline_read_fn)(void *data);
+
+/* Processes one item; called concurrently from the worker threads.
+   *worker is private to the calling worker and starts out as NULL, so
+   it can keep scratch space from one item to the next */
+typedef void (*pipeline_work_fn)(void *item, void **worker, void *data);
+
+/* Consumes (and frees) one item; always called in input order */
+typedef void (*pipeline_write_fn)(void *item, void *data);
+
+/* Releases what a worker left in *worker when the input is exhausted */
+typedef void (*pipeline_free_fn)(void *worker, void *data);
+
+void pipeline_run(int threads, pipeline_read_fn read_item,
+                  pipeline_work_fn work_item, pipeline_write_fn write_item,
+                  pipeline_free_fn free_worker, void *data);
@@ -21,6 +21,11 @@
 #include <unistd.h>
 #include <string.h>
 #include <stdarg.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef HAVE_MMAP
+#include <sys/mman.h>
+#endif
 #include "fold.h"
 #include "fold_vars.h"
 #include "utils.h"
@@ -230,6 +235,762 @@ int read_maf(FILE *clust, struct aln *alignedSeqs[]) {
 }
 
 
+/* A regular input file mapped into memory, read from pos on */
+
+struct aln_map {
+  const char *data;
+  size_t size;
+  size_t pos;
+  void *mapping;          /* NULL if the file was empty */
+  size_t mappingSize;
+  char *buffer;           /* assembled CLUSTAL sequences */
+  size_t bufferSize;
+};
+
+/********************************************************************
+ *                                                                  *
+ * mapAlnFile -- maps the rest of an alignment file into memory     *
+ *                                                                  *
+ ********************************************************************
+ *                                                                  *
+ * file ... regular file, the mapping starts at its current offset  *
+ *                                                                  *
+ * Returns NULL if the file can't be mapped (e.g. a pipe), then it  *
+ * has to be read with read_clustal() or read_maf()                 *
+ *                                                                  *
+ ********************************************************************/
+
+struct aln_map *mapAlnFile(FILE *file){
+
+#ifdef HAVE_MMAP
+
+  struct aln_map *map;
+  struct stat st;
+  long offset;
+  void *mapping=NULL;
+
+  if (fstat(fileno(file),&st)!=0 || !S_ISREG(st.st_mode)) return NULL;
+  if ((offset=ftell(file))<0 || (off_t)offset>st.st_size) return NULL;
+
+  if (st.st_size>0){
+    mapping=mmap(NULL,(size_t)st.st_size,PROT_READ,MAP_PRIVATE,fileno(file),0);
+    if (mapping==MAP_FAILED) return NULL;
+#ifdef HAVE_MADVISE
+    madvise(mapping,(size_t)st.st_size,MADV_SEQUENTIAL);
+#endif
+  }
+
+  map=(struct aln_map *)space(sizeof(struct aln_map));
+  map->mapping=mapping;
+  map->mappingSize=(size_t)st.st_size;
+  map->data=(const char *)mapping;
+  map->size=(size_t)st.st_size;
+  map->pos=(size_t)offset;
+  return map;
+
+#else
+
+  (void) file;
+  return NULL;
+
+#endif
+}
+
+void unmapAlnFile(struct aln_map *map){
+
+  if (map==NULL) return;
+#ifdef HAVE_MMAP
+  if (map->mapping!=NULL) munmap(map->mapping,map->mappingSize);
+#endif
+  free(map->buffer);
+  free(map);
+}
+
+/* Next line of the mapping without the newline, NULL at the end */
+
+PRIVATE const char *mapLine(struct aln_map *map, size_t *length){
+
+  const char *line, *end;
+
+  if (map->pos>=map->size) return NULL;
+
+  line=map->data+map->pos;
+  end=(const char *)memchr(line,'\n',map->size-map->pos);
+  if (end==NULL){
+    *length=map->size-map->pos;
+    map->pos=map->size;
+  } else {
+    *length=(size_t)(end-line);
+    map->pos+=*length+1;
+  }
+  return line;
+}
+
+/* Splits a line at whitespace like splitFields(). Stores the first
+   max fields and returns the number of all fields. */
+
+PRIVATE int mapFields(const char *line, size_t length,
+                      const char *field[], size_t fieldLength[], int max){
+
+  size_t i=0, begin;
+  int n=0;
+
+  while (1){
+    while (i<length && isspace((unsigned char)line[i])) i++;
+    if (i==length) break;
+    begin=i;
+    while (i<length && !isspace((unsigned char)line[i])) i++;
+    if (n<max){
+      field[n]=line+begin;
+      fieldLength[n]=i-begin;
+    }
+    n++;
+  }
+  return n;
+}
+
+/* An integer field of a MAF line, like sscanf("%d") */
+
+PRIVATE int mapInt(const char *field, size_t length, int *value){
+
+  size_t i=0;
+  long v=0;
+  int sign=1;
+
+  if (i<length && (field[i]=='-' || field[i]=='+')){
+    if (field[i]=='-') sign=-1;
+    i++;
+  }
+  if (i==length || !isdigit((unsigned char)field[i])) return 0;
+  while (i<length && isdigit((unsigned char)field[i])){
+    v=v*10+(field[i]-'0');
+    i++;
+  }
+  *value=(int)(sign*v);
+  return 1;
+}
+
+/********************************************************************
+ *                                                                  *
+ * read_maf_mapped -- read next MAF alignment from a mapped file    *
+ *                                                                  *
+ ********************************************************************
+ *                                                                  *
+ * map ... the mapped file                                          *
+ * spans ... the sequences, pointing into the mapping               *
+ *                                                                  *
+ * Returns number of sequences read; same rules as read_maf(), but  *
+ * nothing is copied                                                *
+ *                                                                  *
+ ********************************************************************/
+
+int read_maf_mapped(struct aln_map *map, struct aln_span spans[]){
+
+  const char *line, *field[8];
+  size_t length, fieldLength[8];
+  int nFields, num_seq=0, nn;
+  struct aln_span *span;
+
+  while ((line=mapLine(map,&length))!=NULL){
+
+	nFields=mapFields(line,length,field,fieldLength,8);
+
+	/* Skip empty (=only whitespace) and comment (#) lines */
+	if (nFields==0 || field[0][0]=='#') continue;
+
+	if (field[0][0]=='s' && fieldLength[0]==1){
+
+	  if (nFields!=7){
+		nrerror("ERROR: Invalid MAF format (number of fields in 's' line not correct)");
+	  }
+	  if (num_seq>=MAX_NUM_NAMES-1){
+		nrerror("ERROR: Too many sequences in MAF file");
+	  }
+
+	  span=&spans[num_seq];
+	  span->name=field[1];
+	  span->nameLength=(int)fieldLength[1];
+	  span->seq=field[6];
+	  span->seqLength=(int)fieldLength[6];
+
+	  if (!mapInt(field[2],fieldLength[2],&span->start)){
+		fprintf(stderr,"ERROR: Invalid MAF format"
+				" (start position '%.*s' is not an integer)\n",
+				(int)fieldLength[2],field[2]);
+		exit(EXIT_FAILURE);
+	  }
+	  if (!mapInt(field[3],fieldLength[3],&span->length)){
+		fprintf(stderr,"ERROR: Invalid MAF format"
+				" (length '%.*s' is not an integer)\n",
+				(int)fieldLength[3],field[3]);
+		exit(EXIT_FAILURE);
+	  }
+	  if (!mapInt(field[5],fieldLength[5],&span->fullLength)){
+		fprintf(stderr,"ERROR: Invalid MAF format"
+				" (source sequence length '%.*s' is not an integer)\n",
+				(int)fieldLength[5],field[5]);
+		exit(EXIT_FAILURE);
+	  }
+
+	  span->strand=field[4][0];
+	  if (span->strand !='+' && span->strand !='-'){
+		fprintf(stderr,"ERROR: Invalid MAF format"
+				" (strand field '%.*s' is not '+' or '-')\n",
+				(int)fieldLength[4],field[4]);
+		exit(EXIT_FAILURE);
+	  }
+
+	  num_seq++;
+	  continue;
+	}
+
+	if (field[0][0]=='a' && fieldLength[0]==1) break;
+  }
+
+  for (nn=1; nn<num_seq; nn++) {
+	if (spans[nn].seqLength!=spans[0].seqLength) {
+	  nrerror("ERROR: Sequences are of unequal length.");
+	  return 0;
+	}
+  }
+  return num_seq;
+}
+
+/* Name and sequence of a CLUSTAL line, like sscanf("%99s %s") */
+
+PRIVATE void clustalFields(const char *line, size_t length,
+                           const char **name, size_t *nameLength,
+                           const char **seq, size_t *seqLength){
+  size_t i=0;
+
+  while (i<length && !isspace((unsigned char)line[i]) && i<99) i++;
+  *name=line;
+  *nameLength=i;
+  while (i<length && isspace((unsigned char)line[i])) i++;
+  *seq=line+i;
+  while (i<length && !isspace((unsigned char)line[i])) i++;
+  *seqLength=(size_t)(line+i-*seq);
+}
+
+/********************************************************************
+ *                                                                  *
+ * read_clustal_mapped -- read next CLUSTAL W alignment from a      *
+ *                        mapped file                               *
+ *                                                                  *
+ ********************************************************************
+ *                                                                  *
+ * map ... the mapped file                                          *
+ * spans ... the sequences; names point into the mapping, the       *
+ *           sequences into a buffer of the map that is reused by   *
+ *           the next call                                          *
+ *                                                                  *
+ * Returns number of sequences read; same rules as read_clustal().  *
+ * The blocks are scanned twice, first for the lengths of the       *
+ * sequences, then they are copied to their place in the buffer.    *
+ *                                                                  *
+ ********************************************************************/
+
+int read_clustal_mapped(struct aln_map *map, struct aln_span spans[]){
+
+  const char *line, *name, *seq;
+  size_t length, nameLength, seqLength, begin, total, offset[MAX_NUM_NAMES];
+  int nn=0, num_seq=0, pass;
+  char *buffer;
+
+  begin=map->pos;
+
+  for (pass=0;pass<2;pass++){
+
+	map->pos=begin;
+	nn=0;
+
+	while ((line=mapLine(map,&length))!=NULL) {
+
+	  if (length>=7 && strncmp(line,"CLUSTAL",7)==0) break;
+
+	  if (length<4 || isspace((unsigned char)line[0])) {
+		/* skip non-sequence line */
+		nn=0; /* reset seqence number */
+		continue;
+	  }
+
+	  clustalFields(line,length,&name,&nameLength,&seq,&seqLength);
+
+	  if (pass==0){
+		if (nn == num_seq) { /* first time */
+		  spans[nn].name=name;
+		  spans[nn].nameLength=(int)nameLength;
+		  spans[nn].seqLength=0;
+		  spans[nn].start=spans[nn].length=spans[nn].fullLength=0;
+		  spans[nn].strand='?';
+		} else if ((size_t)spans[nn].nameLength!=nameLength ||
+				   memcmp(spans[nn].name,name,nameLength)!=0) {
+		  /* name doesn't match */
+		  nrerror("ERROR: Inconsistent sequence names in CLUSTAL file");
+		  return 0;
+		}
+		spans[nn].seqLength+=(int)seqLength;
+	  } else {
+		memcpy(map->buffer+offset[nn],seq,seqLength);
+		offset[nn]+=seqLength;
+	  }
+
+	  nn++;
+	  if (nn>num_seq) num_seq = nn;
+	  if (num_seq>=MAX_NUM_NAMES) {
+		nrerror("ERROR: Too many sequences in CLUSTAL file");
+		return 0;
+	  }
+	}
+
+	if (pass==0){
+	  if (num_seq==0) return 0;
+
+	  /* every sequence gets its place in the buffer once */
+	  total=0;
+	  for (nn=0;nn<num_seq;nn++){
+		offset[nn]=total;
+		total+=(size_t)spans[nn].seqLength;
+	  }
+	  if (total>map->bufferSize || map->buffer==NULL){
+		map->bufferSize=(total>0) ? total : 1;
+		buffer=(char *)xrealloc(map->buffer,(unsigned)map->bufferSize);
+		map->buffer=buffer;
+	  }
+	  for (nn=0;nn<num_seq;nn++){
+		spans[nn].seq=map->buffer+offset[nn];
+	  }
+	}
+  }
+
+  for (nn=1; nn<num_seq; nn++) {
+	if (spans[nn].seqLength!=spans[0].seqLength) {
+	  fprintf(stderr, "ERROR: Sequences are of unequal length.\n");
+	  return 0;
+	}
+  }
+  return num_seq;
+}
+
+/********************************************************************
+ *                                                                  *
+ * alnSpans -- spans of the sequences of an alignment in memory     *
+ *                                                                  *
+ ********************************************************************/
+
+void alnSpans(const struct aln *AS[], struct aln_span spans[]){
+
+  int i;
+
+  for (i=0;AS[i]!=NULL;i++){
+	spans[i].name=AS[i]->name;
+	spans[i].nameLength=(int)strlen(AS[i]->name);
+	spans[i].seq=AS[i]->seq;
+	spans[i].seqLength=(int)strlen(AS[i]->seq);
+	spans[i].start=AS[i]->start;
+	spans[i].length=AS[i]->length;
+	spans[i].fullLength=AS[i]->fullLength;
+	spans[i].strand=AS[i]->strand;
+  }
+}
+
+/********************************************************************
+ *                                                                  *
+ * sliceSpans -- copies a slice of an alignment given as spans      *
+ *                                                                  *
+ ********************************************************************
+ *                                                                  *
+ * spans ... the n_seq sequences of the alignment                   *
+ * destAln, from, to ... as for sliceAln()                          *
+ *                                                                  *
+ ********************************************************************/
+
+void sliceSpans(const struct aln_span spans[], int n_seq,
+                struct aln *destAln[], int from, int to){
+
+  int i;
+  char *name, *slice;
+
+  for (i=0;i<n_seq;i++){
+	name=(char *) space((unsigned) spans[i].nameLength+1);
+	memcpy(name,spans[i].name,spans[i].nameLength);
+	slice=(char *) space((unsigned) (to-from+2));
+	memcpy(slice,spans[i].seq+from-1,to-from+1);
+	/* coordinates are NOT changed*/
+	destAln[i]=createAlnEntry(name,slice,
+							  spans[i].start,
+							  spans[i].length,
+							  spans[i].fullLength,
+							  spans[i].strand);
+  }
+  destAln[i]=NULL;
+}
+
+#define IS_GAP(c) ((c)=='-' || (c)=='.')
+
+/* Identical and compared columns of two sequences; columns with a gap
+   in both are not compared, case is ignored */
+
+PRIVATE void pairCounts(const char *a, const char *b, int width,
+                        int *matches, int *pairs){
+  int k;
+  char x,y;
+
+  for (k=0;k<width;k++){
+	x=a[k]; y=b[k];
+	if (IS_GAP(x) && IS_GAP(y)) continue;
+	if (x=='.') x='-';
+	if (y=='.') y='-';
+	if (toupper((unsigned char)x)==toupper((unsigned char)y)) (*matches)++;
+	(*pairs)++;
+  }
+}
+
+/* Fraction of identical columns, rounded to four digits like
+   meanPairID() in RNAz.pm */
+
+PRIVATE double pairIdentity(const char *a, const char *b, int width){
+  int matches=0, pairs=0;
+
+  pairCounts(a,b,width,&matches,&pairs);
+  if (pairs==0) return 0;
+  return round_decimals((double)matches/pairs,4);
+}
+
+/* Length and base composition outside the range the regression models
+   were trained for (rangeWarn() in RNAz.pm) */
+
+PRIVATE int outOfRange(const char *seq, int width){
+  int k, length=0, nA=0, nC=0, nG=0, nT=0;
+  double GC, A=0, C=0;
+
+  for (k=0;k<width;k++){
+	if (IS_GAP(seq[k])) continue;
+	length++;
+	switch (toupper((unsigned char)seq[k])){
+	case 'A': nA++; break;
+	case 'C': nC++; break;
+	case 'G': nG++; break;
+	case 'T': case 'U': nT++; break;
+	}
+  }
+  if (length==0) return 1;
+
+  GC=(double)(nG+nC)/length;
+  if (nT+nA>0 && nG+nC>0){
+	A=(double)nA/(nT+nA);
+	C=(double)nC/(nG+nC);
+  }
+  return (length<50 || length>400 ||
+		  GC<0.25 || GC>0.75 || A<0.25 || A>0.75 || C<0.25 || C>0.75);
+}
+
+/* Removes sequences until at most maxSeqs are left, like pruneAln()
+   in RNAz.pm with a single sample: first one of each pair more
+   similar than maxID, then greedily the sequence farthest from optID */
+
+PRIVATE void pruneWindow(const char *seq[], int keep[], int n_seq, int width,
+                         const struct window_filter *filter){
+  int idx[MAX_NUM_NAMES];
+  int alive[MAX_NUM_NAMES];
+  double *id, cost, maxcost, optSim, maxID;
+  int i, j, n, nAlive, maxind;
+
+  n=0;
+  for (i=0;i<n_seq;i++){
+	if (keep[i]) idx[n++]=i;
+  }
+
+  id=(double *) space(sizeof(double)*n*n);
+  for (i=0;i<n;i++){
+	alive[i]=1;
+	for (j=i+1;j<n;j++){
+	  id[i*n+j]=id[j*n+i]=pairIdentity(seq[idx[i]],seq[idx[j]],width);
+	}
+  }
+
+  optSim=filter->optID/100;
+  maxID=filter->maxID/100;
+  nAlive=n;
+
+  for (i=0;i<n;i++){
+	if (!alive[i]) continue;
+	for (j=i+1;j<n;j++){
+	  if (!alive[j]) continue;
+	  if (id[i*n+j]>maxID){
+		nAlive--;
+		if (nAlive<2) break;
+		alive[j]=0;
+	  }
+	}
+  }
+
+  while (nAlive>filter->maxSeqs){
+	maxcost=0;
+	maxind=0;
+	for (i=0;i<n;i++){
+	  if (!alive[i] || (i==0 && filter->reference)) continue;
+	  cost=0;
+	  for (j=0;j<n;j++){
+		if (i==j || !alive[j]) continue;
+		cost+=(id[i*n+j]-optSim)*(id[i*n+j]-optSim);
+	  }
+	  if (cost>maxcost){
+		maxcost=cost;
+		maxind=i;
+	  }
+	}
+	alive[maxind]=0;
+	nAlive--;
+  }
+
+  for (i=0;i<n;i++){
+	keep[idx[i]]=alive[i];
+  }
+  free(id);
+}
+
+/********************************************************************
+ *                                                                  *
+ * windowSpans -- copies a window of an alignment given as spans,   *
+ *                filtered like by rnazWindow.pl                    *
+ *                                                                  *
+ ********************************************************************
+ *                                                                  *
+ * spans ... the n_seq sequences of the alignment                   *
+ * destAln ... pointer to array where the window is stored          *
+ * rows ... if not NULL, the sequences kept are stored here         *
+ * from, to ... specifies the window, first column is column 1      *
+ * filter ... which sequences to keep and which windows to discard  *
+ * offsets ... letters before the last window, moved on to this one *
+ *                                                                  *
+ * Sequences with too many gaps or masked letters, or outside the   *
+ * training range, are removed, then columns with gaps only. If     *
+ * there are more than filter->maxSeqs sequences, the ones closest  *
+ * to an identity of filter->optID are kept. Coordinates of MAF     *
+ * rows are those of the window, Clustal rows are named             *
+ * name/start-end with 0-based start and exclusive end.             *
+ *                                                                  *
+ * Returns number of sequences in the window, 0 if it is discarded  *
+ *                                                                  *
+ ********************************************************************/
+
+int windowSpans(const struct aln_span spans[], int n_seq,
+                struct aln *destAln[], int rows[], int from, int to,
+                const struct window_filter *filter,
+                struct span_offsets *offsets){
+
+  const char *seq[MAX_NUM_NAMES];
+  int keep[MAX_NUM_NAMES];
+  char *allGaps, *name, *slice;
+  int i, j, k, l, n, width, columns, gaps, gaps0, gaps1, tmpLength;
+  int masked, matches, pairs, inside, first;
+  double id;
+
+  width=to-from+1;
+
+  for (i=0;i<n_seq;i++){
+	seq[i]=spans[i].seq+from-1;
+	keep[i]=1;
+  }
+
+  /* Windows move to the right, so only the columns since the last one
+	 are counted; otherwise from the start again */
+  if (offsets->column>from-1){
+	offsets->column=0;
+	for (i=0;i<n_seq;i++) offsets->letters[i]=0;
+  }
+  for (i=0;i<n_seq;i++){
+	for (k=offsets->column;k<from-1;k++){
+	  offsets->letters[i]+=!IS_GAP(spans[i].seq[k]);
+	}
+  }
+  offsets->column=from-1;
+
+  /* Gaps; with a reference, each sequence is compared to the first
+     one in the columns where at least one of them has no gap */
+  if (filter->reference){
+	gaps=0;
+	for (k=0;k<width;k++) gaps+=IS_GAP(seq[0][k]);
+	if (gaps==width || (double)gaps/width>filter->maxGap){
+	  keep[0]=0;
+	} else {
+	  for (i=1;i<n_seq;i++){
+		gaps0=gaps1=tmpLength=0;
+		for (k=0;k<width;k++){
+		  if (IS_GAP(seq[0][k]) && IS_GAP(seq[i][k])) continue;
+		  tmpLength++;
+		  gaps0+=IS_GAP(seq[0][k]);
+		  gaps1+=IS_GAP(seq[i][k]);
+		}
+		if (tmpLength==0 || (double)(gaps0+gaps1)/tmpLength>filter->maxGap){
+		  keep[i]=0;
+		}
+	  }
+	}
+  } else {
+	for (i=0;i<n_seq;i++){
+	  gaps=0;
+	  for (k=0;k<width;k++) gaps+=IS_GAP(seq[i][k]);
+	  if ((double)gaps/width>filter->maxGap) keep[i]=0;
+	}
+  }
+
+  for (i=0;i<n_seq;i++){
+	if (!keep[i]) continue;
+	masked=0;
+	for (k=0;k<width;k++){
+	  if (seq[i][k]>='a' && seq[i][k]<='z') masked++;
+	}
+	if ((double)masked/width>filter->maxMasked) keep[i]=0;
+  }
+
+  if (filter->rangeCheck){
+	for (i=0;i<n_seq;i++){
+	  if (keep[i] && outOfRange(seq[i],width)) keep[i]=0;
+	}
+  }
+
+  n=0;
+  first=-1;
+  for (i=0;i<n_seq;i++){
+	if (!keep[i]) continue;
+	if (first<0) first=i;
+	n++;
+  }
+
+  if (n==0) return 0;
+
+  /* The window is discarded without its reference sequence */
+  if (filter->reference &&
+	  (spans[first].nameLength!=spans[0].nameLength ||
+	   memcmp(spans[first].name,spans[0].name,spans[0].nameLength)!=0)){
+	return 0;
+  }
+
+  if (n<filter->minSeqs) return 0;
+
+  if (n>filter->maxSeqs){
+	pruneWindow(seq,keep,n_seq,width,filter);
+  }
+
+  allGaps=(char *) space((unsigned) width);
+  columns=0;
+  for (k=0;k<width;k++){
+	allGaps[k]=1;
+	for (i=0;i<n_seq;i++){
+	  if (keep[i] && seq[i][k]!='-' && seq[i][k]!='.'){
+		allGaps[k]=0;
+		columns++;
+		break;
+	  }
+	}
+  }
+
+  matches=pairs=0;
+  for (i=0;i<n_seq;i++){
+	if (!keep[i]) continue;
+	for (j=i+1;j<n_seq;j++){
+	  if (keep[j]) pairCounts(seq[i],seq[j],width,&matches,&pairs);
+	}
+  }
+  id=(pairs==0) ? 0 : round_decimals((double)matches/pairs,4);
+
+  if (columns<filter->minLength || id*100<filter->minID){
+	free(allGaps);
+	return 0;
+  }
+
+  n=0;
+  for (i=0;i<n_seq;i++){
+	if (!keep[i]) continue;
+	if (rows!=NULL) rows[n]=i;
+
+	slice=(char *) space((unsigned) columns+1);
+	for (k=l=0;k<width;k++){
+	  if (!allGaps[k]) slice[l++]=(seq[i][k]=='.') ? '-' : seq[i][k];
+	}
+
+	if (spans[i].strand=='?'){
+	  name=(char *) space((unsigned) spans[i].nameLength+32);
+	  sprintf(name,"%.*s/%d-%d",spans[i].nameLength,spans[i].name,from-1,to);
+	  destAln[n++]=createAlnEntry(name,slice,0,0,0,'?');
+	} else {
+	  /* Sequence positions of the window; a window with gaps only is
+		 one position long, as in rnazWindow.pl */
+	  name=(char *) space((unsigned) spans[i].nameLength+1);
+	  memcpy(name,spans[i].name,spans[i].nameLength);
+	  inside=0;
+	  for (k=0;k<width;k++) inside+=!IS_GAP(seq[i][k]);
+	  destAln[n++]=createAlnEntry(name,slice,
+								  spans[i].start+offsets->letters[i],
+								  (inside==0) ? 1 : inside,
+								  spans[i].fullLength,
+								  spans[i].strand);
+	}
+  }
+  destAln[n]=NULL;
+
+  free(allGaps);
+  return n;
+}
+
+
+/********************************************************************
+ *                                                                  *
+ * alnColumns -- counts the letters of each column of an alignment  *
+ *                                                                  *
+ ********************************************************************
+ *                                                                  *
+ * AS ... array with sequences                                      *
+ *                                                                  *
+ * The statistics below only depend on how often each letter occurs *
+ * in a column, so they are computed from these counts in O(L*k)    *
+ * for k different letters instead of going over all sequences (or  *
+ * all pairs of them) again. The letters are numbered in the order  *
+ * they first occur.                                                *
+ *                                                                  *
+ * Returns the counts, to be freed with freeAlnColumns()            *
+ *                                                                  *
+ ********************************************************************/
+
+struct aln_columns *alnColumns(const struct aln *AS[]){
+
+  struct aln_columns *cols;
+  int code[256];
+  const unsigned char *seq;
+  int i,k;
+
+  cols=(struct aln_columns *) space(sizeof(struct aln_columns));
+  cols->length=strlen(AS[0]->seq);
+
+  for (i=0;i<256;i++) code[i]=-1;
+  for (i=0;AS[i]!=NULL;i++){
+	seq=(const unsigned char *)AS[i]->seq;
+	for (k=0;k<cols->length;k++){
+	  if (code[seq[k]]<0){
+		code[seq[k]]=cols->k;
+		cols->letters[cols->k++]=(char)seq[k];
+	  }
+	}
+  }
+  cols->n_seq=i;
+
+  cols->count=(int *) space(sizeof(int)*((size_t)cols->length*cols->k+1));
+  for (i=0;AS[i]!=NULL;i++){
+	seq=(const unsigned char *)AS[i]->seq;
+	for (k=0;k<cols->length;k++){
+	  cols->count[(size_t)k*cols->k+code[seq[k]]]++;
+	}
+  }
+  return cols;
+}
+
+void freeAlnColumns(struct aln_columns *cols){
+  free(cols->count);
+  free(cols);
+}
+
 /********************************************************************
  *                                                                  *
  * consensus -- Calculates consensus of alignment                   *
@@ -242,18 +1003,29 @@ int read_maf(FILE *clust, struct aln *alignedSeqs[]) {
  *                                                                  *
  ********************************************************************/
 
- char *consensus(const struct aln *AS[]) {
+char *consensus(const struct aln *AS[]) {
+  struct aln_columns *cols;
+  char *string;
+
+  cols=alnColumns(AS);
+  string=consensusColumns(cols);
+  freeAlnColumns(cols);
+  return string;
+}
+
+char *consensusColumns(const struct aln_columns *cols) {
   char *string;
-  int i,n;
-  n = strlen(AS[0]->seq);
+  const int *count;
+  int i,n,l;
+  n = cols->length;
   string = (char *) space((n+1)*sizeof(char));
   for (i=0; i<n; i++) {
     int s,c,fm, freq[8] = {0,0,0,0,0,0,0,0};
-    for (s=0; AS[s]!=NULL; s++) 
-      freq[encode_char(AS[s]->seq[i])]++;
+    count=cols->count+(size_t)i*cols->k;
+    for (l=0; l<cols->k; l++)
+      freq[encode_char(cols->letters[l])]+=count[l];
     for (s=c=fm=0; s<8; s++) /* find the most frequent char */
       if (freq[s]>fm) {c=s, fm=freq[c];}
-    if (s>4) s++; /* skip T */
     string[i]=Law_and_Order[c];
   }
   return string;
@@ -271,30 +1043,42 @@ int read_maf(FILE *clust, struct aln *alignedSeqs[]) {
  *                                                                  *
  ********************************************************************/
 
- double NormShannonEntropy(const struct aln *AS[]) {
+double NormShannonEntropy(const struct aln *AS[]) {
+  struct aln_columns *cols;
+  double entropy;
+
+  cols=alnColumns(AS);
+  entropy=NormShannonEntropyColumns(cols);
+  freeAlnColumns(cols);
+  return entropy;
+}
+
+double NormShannonEntropyColumns(const struct aln_columns *cols) {
 
-   int i,k,length,nr_seqs;
+  int k,l,length,nr_seqs;
   int a,c,g,t,rest;
+  const int *count;
   double entropy;
   entropy = 0.0;
 
-  length=strlen(AS[0]->seq);
+  length=cols->length;
+  nr_seqs=cols->n_seq;
   
   for (k=0;k<length;k++){
-    /* count base frequencies for the current column */
-    a = c = g = t = rest = nr_seqs = 0;
-    for (i=0;AS[i]!=NULL;i++){
-      switch(AS[i]->seq[k])
+    /* base frequencies of the current column */
+    a = c = g = t = 0;
+    count=cols->count+(size_t)k*cols->k;
+    for (l=0;l<cols->k;l++){
+      switch(cols->letters[l])
       {
-        case 'A': a++; break;
-        case 'C': c++; break;
-        case 'G': g++; break;
-	case 'T': t++; break;
-	case 'U': t++; break;
-	default : rest++; break;
+        case 'A': a+=count[l]; break;
+        case 'C': c+=count[l]; break;
+        case 'G': g+=count[l]; break;
+	case 'T': t+=count[l]; break;
+	case 'U': t+=count[l]; break;
       }
-      nr_seqs++;
     }
+    rest=nr_seqs-a-c-g-t;
     
     /* calcualte entropy*/
     if (a > 0) {
@@ -335,24 +1119,38 @@ int read_maf(FILE *clust, struct aln *alignedSeqs[]) {
  *                                                                  *
  ********************************************************************/
 
- double meanPairID(const struct aln *AS[]) {
+double meanPairID(const struct aln *AS[]) {
+  struct aln_columns *cols;
+  double id;
+
+  cols=alnColumns(AS);
+  id=meanPairIDColumns(cols);
+  freeAlnColumns(cols);
+  return id;
+}
+
+/* Two sequences are compared in a column unless both have a gap, so
+   of the n*(n-1)/2 pairs those of the g gaps are not compared; the
+   identical ones are the pairs of each letter other than a gap */
+
+double meanPairIDColumns(const struct aln_columns *cols) {
 
-  int i,j,k,matches,pairs,length;
+  int k,l,matches,pairs,n,h;
+  const int *count;
 
   matches=0;
   pairs=0;
-
-  length=strlen(AS[0]->seq);
-  
-  for (i=0;AS[i]!=NULL;i++){
-	for (j=i+1;AS[j]!=NULL;j++){
-	  for (k=0;k<length;k++){
-		if ((AS[i]->seq[k]!='-') || (AS[j]->seq[k]!='-')){
-		  if (AS[i]->seq[k]==AS[j]->seq[k]){
-			matches++;
-		  }
-		  pairs++;
-		}
+  n=cols->n_seq;
+
+  for (k=0;k<cols->length;k++){
+	count=cols->count+(size_t)k*cols->k;
+	pairs+=n*(n-1)/2;
+	for (l=0;l<cols->k;l++){
+	  h=count[l];
+	  if (cols->letters[l]=='-'){
+		pairs-=h*(h-1)/2;
+	  } else {
+		matches+=h*(h-1)/2;
 	  }
 	}
   }
@@ -668,12 +1466,42 @@ struct aln* createAlnEntry(char* name, char* seq, int start, int length, int ful
 
 double combPerPair(struct aln *AS[],char* structure){
 
+  struct aln_columns *cols;
+  double comb;
+
+  cols=alnColumns((const struct aln **)AS);
+  comb=combPerPairColumns(AS,cols,structure);
+  freeAlnColumns(cols);
+  return comb;
+}
+
+/* Bases (encodeBase()) of a column that occur at least once */
+
+PRIVATE void columnBases(const struct aln_columns *cols, int col, int present[4]){
+
+  const int *count=cols->count+(size_t)col*cols->k;
+  int l,b;
+
+  present[0]=present[1]=present[2]=present[3]=0;
+  for (l=0;l<cols->k;l++){
+	if (count[l]>0 && (b=encodeBase(cols->letters[l]))!=-1) present[b]=1;
+  }
+}
+
+/* The same as combPerPair() with the letter counts of AS. Only the
+   combinations the counts allow are looked for, so the sequences are
+   gone through only until all of them are found. */
+
+double combPerPairColumns(struct aln *AS[], const struct aln_columns *cols,
+						  char* structure){
+
   int* stack;
   int stackN;
   int i,j,k,x,y;
-  int nPairs, nCombs;
+  int nPairs, nCombs, possible, seen;
   char c;
   int base1,base2;
+  int present1[4], present2[4];
   
   int pairMatrix[4][4]={{0,0,0,1},
 						{0,0,1,1},
@@ -695,14 +1523,19 @@ double combPerPair(struct aln *AS[],char* structure){
 	}
 	if (c==')'){
 	  j=stack[--stackN];
-	  //printf("Base pair: %d %d\n",j,i);
+
+	  columnBases(cols,j,present1);
+	  columnBases(cols,i,present2);
+	  possible=0;
 	  for (x=0;x<4;x++){
 		for (y=0;y<4;y++){
 		  seenMatrix[x][y]=0;
+		  if (pairMatrix[x][y] && present1[x] && present2[y]) possible++;
 		}
 	  }
+	  seen=0;
 	  k=0;
-	  while (AS[k]!=NULL){
+	  while (AS[k]!=NULL && seen<possible){
 		base1=encodeBase(AS[k]->seq[j]);
 		base2=encodeBase(AS[k]->seq[i]);
 
@@ -713,13 +1546,13 @@ double combPerPair(struct aln *AS[],char* structure){
 		
 		if (pairMatrix[base1][base2]){
 		  if (!seenMatrix[base1][base2]){
-			nCombs++;
+			seen++;
 			seenMatrix[base1][base2]=1;
 		  }
 		}
-		//printf("Seq %d: %d %d\n",k,base1,base2);
 		k++;
 	  }
+	  nCombs+=seen;
 	  nPairs++;
 	}
 	i++;
@@ -20,17 +20,96 @@ int read_clustal(FILE *clust,
 int read_maf(FILE *clust,
 						 struct aln *alignedSeqs[]);
 
+/* One sequence of an alignment that has not been copied yet: name
+   and sequence point into a mapped file (or another alignment) and
+   are not 0-terminated */
+struct aln_span {
+  const char *name;
+  int nameLength;
+  const char *seq;
+  int seqLength;
+  int start;
+  int length;
+  int fullLength;
+  char strand;
+};
+
+struct aln_map;
+
+struct aln_map *mapAlnFile(FILE *file);
+
+void unmapAlnFile(struct aln_map *map);
+
+int read_clustal_mapped(struct aln_map *map, struct aln_span spans[]);
+
+int read_maf_mapped(struct aln_map *map, struct aln_span spans[]);
+
+void alnSpans(const struct aln *AS[], struct aln_span spans[]);
+
+void sliceSpans(const struct aln_span spans[], int n_seq,
+                struct aln *destAln[], int from, int to);
+
+/* Filters applied to the windows of an alignment, the same as in
+   rnazWindow.pl; identities are in percent */
+struct window_filter {
+  int minLength;
+  double maxGap;
+  double maxMasked;
+  int minSeqs;
+  int maxSeqs;
+  double minID;
+  double optID;
+  double maxID;
+  int reference;    /* first sequence is the reference */
+  int rangeCheck;   /* remove sequences outside the training range */
+};
+
+/* Letters (not gaps) of each sequence before a column, carried along
+   by windowSpans() from one window to the next; all zero for a new
+   alignment */
+struct span_offsets {
+  int column;                  /* counted in the columns before this one */
+  int letters[MAX_NUM_NAMES];
+};
+
+int windowSpans(const struct aln_span spans[], int n_seq,
+                struct aln *destAln[], int rows[], int from, int to,
+                const struct window_filter *filter,
+                struct span_offsets *offsets);
+
+
+/* How often each letter occurs in each column of an alignment */
+struct aln_columns {
+  int n_seq;
+  int length;
+  int k;             /* number of different letters */
+  char letters[256];
+  int *count;        /* count[i*k+l]: sequences with letters[l] in column i */
+};
+
+struct aln_columns *alnColumns(const struct aln *AS[]);
+
+void freeAlnColumns(struct aln_columns *cols);
 
 char *consensus(const struct aln *AS[]);
 
+char *consensusColumns(const struct aln_columns *cols);
+
 double meanPairID(const struct aln *AS[]);
 
+double meanPairIDColumns(const struct aln_columns *cols);
+
 double NormShannonEntropy(const struct aln *AS[]);
 
+double NormShannonEntropyColumns(const struct aln_columns *cols);
+
 void revAln(struct aln *AS[]);
 
 double combPerPair(struct aln *AS[],char* structure);
 
+double combPerPairColumns(struct aln *AS[], const struct aln_columns *cols,
+                          char* structure);
+
 int encodeBase(char base);
 
 void sliceAln(const struct aln *sourceAln[], struct aln *destAln[],
@@ -0,0 +1,103 @@
+/*********************************************************************
+ *                                                                   *
+ *                            round_check.c                          *
+ *                                                                   *
+ *	round_check [seed]                                           *
+ *                                                                   *
+ *	round_decimals() must give the same double as atof() of      *
+ *	sprintf("%.<digits>f"), which it replaces, for 3 to 5        *
+ *	digits. Goes over the values the regression features are     *
+ *	made of: all ratios of counts up to 1000, the length term,   *
+ *	sums and ratios of rounded base frequencies, and random      *
+ *	ties of the rounding with their neighbours. Run by           *
+ *	"make check".                                                *
+ *                                                                   *
+ *********************************************************************/
+
+#include "config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "utils.h"
+#include "zscore.h"
+
+#define PRIVATE static
+#define RANDOM 1000000
+
+PRIVATE long checked=0;
+
+/* Both signs and all digits; the bits are compared, so that -0 and 0
+   are told apart */
+PRIVATE int same_rounding(double v){
+
+  char buf[512];
+  double fast, ref;
+  int digits, sign;
+
+  for (sign=0;sign<2;sign++,v=-v){
+	for (digits=3;digits<=5;digits++){
+	  snprintf(buf,sizeof(buf),"%.*f",digits,v);
+	  ref=atof(buf);
+	  fast=round_decimals(v,digits);
+	  checked++;
+	  if (memcmp(&fast,&ref,sizeof(double))!=0){
+		fprintf(stderr,"round_decimals(%.17g, %d) is %.17g, not %s\n",
+				v,digits,fast,buf);
+		return 0;
+	  }
+	}
+  }
+  return 1;
+}
+
+int main(int argc, char *argv[]){
+
+  static const double scale[]={1e3,1e4,1e5};
+  double mono[4], tie;
+  int i, k, n, length, count[4];
+
+  if (argc>1){
+	xsubi[0]=xsubi[1]=xsubi[2]=(unsigned short)strtoul(argv[1],NULL,10);
+  } else xsubi[0]=xsubi[1]=xsubi[2]=4711;
+
+  for (n=1;n<=1000;n++){
+	for (k=0;k<=n;k++){
+	  if (!same_rounding((double)k/n)) return 1;
+	}
+  }
+
+  for (length=1;length<=10000;length++){
+	if (!same_rounding((double)(length-50)/150)) return 1;
+  }
+
+  /* G+C content, C/(C+G) and A/(A+T) as regression_features() forms
+	 them from the rounded base frequencies */
+  for (i=0;i<RANDOM/10;i++){
+	length=int_urn(1,1000);
+	count[0]=int_urn(0,length);
+	count[1]=int_urn(0,length-count[0]);
+	count[2]=int_urn(0,length-count[0]-count[1]);
+	count[3]=length-count[0]-count[1]-count[2];
+	for (k=0;k<4;k++) mono[k]=round_decimals((double)count[k]/length,3);
+	if (!same_rounding(mono[1]+mono[2])) return 1;
+	if (mono[1]+mono[2]>0 && !same_rounding(mono[1]/(mono[1]+mono[2]))) return 1;
+	if (mono[0]+mono[3]>0 && !same_rounding(mono[0]/(mono[0]+mono[3]))) return 1;
+  }
+
+  for (i=0;i<RANDOM;i++){
+	tie=(int_urn(0,200000)+0.5)/scale[int_urn(0,2)];
+	if (!same_rounding(tie) ||
+		!same_rounding(nextafter(tie,0)) ||
+		!same_rounding(nextafter(tie,1e300)) ||
+		!same_rounding((urn()-0.5)*2000) ||
+		!same_rounding(pow(10,urn()*16-10))) return 1;
+  }
+
+  if (!same_rounding(0.0) || !same_rounding(1e-300) || !same_rounding(1e15)){
+	return 1;
+  }
+
+  printf("%ld roundings, all the same as atof(sprintf())\n",checked);
+  return 0;
+}
@@ -9,6 +9,7 @@
  *                                                                   *
  *********************************************************************/
 
+#include "config.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
@@ -27,7 +28,7 @@
 #include "strand.h"
 
 /* wash */
-#include "strand.inc"
+extern const struct svm_model_image default_strand_model_image;
 
 /* Global variables */
 struct svm_model *strand_model=NULL;
@@ -281,7 +282,7 @@ int checkStrandDescriptors(double deltaSCI, double deltaMeanMFE, double deltaCon
 void strand_svm_init(char *basefilename){
   strand_model=NULL;
   
-  strand_model=svm_load_model_string(default_strand_model_string);
+  strand_model=svm_load_model_image(&default_strand_model_image);
   
   if (strand_model==NULL){
 	fprintf(stderr, "\n\nERROR: Could not load strand model. \n");
@@ -0,0 +1,102 @@
+/*********************************************************************
+ *                                                                   *
+ *                             svm_check.c                           *
+ *                                                                   *
+ *	svm_check [seed]                                             *
+ *                                                                   *
+ *	Predicts random queries with the dense model pairs of all    *
+ *	G+C bins, alone and in batches of 1 to MAX_BATCH, and with   *
+ *	libsvm. Mean and standard deviation must be the same         *
+ *	doubles, with the generic, the AVX2 and the AVX-512 kernel   *
+ *	as far as the CPU has them. Run by "make check".             *
+ *                                                                   *
+ *********************************************************************/
+
+#include "config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include "utils.h"
+#include "svm.h"
+#include "svm_helper.h"
+#include "svm_dense.h"
+
+#define PRIVATE static
+#define QUERIES 100     /* per model pair and kernel */
+#define DIM 20
+#define MAX_BATCH 40
+
+/* Features like the ones zscore.c sets, three decimals each and the
+   scaled length last; one query in four is anywhere in [-2,2] */
+PRIVATE void random_features(double *x){
+
+  int k;
+
+  if (urn()<0.25){
+	for (k=0;k<DIM;k++) x[k]=(urn()-0.5)*4;
+	return;
+  }
+  x[0]=int_urn(200,800)/1000.0;
+  x[1]=int_urn(0,1000)/1000.0;
+  x[2]=int_urn(0,1000)/1000.0;
+  for (k=3;k<DIM-1;k++) x[k]=int_urn(0,250)/1000.0;
+  x[DIM-1]=(double)(int_urn(50,400)-50)/150;
+}
+
+PRIVATE double libsvm_predict(const struct svm_model *model, const double *x){
+
+  struct svm_node node[DIM+1];
+  int k;
+
+  for (k=0;k<DIM;k++){
+	node[k].index=k+1;
+	node[k].value=x[k];
+  }
+  node[DIM].index=-1;
+  return svm_predict(model,node);
+}
+
+int main(int argc, char *argv[]){
+
+  struct svm_model *avg_model=NULL, *stdv_model=NULL;
+  struct svm_dense_pair *pair;
+  double x[MAX_BATCH*DIM], avg[MAX_BATCH], stdv[MAX_BATCH];
+  double one_avg, one_stdv, ref_avg, ref_stdv;
+  int type, simd, q, n, i, queries=0;
+
+  if (argc>1){
+	xsubi[0]=xsubi[1]=xsubi[2]=(unsigned short)strtoul(argv[1],NULL,10);
+  } else xsubi[0]=xsubi[1]=xsubi[2]=4711;
+
+  for (type=0;type<10;type++){
+	get_regression_models(&avg_model,&stdv_model,type);
+	for (simd=0;simd<=2;simd++){
+	  svm_dense_simd=simd;
+	  pair=get_regression_pair(type);
+	  for (q=0;q<QUERIES;q+=n){
+		n=int_urn(1,MAX_BATCH);
+		for (i=0;i<n;i++) random_features(x+i*DIM);
+		svm_dense_pair_predict_batch(pair,x,n,avg,stdv);
+		for (i=0;i<n;i++){
+		  svm_dense_pair_predict(pair,x+i*DIM,&one_avg,&one_stdv);
+		  ref_avg=libsvm_predict(avg_model,x+i*DIM);
+		  ref_stdv=libsvm_predict(stdv_model,x+i*DIM);
+		  if (avg[i]!=ref_avg || stdv[i]!=ref_stdv ||
+			  one_avg!=ref_avg || one_stdv!=ref_stdv){
+			fprintf(stderr,"bin %d, kernel %d, query %d of %d: %.17g, %.17g"
+					" (alone %.17g, %.17g) instead of %.17g, %.17g\n",
+					type,simd,i,n,avg[i],stdv[i],one_avg,one_stdv,
+					ref_avg,ref_stdv);
+			return 1;
+		  }
+		}
+		queries+=n;
+	  }
+	  svm_dense_pair_free(pair);
+	}
+	svm_free_and_destroy_model(&avg_model);
+	svm_free_and_destroy_model(&stdv_model);
+  }
+
+  printf("%d queries, all the same as svm_predict()\n",queries);
+  return 0;
+}
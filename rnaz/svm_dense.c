@@ -0,0 +1,316 @@
+/*********************************************************************
+ *                                                                   *
+ *                              svm_dense.c                          *
+ *                                                                   *
+ *	Fast prediction with a pair of RBF regression models (mean   *
+ *	and standard deviation) whose support vectors all have the   *
+ *	same dense features.                                         *
+ *                                                                   *
+ *	The distinct support vectors of both models are stored once, *
+ *	in blocks of SV_BLOCK vectors, feature-major inside a block, *
+ *	so the squared distances of a query to a whole block are     *
+ *	computed with a few vector instructions, in one pass for     *
+ *	both models. Each lane adds up the features in the same      *
+ *	order as Kernel::k_function() in libsvm and the kernel       *
+ *	values are summed up one by one in support vector order, so  *
+ *	both results are the same doubles svm_predict() gives.       *
+ *                                                                   *
+ *********************************************************************/
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "svm.h"
+#include "svm_helper.h"
+#include "svm_dense.h"
+#include "utils.h"
+
+#ifdef HAVE_SIMD_DISPATCH
+#include <immintrin.h>
+#endif
+
+#define PRIVATE static
+
+/* Support vectors per block; one AVX-512 or two AVX2 registers */
+#define SV_BLOCK 8
+
+/* Widest kernel predictors made from now on may use, see svm_dense.h */
+int svm_dense_simd=2;
+
+/* Blocks one batch of queries is run over at a time (80k for 20
+   features, fits into L2) */
+#define RUN_BLOCKS 64
+
+/* Squared distances of x to the support vectors in blocks
+   b..b+n_blocks-1, lane by lane into d[] */
+typedef void (*dense_distances_fn)(const struct svm_dense_pair *pair,
+                                   const double *x, int b, int n_blocks,
+                                   double *d);
+
+struct svm_dense_pair {
+  int n_rows;             /* distinct support vectors of both models */
+  int dim;                /* number of features */
+  int n_blocks;
+  double *sv;             /* block b, feature k, lane j is
+                             sv[(b*dim+k)*SV_BLOCK+j] */
+  void *sv_space;         /* unaligned allocation behind sv */
+  dense_distances_fn distances;
+
+  /* [0] is the mean, [1] the standard deviation model */
+  int l[2];               /* number of support vectors */
+  int *row[2];            /* support vector i is row[m][i] of sv */
+  const double *sv_coef[2];  /* owned by the images */
+  double gamma[2];
+  double rho[2];
+};
+
+PRIVATE void distances_generic(const struct svm_dense_pair *pair,
+                               const double *x, int b, int n_blocks,
+                               double *d){
+  const double *block;
+  double t;
+  int i, j, k;
+
+  for (i=0;i<n_blocks;i++,d+=SV_BLOCK){
+    block=pair->sv+(size_t)(b+i)*pair->dim*SV_BLOCK;
+    for (j=0;j<SV_BLOCK;j++) d[j]=0;
+    for (k=0;k<pair->dim;k++){
+      for (j=0;j<SV_BLOCK;j++){
+        t=x[k]-block[k*SV_BLOCK+j];
+        d[j]+=t*t;
+      }
+    }
+  }
+}
+
+#ifdef HAVE_SIMD_DISPATCH
+
+/* FMA would round differently from libsvm, so contraction is turned
+   off where the target allows it */
+
+__attribute__ ((target ("avx2"), optimize ("fp-contract=off")))
+PRIVATE void distances_avx2(const struct svm_dense_pair *pair,
+                            const double *x, int b, int n_blocks,
+                            double *d){
+  const double *block;
+  __m256d xk, t0, t1, d0, d1;
+  int i, k;
+
+  for (i=0;i<n_blocks;i++,d+=SV_BLOCK){
+    block=pair->sv+(size_t)(b+i)*pair->dim*SV_BLOCK;
+    d0=d1=_mm256_setzero_pd();
+    for (k=0;k<pair->dim;k++){
+      xk=_mm256_set1_pd(x[k]);
+      t0=_mm256_sub_pd(xk,_mm256_load_pd(block+k*SV_BLOCK));
+      t1=_mm256_sub_pd(xk,_mm256_load_pd(block+k*SV_BLOCK+4));
+      d0=_mm256_add_pd(d0,_mm256_mul_pd(t0,t0));
+      d1=_mm256_add_pd(d1,_mm256_mul_pd(t1,t1));
+    }
+    _mm256_store_pd(d,d0);
+    _mm256_store_pd(d+4,d1);
+  }
+}
+
+__attribute__ ((target ("avx512f"), optimize ("fp-contract=off")))
+PRIVATE void distances_avx512(const struct svm_dense_pair *pair,
+                              const double *x, int b, int n_blocks,
+                              double *d){
+  const double *block;
+  __m512d xk, t, d0;
+  int i, k;
+
+  for (i=0;i<n_blocks;i++,d+=SV_BLOCK){
+    block=pair->sv+(size_t)(b+i)*pair->dim*SV_BLOCK;
+    d0=_mm512_setzero_pd();
+    for (k=0;k<pair->dim;k++){
+      xk=_mm512_set1_pd(x[k]);
+      t=_mm512_sub_pd(xk,_mm512_load_pd(block+k*SV_BLOCK));
+      d0=_mm512_add_pd(d0,_mm512_mul_pd(t,t));
+    }
+    _mm512_store_pd(d,d0);
+  }
+}
+
+#endif
+
+/* Picks the widest kernel the CPU we are running on supports, up to
+   svm_dense_simd */
+
+PRIVATE dense_distances_fn select_distances(void){
+
+#ifdef HAVE_SIMD_DISPATCH
+  __builtin_cpu_init();
+  if (svm_dense_simd>=2 && __builtin_cpu_supports("avx512f")) return distances_avx512;
+  if (svm_dense_simd>=1 && __builtin_cpu_supports("avx2")) return distances_avx2;
+#endif
+  return distances_generic;
+}
+
+/* FNV-1a over the bytes of a support vector */
+
+PRIVATE unsigned long row_hash(const double *v, int dim){
+
+  const unsigned char *p=(const unsigned char *)v;
+  unsigned long h=2166136261UL;
+  size_t i;
+
+  for (i=0;i<sizeof(double)*dim;i++){
+    h^=p[i];
+    h*=16777619UL;
+  }
+  return h;
+}
+
+
+struct svm_dense_pair *svm_dense_pair_create(const struct svm_model_image *avg_image,
+                                             const struct svm_model_image *stdv_image){
+
+  const struct svm_model_image *image[2];
+  struct svm_dense_pair *pair;
+  const double **rows, *v;
+  int *table;
+  unsigned long size, h;
+  int i, k, m, dim;
+
+  image[0]=avg_image;
+  image[1]=stdv_image;
+
+  for (m=0;m<2;m++){
+    if (image[m]->kernel_type!=RBF ||
+        (image[m]->svm_type!=EPSILON_SVR && image[m]->svm_type!=NU_SVR)){
+      nrerror("ERROR: Dense SVM prediction needs an RBF regression model.\n");
+    }
+  }
+  if (image[0]->dim!=image[1]->dim){
+    nrerror("ERROR: Regression models have different numbers of features.\n");
+  }
+
+  pair=(struct svm_dense_pair *)space(sizeof(struct svm_dense_pair));
+  pair->dim=dim=image[0]->dim;
+
+  /* Find the distinct support vectors; table[] is an open addressing
+     hash of row numbers+1 (0 is empty) */
+  rows=(const double **)space(sizeof(double *)*(image[0]->l+image[1]->l));
+  size=1;
+  while (size<2*(unsigned long)(image[0]->l+image[1]->l)) size<<=1;
+  table=(int *)space(sizeof(int)*size);
+
+  for (m=0;m<2;m++){
+    pair->l[m]=image[m]->l;
+    pair->row[m]=(int *)space(sizeof(int)*image[m]->l);
+    pair->sv_coef[m]=image[m]->sv_coef;
+    pair->gamma[m]=image[m]->gamma;
+    pair->rho[m]=image[m]->rho[0];
+
+    for (i=0;i<image[m]->l;i++){
+      v=image[m]->sv+(size_t)i*dim;
+      h=row_hash(v,dim)&(size-1);
+      while (table[h]!=0 && memcmp(rows[table[h]-1],v,sizeof(double)*dim)!=0){
+        h=(h+1)&(size-1);
+      }
+      if (table[h]==0){
+        rows[pair->n_rows]=v;
+        table[h]=++pair->n_rows;
+      }
+      pair->row[m][i]=table[h]-1;
+    }
+  }
+
+  /* 64 byte aligned, padding lanes of the last block stay 0 */
+  pair->n_blocks=(pair->n_rows+SV_BLOCK-1)/SV_BLOCK;
+  pair->sv_space=space(sizeof(double)*(size_t)pair->n_blocks*dim*SV_BLOCK+63);
+  pair->sv=(double *)(((size_t)pair->sv_space+63) & ~(size_t)63);
+
+  for (i=0;i<pair->n_rows;i++){
+    for (k=0;k<dim;k++){
+      pair->sv[((size_t)(i/SV_BLOCK)*dim+k)*SV_BLOCK+i%SV_BLOCK]=rows[i][k];
+    }
+  }
+
+  pair->distances=select_distances();
+
+  free(table);
+  free(rows);
+
+  return pair;
+}
+
+/* Turns the distances d[] of one query into both decision values */
+
+PRIVATE void pair_values(const struct svm_dense_pair *pair, double *d,
+                         double *avg, double *stdv){
+
+  double value[2], sum;
+  int i, m;
+
+  if (pair->gamma[0]==pair->gamma[1]){
+    /* same kernel, so the kernel values are shared as well */
+    for (i=0;i<pair->n_rows;i++){
+      d[i]=exp(-pair->gamma[0]*d[i]);
+    }
+    for (m=0;m<2;m++){
+      sum=0;
+      for (i=0;i<pair->l[m];i++){
+        sum+=pair->sv_coef[m][i]*d[pair->row[m][i]];
+      }
+      value[m]=sum-pair->rho[m];
+    }
+  } else {
+    for (m=0;m<2;m++){
+      sum=0;
+      for (i=0;i<pair->l[m];i++){
+        sum+=pair->sv_coef[m][i]*exp(-pair->gamma[m]*d[pair->row[m][i]]);
+      }
+      value[m]=sum-pair->rho[m];
+    }
+  }
+
+  *avg=value[0];
+  *stdv=value[1];
+}
+
+void svm_dense_pair_predict_batch(const struct svm_dense_pair *pair,
+                                  const double *x, int n,
+                                  double *avg, double *stdv){
+
+  double *d, *space_d;
+  size_t stride;
+  int b, n_blocks, q;
+
+  if (n<=0) return;
+
+  stride=(size_t)pair->n_blocks*SV_BLOCK;
+  space_d=(double *)space(sizeof(double)*stride*n+63);
+  d=(double *)(((size_t)space_d+63) & ~(size_t)63);
+
+  /* All queries go over a run of blocks while it is in the cache */
+  for (b=0;b<pair->n_blocks;b+=RUN_BLOCKS){
+    n_blocks=pair->n_blocks-b;
+    if (n_blocks>RUN_BLOCKS) n_blocks=RUN_BLOCKS;
+    for (q=0;q<n;q++){
+      pair->distances(pair,x+(size_t)q*pair->dim,b,n_blocks,
+                      d+q*stride+(size_t)b*SV_BLOCK);
+    }
+  }
+
+  for (q=0;q<n;q++){
+    pair_values(pair,d+q*stride,avg+q,stdv+q);
+  }
+
+  free(space_d);
+}
+
+void svm_dense_pair_predict(const struct svm_dense_pair *pair, const double *x,
+                            double *avg, double *stdv){
+  svm_dense_pair_predict_batch(pair,x,1,avg,stdv);
+}
+
+void svm_dense_pair_free(struct svm_dense_pair *pair){
+  if (pair==NULL) return;
+  free(pair->row[0]);
+  free(pair->row[1]);
+  free(pair->sv_space);
+  free(pair);
+}
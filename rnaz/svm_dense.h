@@ -0,0 +1,36 @@
+/*********************************************************************
+ *                                                                   *
+ *                              svm_dense.h                          *
+ *                                                                   *
+ *	Fast prediction with a pair of RBF regression models (mean   *
+ *	and standard deviation) whose support vectors all have the   *
+ *	same dense features.                                         *
+ *                                                                   *
+ *********************************************************************/
+
+struct svm_model_image;
+
+struct svm_dense_pair;
+
+/* 0: predictors made from now on use the generic kernel only, 1: at
+   most AVX2, 2: AVX-512 where the CPU has it (default) */
+extern int svm_dense_simd;
+
+/* Builds a predictor for two compiled-in model images with the same
+   features. Only RBF regression models (epsilon-SVR, nu-SVR) are
+   supported. */
+struct svm_dense_pair *svm_dense_pair_create(const struct svm_model_image *avg_image,
+                                             const struct svm_model_image *stdv_image);
+
+/* Same values as svm_predict() for a query with the features
+   x[0..dim-1] (libsvm indices 1..dim), for both models at once */
+void svm_dense_pair_predict(const struct svm_dense_pair *pair, const double *x,
+                            double *avg, double *stdv);
+
+/* The same for n queries, x[q*dim .. q*dim+dim-1] for query q; the
+   support vectors are read only once for all of them */
+void svm_dense_pair_predict_batch(const struct svm_dense_pair *pair,
+                                  const double *x, int n,
+                                  double *avg, double *stdv);
+
+void svm_dense_pair_free(struct svm_dense_pair *pair);
@@ -19,38 +19,37 @@
 #include <string.h>
 #include "svm.h"
 #include "svm_helper.h"
+#include "svm_dense.h"
 #include "rnaz_utils.h"
 #include "utils.h"
 
-#include "mfe_stdv.inc"
-#include "mfe_avg.inc"
-#include "decision.inc"
-#include "decision_dinucleotide.inc"
-#include "decision_dinucleotide_structural.inc"
-
-
-/* Here we read in the models as strings */
-#include "L50-200_GC20-30_avg.inc"
-#include "L50-200_GC20-30_stdv.inc"
-#include "L50-200_GC30-36_avg.inc"
-#include "L50-200_GC30-36_stdv.inc"
-#include "L50-200_GC36-40_avg.inc"
-#include "L50-200_GC36-40_stdv.inc"
-#include "L50-200_GC40-46_avg.inc"
-#include "L50-200_GC40-46_stdv.inc"
-#include "L50-200_GC46-50_avg.inc"
-#include "L50-200_GC46-50_stdv.inc"
-#include "L50-200_GC50-56_avg.inc"
-#include "L50-200_GC50-56_stdv.inc"
-#include "L50-200_GC56-60_avg.inc"
-#include "L50-200_GC56-60_stdv.inc"
-#include "L50-200_GC60-66_avg.inc"
-#include "L50-200_GC60-66_stdv.inc"
-#include "L50-200_GC66-70_avg.inc"
-#include "L50-200_GC66-70_stdv.inc"
-#include "L50-200_GC70-80_avg.inc"
-#include "L50-200_GC70-80_stdv.inc"
-
+/* The models, converted from the .inc files in models/ at build time (see
+   models/ModelImage.pl and model_images.c) */
+extern const struct svm_model_image default_stdv_model_image;
+extern const struct svm_model_image default_avg_model_image;
+extern const struct svm_model_image default_decision_model_image;
+extern const struct svm_model_image decision_dinucleotide_image;
+extern const struct svm_model_image decision_dinucleotide_structural_image;
+extern const struct svm_model_image avg_20_30_image;
+extern const struct svm_model_image stdv_20_30_image;
+extern const struct svm_model_image avg_30_36_image;
+extern const struct svm_model_image stdv_30_36_image;
+extern const struct svm_model_image avg_36_40_image;
+extern const struct svm_model_image stdv_36_40_image;
+extern const struct svm_model_image avg_40_46_image;
+extern const struct svm_model_image stdv_40_46_image;
+extern const struct svm_model_image avg_46_50_image;
+extern const struct svm_model_image stdv_46_50_image;
+extern const struct svm_model_image avg_50_56_image;
+extern const struct svm_model_image stdv_50_56_image;
+extern const struct svm_model_image avg_56_60_image;
+extern const struct svm_model_image stdv_56_60_image;
+extern const struct svm_model_image avg_60_66_image;
+extern const struct svm_model_image stdv_60_66_image;
+extern const struct svm_model_image avg_66_70_image;
+extern const struct svm_model_image stdv_66_70_image;
+extern const struct svm_model_image avg_70_80_image;
+extern const struct svm_model_image stdv_70_80_image;
 
 
 /* All values in the SVMs are normalized to mean 0 and standard
@@ -148,61 +147,94 @@ void backscale_regression(double* avg, double* stdv){
 }
 
 
-/* Loads both models for average and standard deviation from files
-   given by a common basename. If no name is given, default models
-   hard-coded in this file are used */
+/* The average and standard deviation models of one G+C bin
+   (type 0..9), or the mononucleotide models for type -1 */
 
-void get_regression_models(struct svm_model** avg_model,
-			   struct svm_model** stdv_model,
-			   int type){
+static void regression_images(const struct svm_model_image** avg_image,
+			      const struct svm_model_image** stdv_image,
+			      int type){
+
+  *avg_image=*stdv_image=NULL;
 
   if (type == -1) {
-    *avg_model=svm_load_model_string(default_avg_model_string);
-    *stdv_model=svm_load_model_string(default_stdv_model_string);
+    *avg_image=&default_avg_model_image;
+    *stdv_image=&default_stdv_model_image;
   }
   if (type == 0) {
-    *avg_model=svm_load_model_string(avg_20_30_string);
-    *stdv_model=svm_load_model_string(stdv_20_30_string);
+    *avg_image=&avg_20_30_image;
+    *stdv_image=&stdv_20_30_image;
   }
   if (type == 1) {
-    *avg_model=svm_load_model_string(avg_30_36_string);
-    *stdv_model=svm_load_model_string(stdv_30_36_string);
-    }
-  if (type == 2) { 
-    *avg_model=svm_load_model_string(avg_36_40_string);
-    *stdv_model=svm_load_model_string(stdv_36_40_string);
+    *avg_image=&avg_30_36_image;
+    *stdv_image=&stdv_30_36_image;
+  }
+  if (type == 2) {
+    *avg_image=&avg_36_40_image;
+    *stdv_image=&stdv_36_40_image;
   }
   if (type == 3) {
-    *avg_model=svm_load_model_string(avg_40_46_string);
-    *stdv_model=svm_load_model_string(stdv_40_46_string);
+    *avg_image=&avg_40_46_image;
+    *stdv_image=&stdv_40_46_image;
   }
   if (type == 4) {
-    *avg_model=svm_load_model_string(avg_46_50_string);
-    *stdv_model=svm_load_model_string(stdv_46_50_string);
+    *avg_image=&avg_46_50_image;
+    *stdv_image=&stdv_46_50_image;
   }
   if (type == 5) {
-    *avg_model=svm_load_model_string(avg_50_56_string);
-    *stdv_model=svm_load_model_string(stdv_50_56_string);
+    *avg_image=&avg_50_56_image;
+    *stdv_image=&stdv_50_56_image;
   }
   if (type == 6) {
-    *avg_model=svm_load_model_string(avg_56_60_string);
-    *stdv_model=svm_load_model_string(stdv_56_60_string);
+    *avg_image=&avg_56_60_image;
+    *stdv_image=&stdv_56_60_image;
   }
   if (type == 7) {
-      *avg_model=svm_load_model_string(avg_60_66_string);
-      *stdv_model=svm_load_model_string(stdv_60_66_string);
+    *avg_image=&avg_60_66_image;
+    *stdv_image=&stdv_60_66_image;
   }
   if (type == 8) {
-    *avg_model=svm_load_model_string(avg_66_70_string);
-    *stdv_model=svm_load_model_string(stdv_66_70_string);
+    *avg_image=&avg_66_70_image;
+    *stdv_image=&stdv_66_70_image;
   }
   if (type == 9) {
-    *avg_model=svm_load_model_string(avg_70_80_string);
-    *stdv_model=svm_load_model_string(stdv_70_80_string);
+    *avg_image=&avg_70_80_image;
+    *stdv_image=&stdv_70_80_image;
   }
 }
 
 
+/* Loads both models for average and standard deviation from files
+   given by a common basename. If no name is given, default models
+   hard-coded in this file are used */
+
+void get_regression_models(struct svm_model** avg_model,
+			   struct svm_model** stdv_model,
+			   int type){
+
+  const struct svm_model_image *avg_image, *stdv_image;
+
+  regression_images(&avg_image, &stdv_image, type);
+  if (avg_image == NULL) return;
+
+  *avg_model=svm_load_model_image(avg_image);
+  *stdv_model=svm_load_model_image(stdv_image);
+}
+
+
+/* Same models as get_regression_models(), as one dense predictor
+   for both (see svm_dense.c) */
+
+struct svm_dense_pair* get_regression_pair(int type){
+
+  const struct svm_model_image *avg_image, *stdv_image;
+
+  regression_images(&avg_image, &stdv_image, type);
+  if (avg_image == NULL) return NULL;
+
+  return svm_dense_pair_create(avg_image, stdv_image);
+}
+
+
 struct svm_model* get_decision_model(char *basefilename, int decision_model_type){
 
   struct svm_model* model=NULL;
@@ -213,13 +245,13 @@ struct svm_model* get_decision_model(char *basefilename, int decision_model_type
 
   } else {
     if (decision_model_type == 1) {
-	model=svm_load_model_string(default_decision_model_string);
+	model=svm_load_model_image(&default_decision_model_image);
     }
     if (decision_model_type == 2) {
-	model=svm_load_model_string(decision_dinucleotide_string);
+	model=svm_load_model_image(&decision_dinucleotide_image);
     }
     if (decision_model_type == 3) {
-	model=svm_load_model_string(decision_dinucleotide_structural_string);
+	model=svm_load_model_image(&decision_dinucleotide_structural_image);
     }
   }
   
@@ -444,6 +476,82 @@ struct svm_model* svm_load_model_string(char *modelString){
 }
 
 
+/*********************************************************************
+
+ Loads a model from an image made by models/ModelImage.pl. Nothing
+ has to be parsed: the coefficients are copied and the dense support
+ vectors are turned into libsvm nodes, so the model can be used (and
+ freed) like one read by svm_load_model_string. A feature that was
+ missing in the sparse model text is stored as an explicit 0 here,
+ which does not change any kernel value.
+
+*/
+
+struct svm_model* svm_load_model_image(const struct svm_model_image *image){
+
+  struct svm_model *model;
+  struct svm_node *x_space=NULL;
+  int i,k,l,m,n,dim;
+
+  model = (struct svm_model*)space(sizeof(struct svm_model));
+
+  model->param.svm_type=image->svm_type;
+  model->param.kernel_type=image->kernel_type;
+  model->param.degree=image->degree;
+  model->param.gamma=image->gamma;
+  model->param.coef0=image->coef0;
+  model->nr_class=image->nr_class;
+  model->l=image->l;
+
+  n = model->nr_class * (model->nr_class-1)/2;
+  model->rho = (double*)space(sizeof(double)*n);
+  memcpy(model->rho,image->rho,sizeof(double)*n);
+  if (image->probA!=NULL){
+	model->probA = (double*)space(sizeof(double)*n);
+	memcpy(model->probA,image->probA,sizeof(double)*n);
+  }
+  if (image->probB!=NULL){
+	model->probB = (double*)space(sizeof(double)*n);
+	memcpy(model->probB,image->probB,sizeof(double)*n);
+  }
+  if (image->label!=NULL){
+	model->label = (int*)space(sizeof(int)*model->nr_class);
+	memcpy(model->label,image->label,sizeof(int)*model->nr_class);
+  }
+  if (image->nSV!=NULL){
+	model->nSV = (int*)space(sizeof(int)*model->nr_class);
+	memcpy(model->nSV,image->nSV,sizeof(int)*model->nr_class);
+  }
+
+  m = model->nr_class - 1;
+  l = model->l;
+  dim = image->dim;
+  model->sv_coef = (double**)space(sizeof(double*)*m);
+  for(k=0;k<m;k++){
+	model->sv_coef[k] = (double*)space(sizeof(double)*l);
+	memcpy(model->sv_coef[k],image->sv_coef+(size_t)k*l,sizeof(double)*l);
+  }
+  model->SV = (struct svm_node**)space(sizeof(struct svm_node*)*l);
+
+  if(l>0){
+	x_space = (struct svm_node*)space(sizeof(struct svm_node)*(size_t)l*(dim+1));
+  }
+
+  for(i=0;i<l;i++){
+	model->SV[i] = &x_space[(size_t)i*(dim+1)];
+	for(k=0;k<dim;k++){
+	  model->SV[i][k].index = k+1;
+	  model->SV[i][k].value = image->sv[(size_t)i*dim+k];
+	}
+	model->SV[i][dim].index = -1;
+  }
+
+  model->free_sv = 1;
+
+  return(model);
+}
+
+
 int print_model(const char *model_file_name, struct svm_model *model)
 {
 
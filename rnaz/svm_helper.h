@@ -16,6 +16,10 @@ void get_regression_models(struct svm_model** avg_model,
 			   struct svm_model** stdv_model,
 			   int type);
 
+struct svm_dense_pair;
+
+struct svm_dense_pair* get_regression_pair(int type);
+
 struct svm_model* get_decision_model(char *basefilename, int decision_model_type);
 
 struct svm_model* default_avg_model();
@@ -32,6 +36,35 @@ void backscale_regression(double* avg, double* stdv);
 
 struct svm_model* svm_load_model_string(char *fp);
 
+/* A libsvm model converted at build time by models/ModelImage.pl.
+   The support vectors are one dense row-major l x dim matrix. */
+
+#ifdef __GNUC__
+#define MODEL_ALIGN __attribute__ ((aligned (64)))
+#else
+#define MODEL_ALIGN
+#endif
+
+struct svm_model_image {
+  int svm_type;
+  int kernel_type;
+  int degree;
+  double gamma;
+  double coef0;
+  int nr_class;
+  int l;                  /* number of support vectors */
+  int dim;                /* number of features */
+  const double *sv;       /* support vector i is sv[i*dim .. i*dim+dim-1] */
+  const double *sv_coef;  /* (nr_class-1) rows of l coefficients */
+  const double *rho;
+  const double *probA;    /* the rest may be NULL */
+  const double *probB;
+  const int *label;
+  const int *nSV;
+};
+
+struct svm_model* svm_load_model_image(const struct svm_model_image *image);
+
 int print_model(const char *model_file_name, struct svm_model *model);
 
 #define svm_destroy_model(A)    svm_free_model_content((A))
@@ -0,0 +1,180 @@
+/*********************************************************************
+ *                                                                   *
+ *                           window_check.c                          *
+ *                                                                   *
+ *	window_check [seed]                                          *
+ *                                                                   *
+ *	Cuts random windows out of random alignments with gaps,      *
+ *	masked stretches and N, filtered by windowSpans() with       *
+ *	random filters. window_values_create() must give the same    *
+ *	identity, entropies, consensus sequences and compositions    *
+ *	as score_job() computes from the window itself, in both      *
+ *	reading directions, and the rows must start where the        *
+ *	letters before the window say. Run by "make check".          *
+ *                                                                   *
+ *********************************************************************/
+
+#include "config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "utils.h"
+#include "rnaz_utils.h"
+#include "zscore.h"
+#include "window_stats.h"
+
+#define PRIVATE static
+#define ALIGNMENTS 300
+#define WINDOWS 40      /* per alignment */
+
+/* Rows of one random sequence with mutations, gaps, masked stretches
+   and the odd N; now and then one has a letter block_stats_create()
+   does not take */
+PRIVATE struct aln **random_alignment(int n_seq, int length){
+
+  static const char bases[]="ACGTU";
+  struct aln **AS;
+  char *ref, *seq, name[32];
+  double gaps=urn()*0.4, masked=urn()*0.2;
+  int i, k, lower;
+
+  AS=(struct aln **)space(sizeof(struct aln *)*(n_seq+1));
+  ref=(char *)space(length+1);
+  for (k=0;k<length;k++) ref[k]=bases[int_urn(0,3)];
+
+  for (i=0;i<n_seq;i++){
+	seq=(char *)space(length+1);
+	lower=0;
+	for (k=0;k<length;k++){
+	  if (urn()<0.02) lower=!lower;
+	  if (urn()<gaps) seq[k]=(urn()<0.1) ? '.' : '-';
+	  else if (urn()<0.01) seq[k]='N';
+	  else if (urn()<0.2) seq[k]=bases[int_urn(0,4)];
+	  else seq[k]=ref[k];
+	  if (lower && urn()<masked*5) seq[k]=tolower(seq[k]);
+	}
+	if (urn()<0.05/n_seq) seq[int_urn(0,length-1)]='X';
+	sprintf(name,"seq%d",i);
+	AS[i]=createAlnEntry(strdup(name),seq,int_urn(1,1000),length,
+						 100000,(urn()<0.5) ? '+' : '?');
+  }
+  AS[n_seq]=NULL;
+  free(ref);
+  return AS;
+}
+
+/* Goes over window the way score_job() does without the counts and
+   returns the name of the first value that differs, or NULL */
+PRIVATE const char *window_differs(struct aln *window[], int n_seq,
+								   const struct window_values *values){
+
+  struct aln_columns *cols;
+  struct composition comp, expected;
+  char *ungapped, *string;
+  const char *differs=NULL;
+  int i, j, direction;
+
+  for (i=0;i<n_seq;i++){
+	for (j=0;window[i]->seq[j];j++){
+	  window[i]->seq[j]=toupper(window[i]->seq[j]);
+	  if (window[i]->seq[j]=='U') window[i]->seq[j]='T';
+	}
+  }
+
+  for (direction=0;direction<2 && differs==NULL;direction++){
+	if (direction==1) revAln(window);
+
+	cols=alnColumns((const struct aln **)window);
+	string=consensusColumns(cols);
+	if (strcmp(string,values->consensus[direction])!=0) differs="consensus";
+	else if (direction==0 && meanPairIDColumns(cols)!=values->id) differs="identity";
+	else if (NormShannonEntropyColumns(cols)!=values->entropy[direction]) differs="entropy";
+	free(string);
+	freeAlnColumns(cols);
+
+	for (i=0;i<n_seq && differs==NULL;i++){
+	  ungapped=(char *)space(strlen(window[i]->seq)+1);
+	  sequence_composition(window[i]->seq,window[i]->seq,ungapped,&comp);
+	  free(ungapped);
+	  if (direction==0) expected=values->comps[i];
+	  else reverse_composition(&values->comps[i],&expected);
+	  if (memcmp(&comp,&expected,sizeof(comp))!=0) differs="composition";
+	}
+  }
+  return differs;
+}
+
+int main(int argc, char *argv[]){
+
+  struct aln_span spans[MAX_NUM_NAMES];
+  struct aln *window[MAX_NUM_NAMES];
+  struct aln **AS;
+  struct block_stats *stats;
+  struct window_values *values;
+  struct window_filter filter;
+  struct span_offsets offsets;
+  const char *differs;
+  int rows[MAX_NUM_NAMES];
+  int a, w, i, k, n_seq, length, from, to, n, before, windows=0;
+
+  if (argc>1){
+	xsubi[0]=xsubi[1]=xsubi[2]=(unsigned short)strtoul(argv[1],NULL,10);
+  } else xsubi[0]=xsubi[1]=xsubi[2]=4711;
+
+  /* RNAz needs two sequences, so does windowSpans() here */
+  filter.minLength=0;
+  filter.minSeqs=2;
+  filter.minID=0;
+  filter.maxID=100;
+  filter.rangeCheck=0;
+
+  for (a=0;a<ALIGNMENTS;a++){
+	n_seq=int_urn(2,12);
+	length=int_urn(1,400);
+	AS=random_alignment(n_seq,length);
+	alnSpans((const struct aln **)AS,spans);
+
+	/* NULL for alignments RNAz scores without the counts */
+	stats=block_stats_create(spans,n_seq);
+	memset(&offsets,0,sizeof(offsets));
+
+	for (w=0;stats!=NULL && w<WINDOWS;w++){
+	  from=int_urn(1,length);
+	  to=int_urn(from,length);
+	  filter.maxGap=0.3+urn()*0.7;
+	  filter.maxMasked=0.5+urn()*0.5;
+	  filter.maxSeqs=int_urn(2,n_seq);
+	  filter.optID=int_urn(50,100);
+	  filter.reference=(urn()<0.5);
+
+	  n=windowSpans(spans,n_seq,window,rows,from,to,&filter,&offsets);
+	  if (n==0) continue;
+	  values=window_values_create(stats,rows,n,from,to);
+	  differs=window_differs(window,n,values);
+	  for (i=0;i<n && differs==NULL;i++){
+		for (before=k=0;k<from-1;k++){
+		  before+=(spans[rows[i]].seq[k]!='-' && spans[rows[i]].seq[k]!='.');
+		}
+		if (window[i]->strand!='?' && window[i]->start!=spans[rows[i]].start+before){
+		  differs="start";
+		}
+	  }
+	  if (differs!=NULL){
+		fprintf(stderr,"%s differs in columns %d-%d of alignment %d\n",
+				differs,from,to,a);
+		return 1;
+	  }
+	  window_values_free(values);
+	  freeAln(window);
+	  windows++;
+	}
+
+	block_stats_free(stats);
+	freeAln(AS);
+	free(AS);
+  }
+
+  printf("%d windows, all the same as computed directly\n",windows);
+  return 0;
+}
@@ -0,0 +1,315 @@
+/*********************************************************************
+ *                                                                   *
+ *                              window_stats.c                       *
+ *                                                                   *
+ *	Statistics of overlapping windows of one alignment from      *
+ *	per-column counts and prefix sums computed once.             *
+ *                                                                   *
+ *	With the default 120 column windows slid by 40 columns each  *
+ *	column is in three windows. Instead of going over the        *
+ *	sequences of every window again, the letters of each column  *
+ *	are counted once per alignment, together with prefix sums of *
+ *	the identical and compared pairs per column and of the bases *
+ *	and dinucleotides of each sequence. Sums of doubles are      *
+ *	added up in the same order as in rnaz_utils.c and zscore.c,  *
+ *	so the values are the same as if they were computed for the  *
+ *	window itself.                                               *
+ *                                                                   *
+ *********************************************************************/
+
+#include "config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include "utils.h"
+#include "rnaz_utils.h"
+#include "zscore.h"
+#include "window_stats.h"
+
+#define PRIVATE static
+
+/* Letters of a column; T and U are the same, only N is allowed besides
+   the four bases */
+enum {SYM_GAP=0, SYM_A, SYM_C, SYM_G, SYM_U, SYM_N, NSYM};
+
+/* Upper limit of sequences times columns, about 100 bytes each */
+#define MAX_CELLS (1<<20)
+
+struct block_stats {
+  int n_seq;
+  int length;
+  unsigned char *sym;   /* sym[i*length+k] is column k of sequence i */
+  int *hist;            /* hist[k*NSYM+s], letters s in column k */
+  long *matches;        /* identical pairs in columns before k */
+  long *pairs;          /* compared pairs (not both gaps) before k */
+  int *bases;           /* bases[(i*(length+1)+k)*5+b]: A, C, G, U, N of
+                           sequence i before column k */
+  int *di;              /* di[(i*(length+1)+k)*16+d]: dinucleotides of
+                           sequence i ending before column k */
+};
+
+PRIVATE int letter_symbol(char c){
+
+  switch (toupper((unsigned char)c)){
+  case '-': case '.': return SYM_GAP;
+  case 'A': return SYM_A;
+  case 'C': return SYM_C;
+  case 'G': return SYM_G;
+  case 'T': case 'U': return SYM_U;
+  case 'N': return SYM_N;
+  }
+  return -1;
+}
+
+
+struct block_stats *block_stats_create(const struct aln_span spans[], int n_seq){
+
+  struct block_stats *stats;
+  const int *h;
+  int *b, *d;
+  int i, k, s, prev, length, m, p;
+
+  length=spans[0].seqLength;
+  if ((double)n_seq*(length+1)>MAX_CELLS) return NULL;
+
+  stats=(struct block_stats *)space(sizeof(struct block_stats));
+  stats->n_seq=n_seq;
+  stats->length=length;
+  stats->sym=(unsigned char *)space((size_t)n_seq*length+1);
+  stats->hist=(int *)space(sizeof(int)*((size_t)length*NSYM+1));
+
+  for (i=0;i<n_seq;i++){
+    for (k=0;k<length;k++){
+      if ((s=letter_symbol(spans[i].seq[k]))<0){
+        block_stats_free(stats);
+        return NULL;
+      }
+      stats->sym[(size_t)i*length+k]=(unsigned char)s;
+      stats->hist[k*NSYM+s]++;
+    }
+  }
+
+  stats->matches=(long *)space(sizeof(long)*(length+1));
+  stats->pairs=(long *)space(sizeof(long)*(length+1));
+  for (k=0;k<length;k++){
+    h=stats->hist+k*NSYM;
+    m=0;
+    for (s=SYM_A;s<NSYM;s++) m+=h[s]*(h[s]-1)/2;
+    p=n_seq*(n_seq-1)/2-h[SYM_GAP]*(h[SYM_GAP]-1)/2;
+    stats->matches[k+1]=stats->matches[k]+m;
+    stats->pairs[k+1]=stats->pairs[k]+p;
+  }
+
+  stats->bases=(int *)space(sizeof(int)*(size_t)n_seq*(length+1)*5);
+  stats->di=(int *)space(sizeof(int)*(size_t)n_seq*(length+1)*16);
+  for (i=0;i<n_seq;i++){
+    b=stats->bases+(size_t)i*(length+1)*5;
+    d=stats->di+(size_t)i*(length+1)*16;
+    prev=SYM_N;
+    for (k=0;k<length;k++,b+=5,d+=16){
+      memcpy(b+5,b,sizeof(int)*5);
+      memcpy(d+16,d,sizeof(int)*16);
+      s=stats->sym[(size_t)i*length+k];
+      if (s==SYM_GAP) continue;
+      b[5+s-1]++;
+      /* an N in between is not skipped, as in sequence_composition() */
+      if (s!=SYM_N && prev!=SYM_N) d[16+4*(prev-1)+s-1]++;
+      prev=s;
+    }
+  }
+
+  return stats;
+}
+
+void block_stats_free(struct block_stats *stats){
+
+  if (stats==NULL) return;
+  free(stats->sym);
+  free(stats->hist);
+  free(stats->matches);
+  free(stats->pairs);
+  free(stats->bases);
+  free(stats->di);
+  free(stats);
+}
+
+/* Letter counts of the columns from..to-1 (0-based) of the sequences
+   in rows[] only */
+
+PRIVATE int *window_hist(const struct block_stats *stats,
+                         const int rows[], int n_rows, int from, int to){
+
+  int *hist;
+  const unsigned char *sym;
+  int i, j, k;
+
+  hist=(int *)space(sizeof(int)*((size_t)(to-from)*NSYM+1));
+
+  if (2*n_rows>=stats->n_seq){
+    /* all columns, then take out the sequences that are not used */
+    memcpy(hist,stats->hist+from*NSYM,sizeof(int)*(size_t)(to-from)*NSYM);
+    for (i=j=0;i<stats->n_seq;i++){
+      if (j<n_rows && rows[j]==i){
+        j++;
+        continue;
+      }
+      sym=stats->sym+(size_t)i*stats->length;
+      for (k=from;k<to;k++) hist[(k-from)*NSYM+sym[k]]--;
+    }
+  } else {
+    for (j=0;j<n_rows;j++){
+      sym=stats->sym+(size_t)rows[j]*stats->length;
+      for (k=from;k<to;k++) hist[(k-from)*NSYM+sym[k]]++;
+    }
+  }
+  return hist;
+}
+
+/* Counts of one sequence in the columns from..to-1 */
+
+PRIVATE void window_composition(const struct block_stats *stats, int row,
+                                int from, int to, int columns,
+                                struct composition *comp){
+
+  const unsigned char *sym=stats->sym+(size_t)row*stats->length;
+  const int *b0, *b1, *d0, *d1;
+  int i, k, p, q, counts[5];
+
+  b0=stats->bases+((size_t)row*(stats->length+1)+from)*5;
+  b1=stats->bases+((size_t)row*(stats->length+1)+to)*5;
+  d0=stats->di+((size_t)row*(stats->length+1)+from)*16;
+  d1=stats->di+((size_t)row*(stats->length+1)+to)*16;
+
+  comp->length=0;
+  for (i=0;i<5;i++){
+    counts[i]=b1[i]-b0[i];
+    comp->length+=counts[i];
+  }
+  comp->gaps=columns-comp->length;
+  comp->bases[0]=counts[0];
+  comp->bases[1]=counts[1];
+  comp->bases[2]=counts[2];
+  comp->bases[3]=0;
+  comp->bases[4]=counts[3];
+  comp->bases[5]=counts[4];
+
+  for (i=0;i<16;i++) comp->di[i]=d1[i]-d0[i];
+
+  /* The first base of the window was counted with the one before it */
+  for (q=from;q<to && sym[q]==SYM_GAP;q++);
+  if (q==to || sym[q]==SYM_N) return;
+  for (p=from-1;p>=0 && sym[p]==SYM_GAP;p--);
+  if (p<0 || sym[p]==SYM_N) return;
+  k=4*(sym[p]-1)+sym[q]-1;
+  comp->di[k]--;
+}
+
+
+struct window_values *window_values_create(const struct block_stats *stats,
+                                           const int rows[], int n_rows,
+                                           int from, int to){
+
+  struct window_values *values;
+  double term[MAX_NUM_NAMES+1], tmp, entropy;
+  long matches, pairs;
+  int *hist, *h;
+  int freq[5], order[2][5] = {{0,1,2,3,4},{0,4,3,2,1}};
+  int d, i, j, k, s, c, fm, columns, width;
+
+  from--;
+  width=to-from;
+  hist=window_hist(stats,rows,n_rows,from,to);
+
+  values=(struct window_values *)space(sizeof(struct window_values));
+
+  /* Columns with gaps only are not part of the window */
+  columns=0;
+  for (k=0;k<width;k++){
+    if (hist[k*NSYM+SYM_GAP]<n_rows) columns++;
+  }
+
+  /* meanPairID() */
+  if (n_rows==stats->n_seq){
+    matches=stats->matches[to]-stats->matches[from];
+    pairs=stats->pairs[to]-stats->pairs[from];
+  } else {
+    matches=pairs=0;
+    for (k=0;k<width;k++){
+      h=hist+k*NSYM;
+      for (s=SYM_A;s<NSYM;s++) matches+=h[s]*(h[s]-1)/2;
+      pairs+=n_rows*(n_rows-1)/2-h[SYM_GAP]*(h[SYM_GAP]-1)/2;
+    }
+  }
+  values->id=(double)(matches)/pairs*100;
+
+  /* NormShannonEntropy() and consensus(); the reverse complement goes
+     over the columns backwards, with A and U, C and G swapped. freq[]
+     is in the order of Law_and_Order, gaps and N are '_'. */
+  for (i=1;i<=n_rows;i++){
+    tmp=(double) i/n_rows;
+    term[i]=tmp * (log(tmp)/log(2.0));
+  }
+  for (d=0;d<2;d++){
+    values->consensus[d]=(char *)space(columns+1);
+    entropy=0.0;
+    for (i=j=0;i<width;i++){
+      k=(d==0) ? i : width-1-i;
+      h=hist+k*NSYM;
+      if (h[SYM_GAP]==n_rows) continue;
+
+      freq[0]=h[SYM_GAP]+h[SYM_N];
+      for (s=1;s<5;s++) freq[order[d][s]]=h[s];
+
+      for (s=1;s<5;s++){
+        if (freq[s]>0) entropy+=term[freq[s]];
+      }
+      if (freq[0]>0) entropy+=term[freq[0]];
+
+      for (s=c=fm=0;s<5;s++){
+        if (freq[s]>fm) {c=s; fm=freq[s];}
+      }
+      values->consensus[d][j++]="_ACGU"[c];
+    }
+    values->entropy[d]=(-1.0) * entropy/columns;
+  }
+
+  values->comps=(struct composition *)space(sizeof(struct composition)*n_rows);
+  for (i=0;i<n_rows;i++){
+    window_composition(stats,rows[i],from,to,columns,&values->comps[i]);
+  }
+
+  free(hist);
+  return values;
+}
+
+void window_values_free(struct window_values *values){
+
+  if (values==NULL) return;
+  free(values->consensus[0]);
+  free(values->consensus[1]);
+  free(values->comps);
+  free(values);
+}
+
+void reverse_composition(const struct composition *comp,
+                         struct composition *rev){
+  int x, y;
+
+  /* revAln() turns T and U into A */
+  rev->length=comp->length;
+  rev->gaps=comp->gaps;
+  rev->bases[0]=comp->bases[3]+comp->bases[4];
+  rev->bases[1]=comp->bases[2];
+  rev->bases[2]=comp->bases[1];
+  rev->bases[3]=0;
+  rev->bases[4]=comp->bases[0];
+  rev->bases[5]=comp->bases[5];
+
+  for (x=0;x<4;x++){
+    for (y=0;y<4;y++){
+      rev->di[4*(3-y)+(3-x)]=comp->di[4*x+y];
+    }
+  }
+}
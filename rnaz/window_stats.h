@@ -0,0 +1,48 @@
+/*********************************************************************
+ *                                                                   *
+ *                              window_stats.h                       *
+ *                                                                   *
+ *	Statistics of overlapping windows of one alignment from      *
+ *	per-column counts and prefix sums computed once.             *
+ *                                                                   *
+ *********************************************************************/
+
+#ifndef WINDOW_STATS_H
+#define WINDOW_STATS_H
+
+struct aln_span;
+struct composition;
+
+struct block_stats;
+
+/* What score_job() would compute itself for a window; the reverse
+   complement is the second entry */
+struct window_values {
+  double id;                   /* meanPairID() */
+  double entropy[2];           /* NormShannonEntropy() */
+  char *consensus[2];          /* consensus() */
+  struct composition *comps;   /* sequence_composition() of each
+                                  sequence, forward direction */
+};
+
+/* Counts for the n_seq sequences of an alignment. Returns NULL if the
+   alignment has letters other than ACGTUN (in any case) and gaps, or is
+   too large; its windows then have to be computed directly. */
+struct block_stats *block_stats_create(const struct aln_span spans[], int n_seq);
+
+void block_stats_free(struct block_stats *stats);
+
+/* Values of the window from, to (first column is 1) with the sequences
+   rows[0..n_rows-1] (ascending) and without the columns that are gaps
+   in all of them, i.e. of the alignment windowSpans() gives */
+struct window_values *window_values_create(const struct block_stats *stats,
+                                           const int rows[], int n_rows,
+                                           int from, int to);
+
+void window_values_free(struct window_values *values);
+
+/* Composition of the reverse complement of a sequence */
+void reverse_composition(const struct composition *comp,
+                         struct composition *rev);
+
+#endif
@@ -16,103 +16,199 @@
 #include <math.h>
 #include <ctype.h>
 #include <string.h>
-#include <time.h>
 #include "utils.h"
 #include "fold.h"
 #include "svm.h"
 #include "svm_helper.h"
+#include "svm_dense.h"
 #include "zscore.h"
 #include "fold_vars.h"
 
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
+
 #define IN_RANGE(LOWER,VALUE,UPPER) ((VALUE <= UPPER) && (VALUE >= LOWER))
 
 struct svm_model *avg_model, *stdv_model;
-struct svm_model *GC20_30_avg, *GC30_36_avg, *GC36_40_avg, 
-  *GC40_46_avg, *GC46_50_avg, *GC50_56_avg, *GC56_60_avg,
-  *GC60_66_avg, *GC66_70_avg, *GC70_80_avg;
-struct svm_model *GC20_30_stdv, *GC30_36_stdv, *GC36_40_stdv, 
-  *GC40_46_stdv, *GC46_50_stdv, *GC50_56_stdv, *GC56_60_stdv,
-  *GC60_66_stdv, *GC66_70_stdv, *GC70_80_stdv;
+/* Dinucleotide regression models, one pair per G+C bin */
+#define GC_BINS 10
+struct svm_dense_pair *GC_models[GC_BINS];
+
+#ifdef HAVE_PTHREAD
+static pthread_mutex_t regression_models_lock = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+/* Loads the regression models of one G+C bin the first time they are
+   needed. The models are shared read-only by all scoring threads, so
+   only loading them has to be serialized. */
+
+static void load_regression_models(struct svm_dense_pair** pair, int type){
+#ifdef HAVE_PTHREAD
+  pthread_mutex_lock(&regression_models_lock);
+#endif
+  if (*pair == NULL) {
+    *pair = get_regression_pair(type);
+  }
+#ifdef HAVE_PTHREAD
+  pthread_mutex_unlock(&regression_models_lock);
+#endif
+}
+
+
+/* Codes of the characters for sequence_composition(): 0 for anything
+   but a base or a gap */
 
+#define CODE_T   4
+#define CODE_U   5
+#define CODE_GAP 6
 
-/* Calculates the base frequencies for both mononucleotides and 
-   dinucleotides */
+static const unsigned char base_codes[256] = {
+  ['A'] = 1, ['C'] = 2, ['G'] = 3, ['T'] = CODE_T, ['U'] = CODE_U,
+  ['-'] = CODE_GAP
+};
 
-void base_frequencies(const char *array, unsigned int n, double *mono, double *di)
+/* Counts the bases and dinucleotides of seq in one pass. Gaps ('-')
+   are skipped, dinucleotides are counted in the sequence without
+   gaps. If rna is not NULL, seq is copied to it with T replaced by U
+   (rna may be seq itself) and the counts are the ones of the copy. If
+   ungapped is not NULL, the sequence without gaps is written there.
+   With comp NULL only the copies are made. */
+
+void sequence_composition(const char *seq, char *rna, char *ungapped,
+			  struct composition *comp)
 {
-  unsigned int i;
-  char dinuc[3];
-  dinuc[2] = '\0';
-  
-  for (i = 0; i < n ; i++)
-  {
-    switch( array[i] )
-    {
-    case 'A' : mono[0]++;break;
-    case 'C' : mono[1]++;break;
-    case 'G' : mono[2]++;break;
-    case 'T' : mono[3]++;break;
-    case 'U' : mono[3]++;break; 
-    default  : mono[4]++;break;
-    }
-    dinuc[0] = array[i];
-    dinuc[1] = array[i+1];
-    
-    
-    if (strcmp(dinuc,"AA")==0) di[0]++;
-    if (strcmp(dinuc,"AC")==0) di[1]++;
-    if (strcmp(dinuc,"AG")==0) di[2]++;
-    if (strcmp(dinuc,"AT")==0) di[3]++;
-    if (strcmp(dinuc,"AU")==0) di[3]++;
-    if (strcmp(dinuc,"CA")==0) di[4]++;
-    if (strcmp(dinuc,"CC")==0) di[5]++;
-    if (strcmp(dinuc,"CG")==0) di[6]++;
-    if (strcmp(dinuc,"CT")==0) di[7]++;
-    if (strcmp(dinuc,"CU")==0) di[7]++;
-    if (strcmp(dinuc,"GA")==0) di[8]++;
-    if (strcmp(dinuc,"GC")==0) di[9]++;
-    if (strcmp(dinuc,"GG")==0) di[10]++;
-    if (strcmp(dinuc,"GT")==0) di[11]++;
-    if (strcmp(dinuc,"GU")==0) di[11]++;
-    if (strcmp(dinuc,"TA")==0) di[12]++;
-    if (strcmp(dinuc,"TC")==0) di[13]++;
-    if (strcmp(dinuc,"TG")==0) di[14]++;
-    if (strcmp(dinuc,"TT")==0) di[15]++;
-    if (strcmp(dinuc,"UA")==0) di[12]++;
-    if (strcmp(dinuc,"UC")==0) di[13]++;
-    if (strcmp(dinuc,"UG")==0) di[14]++;
-    if (strcmp(dinuc,"UU")==0) di[15]++;
-  }
-
-  /* the last one */
-  switch( array[n] )
-  {
-    case 'A' : mono[0]++;break;
-    case 'C' : mono[1]++;break;
-    case 'G' : mono[2]++;break;
-    case 'T' : mono[3]++;break;
-    case 'U' : mono[3]++;break; 
-    default  : mono[4]++;break;
+  int counts[6], pairs[7][6];
+  int prev, code, i, j, n;
+  char ch;
+
+  /* only the copies, the counts are known already */
+  if (comp == NULL) {
+    for (i = n = 0; seq[i]; i++) {
+      ch = seq[i];
+      if (rna != NULL) {
+        if (ch == 'T') ch = 'U';
+        rna[i] = ch;
+      }
+      if (ungapped != NULL && base_codes[(unsigned char) ch] != CODE_GAP)
+        ungapped[n++] = ch;
+    }
+    if (ungapped != NULL) ungapped[n] = '\0';
+    return;
   }
-  
-  for (i = 0; i < 5 ; i++)
-  {
-    mono[i] = (double) mono[i]/n;
+
+  memset(counts, 0, sizeof(counts));
+  memset(pairs, 0, sizeof(pairs));
+
+  /* row 6 of pairs counts nothing, it is the "previous" base of the
+     first one */
+  prev = 6;
+  n = 0;
+  for (i = 0; seq[i]; i++) {
+    ch = seq[i];
+    if (rna != NULL) {
+      if (ch == 'T') ch = 'U';
+      rna[i] = ch;
+    }
+    code = base_codes[(unsigned char) ch];
+    if (code == CODE_GAP) continue;
+    if (ungapped != NULL) ungapped[n] = ch;
+    n++;
+    counts[code]++;
+    pairs[prev][code]++;
+    prev = code;
+  }
+  if (ungapped != NULL) ungapped[n] = '\0';
+
+  comp->length = n;
+  comp->gaps = i-n;
+  for (j = 0; j < 5; j++) comp->bases[j] = counts[j+1];
+  comp->bases[5] = counts[0];
+
+  /* T and U are the same base, but TU and UT were never counted */
+  memset(comp->di, 0, sizeof(comp->di));
+  for (i = 1; i < 6; i++) {
+    for (j = 1; j < 6; j++) {
+      if ((i == CODE_T && j == CODE_U) || (i == CODE_U && j == CODE_T)) continue;
+      comp->di[4*((i == CODE_U) ? 3 : i-1) + ((j == CODE_U) ? 3 : j-1)] += pairs[i][j];
+    }
   }
+}
 
-  for (i = 0; i < 16 ; i++)
-  {
-    char tmp[10];
-    sprintf(tmp, "%.3f", (double) di[i]/(n-1));
-    di[i] = (double) atof(tmp);
+/* The double atof() gives for the string sprintf("%.<digits>f", v),
+   without going through a string: v is rounded to the nearest
+   multiple of 10^-digits, ties to even, exactly as printf rounds the
+   binary value of v. digits is at most 8. */
+
+double round_decimals(double v, int digits)
+{
+  static const double scale[9] = {1, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8};
+  double s = scale[digits];
+  double a, t, err, f, frac;
+
+  if (!isfinite(v)) return v;
+
+  a = fabs(v);
+  t = a * s;
+  /* a*s is exactly t+err */
+  err = fma(a, s, -t);
+  f = floor(t);
+  frac = t - f;
+  if (frac > 0.5 ||
+      (frac == 0.5 && (err > 0 || (err == 0 && fmod(f, 2.0) != 0)))) {
+    f += 1;
   }
 
+  /* f/s is the double nearest to the decimal, like atof() */
+  return copysign(f / s, v);
+}
+
+/* Random numbers for the shuffles: xoshiro256** (Blackman & Vigna),
+   one state per stream, so no stream is shared between threads */
+
+typedef struct {
+  unsigned long long s[4];
+} shuffle_rng;
+
+static unsigned long long splitmix64(unsigned long long *x)
+{
+  unsigned long long z = (*x += 0x9e3779b97f4a7c15ULL);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+static void shuffle_rng_seed(shuffle_rng *rng, unsigned long long seed)
+{
+  int i;
+  for (i = 0; i < 4; i++) rng->s[i] = splitmix64(&seed);
+}
+
+#define ROTL64(x,k) (((x) << (k)) | ((x) >> (64 - (k))))
+
+/* Uniform random number in [0,1) */
+
+static double shuffle_urn(shuffle_rng *rng)
+{
+  unsigned long long *s = rng->s;
+  unsigned long long result = ROTL64(s[1] * 5, 7) * 9;
+  unsigned long long t = s[1] << 17;
+
+  s[2] ^= s[0];
+  s[3] ^= s[1];
+  s[1] ^= s[2];
+  s[0] ^= s[3];
+  s[2] ^= t;
+  s[3] = ROTL64(s[3], 45);
+
+  return (double) (result >> 11) * (1.0 / 9007199254740992.0);
 }
 
 /* Uses a Fisher-Yates shuffle to generate a mononucleotide
-   shuffled sequence. */
+   shuffled sequence of array in work_array. */
 
-void fisher_yates_shuffle(char *array, size_t n, char *work_array)
+void fisher_yates_shuffle(const char *array, size_t n, char *work_array,
+			  shuffle_rng *rng)
 {
   size_t k;
   for (k = 0; k < n ; k++) {
@@ -122,252 +218,523 @@ void fisher_yates_shuffle(char *array, size_t n, char *work_array)
   if (n > 1) {
     size_t i;
     for (i = 0; i < n - 1; i++) {
-      size_t j = i + rand() / (RAND_MAX / (n - i) + 1);
-      int t = array[j];
-      array[j] = array[i];
-      array[i] = t;
+      size_t j = i + (size_t) (shuffle_urn(rng) * (n - i));
+      int t = work_array[j];
+      work_array[j] = work_array[i];
+      work_array[i] = t;
     }
   }
 }
 
-/* Uses a Altschul-Erickson shuffle to generate a
-   dinucleotide shuffled sequence. */
-void altschul_erickson_shuffle(char *array, size_t n, char *work_array)
+/* Altschul-Erickson dinucleotide shuffles of one sequence.
+
+   The edge lists of the doublet graph of the sequence are built once
+   and kept in flat arrays, the edge list of base i at start[i]. Every
+   shuffle permutes a copy of them in the same arena, so no memory is
+   allocated per shuffle. Bases are coded A=0, C=1, G=2, T/U=3, other=4. */
+
+struct dinuc_shuffler {
+  size_t length;        /* of the sequence */
+  size_t size;          /* edges the arena has room for */
+  int s_1, s_f;         /* first and last base */
+  int n_E[5];           /* number of edges leaving base i */
+  size_t start[5];
+  char *edges;          /* edge lists of the sequence, in sequence order */
+  char *work;           /* the edge lists being permuted */
+};
+
+static int base_code(char c)
 {
-  int **E_s;
-  int **Z;
-  int *n_E;
-  int *i_E;
-  size_t i,j;
-  int pre;
-  int eulerian_flag = 0;
-  int s_1;
-  int s_f;
-
-  /* transform string array to numbers and initialize some arrays*/
-  for (i = 0; i < n ; i++)
-  {
-    switch( array[i] )
-    {
-    case 'A' : work_array[i] = 0;break;
-    case 'C' : work_array[i] = 1;break;
-    case 'G' : work_array[i] = 2;break;
-    case 'T' : work_array[i] = 3;break;
-    case 'U' : work_array[i] = 3;break; 
-    default  : work_array[i] = 4;break;
-    }
+  switch (c) {
+  case 'A' : return 0;
+  case 'C' : return 1;
+  case 'G' : return 2;
+  case 'T' : return 3;
+  case 'U' : return 3;
+  default  : return 4;
   }
-  s_1 = work_array[0];
-  s_f = work_array[n-1];
+}
 
-  Z  = (int **) space(sizeof(int *) * 5);
-  for (i = 0; i < 5; i++)
-  {
-    Z[i]  = (int *) space(sizeof(int) * 5);
+/* A shuffler with room for sequences of up to length bases */
+
+struct dinuc_shuffler *dinuc_shuffler_create(size_t length)
+{
+  struct dinuc_shuffler *sh;
+
+  sh = (struct dinuc_shuffler *) space(sizeof(struct dinuc_shuffler));
+  sh->size = (length > 1) ? length-1 : 1;
+  sh->edges = (char *) space(sh->size);
+  sh->work = (char *) space(sh->size);
+  return sh;
+}
+
+void dinuc_shuffler_free(struct dinuc_shuffler *sh)
+{
+  if (sh == NULL) return;
+  free(sh->edges);
+  free(sh->work);
+  free(sh);
+}
+
+/* (1) Construct the doublet graph G and the edge ordering E
+   corresponding to the sequence array[0..n-1]. The arena grows if the
+   sequence is longer than any before. */
+
+void dinuc_shuffler_set(struct dinuc_shuffler *sh, const char *array, size_t n)
+{
+  size_t i, fill[5];
+  int pre, b;
+
+  if (n-1 > sh->size) {
+    sh->size = n-1;
+    sh->edges = (char *) xrealloc(sh->edges, sh->size);
+    sh->work = (char *) xrealloc(sh->work, sh->size);
   }
-  
+  sh->length = n;
+
+  for (b = 0; b < 5; b++) sh->n_E[b] = 0;
+  for (i = 0; i+1 < n; i++) sh->n_E[base_code(array[i])]++;
+  sh->start[0] = 0;
+  for (b = 1; b < 5; b++) sh->start[b] = sh->start[b-1] + sh->n_E[b-1];
+
+  for (b = 0; b < 5; b++) fill[b] = sh->start[b];
+  pre = base_code(array[0]);
+  for (i = 1; i < n; i++) {
+    b = base_code(array[i]);
+    sh->edges[fill[pre]++] = (char) b;
+    pre = b;
+  }
+  sh->s_1 = base_code(array[0]);
+  sh->s_f = pre;
+}
 
-  /* (1) Construct the doublet graph G and the edge ordering E corresponding to S.*/
-  E_s  = (int **) space(sizeof(int *) * 5);
-  n_E = (int *) space(sizeof(int)    * 5);
-  i_E = (int *) space(sizeof(int)    * 5);
-  for (i = 0; i < 5; i++)
-  {
-    E_s[i]  = (int *) space(sizeof(int) * (n-1));
-    n_E[i] = 0;
-    i_E[i] = 0;
+/* Uses a Altschul-Erickson shuffle to generate a dinucleotide
+   shuffled sequence of the shuffler's sequence in work_array. */
+
+void altschul_erickson_shuffle(struct dinuc_shuffler *sh, char *work_array,
+			       shuffle_rng *rng)
+{
+  static const char letter[5] = {'A', 'C', 'G', 'U', 'N'};
+  char *E_s[5];
+  int *n_E = sh->n_E;
+  int i_E[5];
+  unsigned int Z[5], reach;
+  int s_f = sh->s_f;
+  int i, j, max, seen;
+  size_t k;
+
+  if (sh->length < 2) {
+    if (sh->length == 1) work_array[0] = letter[s_f];
+    return;
   }
-  
 
-  pre = (int) work_array[0];
-  for (i = 1; i < n; i++)
-  {
-    E_s[pre][n_E[pre]] = (int) work_array[i];
-    n_E[pre]++;
-    pre = (int) work_array[i];
+  memcpy(sh->work, sh->edges, sh->length-1);
+  for (i = 0; i < 5; i++) {
+    E_s[i] = sh->work + sh->start[i];
+    i_E[i] = 0;
   }
-  /* printf("A:%d, C:%d, G:%d, T:%d, N:%d\n",n_E[0],n_E[1],n_E[2],n_E[3],n_E[4]);*/
 
-  while (eulerian_flag == 0)
+  while (1)
   {
     /* (2) For each vertex s in G except s_f, randomly select one edge from the s
        edge list of E(S) to be the last edge of the s list in a new edge ordering.*/
     for (i = 0; i < 5; i++)
     {
       int rand_index;
-      int swap;
-      /*printf("i:%d, #:%d\n",i,n_E[i]);*/
+      char swap;
       if (n_E[i] == 0 || i == s_f) continue;
-      rand_index = (int)(rand() / (((double)RAND_MAX + 1)/ n_E[i]));
+      rand_index = (int)(shuffle_urn(rng) * n_E[i]);
       /*swap*/
       swap = E_s[i][n_E[i]-1];
       E_s[i][n_E[i]-1] = E_s[i][rand_index];
       E_s[i][rand_index] = swap;
     }
-    
 
     /* (3) From this set of last edges, construct the last-edge graph Z and
-       determine wheter or not all of its vertices are connected to s_f.*/
-
-    /*set everything to zero in Z*/
-    for (i = 0; i < 5; i++)
-    {
-      for (j = 0; j < 5; j++)
-      {
-	Z[i][j] = 0;
-      }
-    }
-    
-
-    int max = 0;
+       determine wheter or not all of its vertices are connected to s_f.
+       Row i of Z is a bit mask of the successors of i. */
+    max = 0;
     for (i = 0; i < 5; i++)
     {
+      Z[i] = 0;
       if (n_E[i] > 0)
       {
-	Z[i][E_s[i][n_E[i]-1]] = 1;
+	Z[i] = 1u << E_s[i][n_E[i]-1];
 	max++;
       }
     }
-    
-    
     if (n_E[s_f] == 0)
     {
-      Z[s_f][s_f] = 1;
+      Z[s_f] = 1u << s_f;
       max++;
     }
 
-    int seen = 0;
-    for (i = 0; i < 5; i++)
+    /* vertices with a path to s_f; no path is longer than 5 edges */
+    reach = 0;
+    for (j = 0; j < 5; j++)
     {
-      int node = i;
-      int dummy;
-      for (dummy = 0; dummy < max; dummy++)
+      for (i = 0; i < 5; i++)
       {
-	int connected = -1;
-	for (j = 0; j < 5; j++)
-	{
-	  if (Z[node][j] == 1) connected = j;
-	}
-	
-	/*node is not connected to any other node, we can stop*/
-	if (connected == -1)
-	{
-	  break;
-	}
-	/*is it s_f?*/
-	if (connected == s_f)
-	{
-	  seen++;
-	  break;
-	}
-	/*now search for the connecred node if it is connected to s_f*/
-	node = connected;
+	if (Z[i] & (reach | (1u << s_f))) reach |= 1u << i;
       }
     }
-    if (seen == max) eulerian_flag = 1;
-    
-    
+    seen = 0;
+    for (i = 0; i < 5; i++) seen += (reach >> i) & 1;
+
     /* (4) If any vertex is not connected in Z to s_f, the new edge ordering
        will not be eulerian, so return to (2). If all vertices are connected
        in Z to s_f, the new edge ordering will be Eulerian, so continue to (5)*/
+    if (seen == max) break;
   }
 
   /* (5) For each vertex s in G, randomly permute the remaining edges of the s
      edge list of E(S) to generate the s edge list of the new edge ordering E(S').*/
   for (i = 0; i < 5; i++)
   {
-    if (n_E[i] > 0)
+    for (j = 0; j < n_E[i]-1; j++)
     {
-	for (j = 0; j < n_E[i]-1; j++)
-	{
-	  int rand_index = (int)(rand() / (((double)RAND_MAX + 1)/ (n_E[i]-1)));
-	  int tmp = E_s[i][j];
-	  E_s[i][j] = E_s[i][rand_index];
-	  E_s[i][rand_index] = tmp;
-	}
+      int rand_index = (int)(shuffle_urn(rng) * (n_E[i]-1));
+      char tmp = E_s[i][j];
+      E_s[i][j] = E_s[i][rand_index];
+      E_s[i][rand_index] = tmp;
     }
   }
-  
-  
+
   /*(6) Construct sequence S', a random DP permutation of S, from E(S') as follows.
     Start at the     s_1 edge list. At each s_i edge list, add s_i to S', delete the
     first edge s_is_j of the edge list, and move to the s_j edge list. Continue this
     process until all edge lists are exhausted.*/
-
-  i = 0;
-  j = s_1;
-  int flag = 0;
-  while (flag == 0)
+  k = 0;
+  j = sh->s_1;
+  while (1)
   {
-    int tmp;
-    switch( j )
-    {
-    case 0 : work_array[i] = 'A';break;
-    case 1 : work_array[i] = 'C';break;
-    case 2 : work_array[i] = 'G';break;
-    case 3 : work_array[i] = 'U';break;
-    case 4 : work_array[i] = 'N';break;  
-    }
-    tmp = E_s[j][i_E[j]];
-    i_E[j]++;
-    j = tmp;
-    i++;
-    if (i_E[j] == n_E[j]) flag = 1;
+    work_array[k++] = letter[j];
+    j = E_s[j][i_E[j]++];
+    if (i_E[j] == n_E[j]) break;
   }
   /*now set the last*/
-  switch( s_f )
-  {
-    case 0 : work_array[i] = 'A';break;
-    case 1 : work_array[i] = 'C';break;
-    case 2 : work_array[i] = 'G';break;
-    case 3 : work_array[i] = 'U';break;
-    case 4 : work_array[i] = 'N';break;  
+  work_array[k] = letter[s_f];
+}
+
+/* Explicit shuffling (see the --seed and --shuffle-* options of RNAz).
+   The shuffles of a sequence only depend on shuffle_seed. With
+   shuffle_stop > 0 sampling stops between shuffle_min and shuffle_max
+   samples once the z-score is known to +-shuffle_stop with 95%
+   confidence, otherwise shuffle_max samples are folded. */
+
+unsigned long long shuffle_seed = 1;
+int shuffle_threads = 1;
+int shuffle_min = 100;
+int shuffle_max = 1000;
+double shuffle_stop = 0;
+
+/* Samples are added in rounds of this size, so where sampling stops
+   does not depend on the number of threads */
+#define SHUFFLE_ROUND 50
+
+struct shuffle_job {
+  unsigned long id;    /* tells the jobs apart, also at the same address */
+  const char *seq;
+  unsigned int length;
+  int type;
+  unsigned long long seed;
+  float *energies;     /* energies[k] of sample k */
+  int next;            /* next sample to fold */
+  int done;            /* samples folded */
+  int end;             /* samples to fold in this round */
+#ifdef HAVE_PTHREAD
+  pthread_cond_t round_done;  /* caller waits for the helpers */
+  struct shuffle_job *next_job;
+#endif
+};
+
+/* The shuffle_threads-1 helper threads are started by the first job
+   and run until stop_shuffle_threads(). They fold samples of any of the
+   jobs of the --threads workers, so there are never more than
+   threads+shuffle_threads-1 folding. The jobs and the helpers share
+   one lock. */
+
+#ifdef HAVE_PTHREAD
+static pthread_mutex_t shuffle_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t shuffle_more = PTHREAD_COND_INITIALIZER;
+static struct shuffle_job *shuffle_jobs = NULL;  /* with samples to fold */
+static pthread_t *helpers = NULL;
+static int n_helpers = 0;
+static int helpers_quit = 0;
+#endif
+static unsigned long shuffle_jobs_started = 0;
+
+/* Each thread folds its samples with its own batch context, kept for
+   all the sequences it shuffles; its arrays only grow */
+
+static THREAD_LOCAL fold_batch_ctx *thread_batch = NULL;
+
+static fold_batch_ctx *batch_ctx(void){
+
+  if (thread_batch == NULL) thread_batch = fold_batch_ctx_create(0);
+  return thread_batch;
+}
+
+void free_shuffle_workspace(void){
+
+  fold_batch_ctx_destroy(thread_batch);
+  thread_batch = NULL;
+}
+
+/* Folds the samples k..k+n-1 (n<=FOLD_BATCH) together. Each sample is
+   shuffled with its own random stream seeded from the job seed and its
+   number, so it is the same whichever thread folds it and in which
+   batch. Only the energies are computed. Every thread has its own
+   dinucleotide shuffler for the sequence and FOLD_BATCH buffers of
+   length+1 in shuff. */
+
+static void fold_samples(struct shuffle_job *job, int k, int n,
+			 fold_batch_ctx *ctx, struct dinuc_shuffler *dinuc,
+			 char *shuff){
+
+  shuffle_rng rng;
+  unsigned long long x;
+  const char *samples[FOLD_BATCH];
+  char *s;
+  int m;
+
+  for (m = 0; m < n; m++) {
+    x = job->seed + 0x9e3779b97f4a7c15ULL * (unsigned long long) (k+m);
+    shuffle_rng_seed(&rng, splitmix64(&x));
+
+    s = shuff + (size_t) m * (job->length+1);
+    if (job->type == 1) fisher_yates_shuffle(job->seq, job->length, s, &rng);
+    if (job->type == 3) altschul_erickson_shuffle(dinuc, s, &rng);
+    s[job->length] = '\0';
+    samples[m] = s;
   }
-  
 
-  /* free all the stuff */
-  for (i = 0; i < 5; i++)
-  {
-    free(E_s[i]);
-    free(Z[i]);
+  fold_batch_energies(ctx, samples, n, job->energies+k);
+}
+
+/* Takes the next samples to fold, at most FOLD_BATCH; the job must be
+   locked */
+
+static int next_samples(struct shuffle_job *job, int *k){
+
+  int n = job->end - job->next;
+
+  if (n > FOLD_BATCH) n = FOLD_BATCH;
+  *k = job->next;
+  job->next += n;
+  return n;
+}
+
+static void jobs_lock(void){
+#ifdef HAVE_PTHREAD
+  pthread_mutex_lock(&shuffle_lock);
+#endif
+}
+
+static void jobs_unlock(void){
+#ifdef HAVE_PTHREAD
+  pthread_mutex_unlock(&shuffle_lock);
+#endif
+}
+
+#ifdef HAVE_PTHREAD
+
+static void *shuffle_thread(void *arg){
+
+  struct shuffle_job *job;
+  struct dinuc_shuffler *dinuc = dinuc_shuffler_create(1);
+  char *shuff = NULL;
+  unsigned int room = 0;   /* length shuff has buffers for */
+  unsigned long set = 0;   /* id of the job dinuc is set for */
+  int k, n;
+
+  (void) arg;
+  pthread_mutex_lock(&shuffle_lock);
+  while (1) {
+    for (job = shuffle_jobs; job != NULL; job = job->next_job)
+      if (job->next < job->end) break;
+    if (job == NULL) {
+      if (helpers_quit) break;
+      pthread_cond_wait(&shuffle_more, &shuffle_lock);
+      continue;
+    }
+    n = next_samples(job, &k);
+    pthread_mutex_unlock(&shuffle_lock);
+
+    /* the job stays until its samples are done */
+    if (job->length > room) {
+      room = job->length;
+      shuff = (char *) xrealloc(shuff, FOLD_BATCH * (room+1));
+    }
+    if (job->id != set) {
+      dinuc_shuffler_set(dinuc, job->seq, job->length);
+      set = job->id;
+    }
+    fold_samples(job, k, n, batch_ctx(), dinuc, shuff);
+
+    pthread_mutex_lock(&shuffle_lock);
+    job->done += n;
+    if (job->done == job->end) pthread_cond_signal(&job->round_done);
+  }
+  pthread_mutex_unlock(&shuffle_lock);
+
+  free(shuff);
+  dinuc_shuffler_free(dinuc);
+  free_shuffle_workspace();
+  return NULL;
+}
+
+/* Starts the helpers that are missing; shuffle_lock must be held */
+
+static void start_shuffle_threads(void){
+
+  if (n_helpers >= shuffle_threads-1) return;
+  helpers = (pthread_t *) xrealloc(helpers, sizeof(pthread_t) * (shuffle_threads-1));
+  for (; n_helpers < shuffle_threads-1; n_helpers++) {
+    if (pthread_create(&helpers[n_helpers], NULL, shuffle_thread, NULL) != 0)
+      nrerror("ERROR: Could not start shuffling thread.\n");
+  }
+}
+
+#endif
+
+void stop_shuffle_threads(void){
+#ifdef HAVE_PTHREAD
+  int k;
+
+  pthread_mutex_lock(&shuffle_lock);
+  helpers_quit = 1;
+  pthread_cond_broadcast(&shuffle_more);
+  pthread_mutex_unlock(&shuffle_lock);
+  for (k = 0; k < n_helpers; k++) {
+    pthread_join(helpers[k], NULL);
   }
+  free(helpers);
+  helpers = NULL;
+  n_helpers = 0;
+  helpers_quit = 0;
+#endif
+}
+
+/* FNV-1a hash of a sequence, so every window gets its own shuffles */
 
-  free(E_s);
-  free(Z);
-  free(n_E);
-  free(i_E);
+static unsigned long long sequence_hash(const char *seq){
+
+  unsigned long long h = 14695981039346656037ULL;
+
+  for (; *seq; seq++) {
+    h ^= (unsigned char) *seq;
+    h *= 1099511628211ULL;
+  }
+  return h;
 }
 
-void zscore_explicitly_shuffled(const char *seq, double *avg, double *stdv, int type){
-    unsigned int n = 1000;
+/* Is the z-score of mfe known well enough from the first n samples? */
+
+static int shuffle_converged(const float *energies, int n, double mfe){
+
+  double mean = 0, var = 0, z;
+  int k;
+
+  for (k = 0; k < n; k++) mean += energies[k];
+  mean /= n;
+  for (k = 0; k < n; k++) var += (energies[k]-mean)*(energies[k]-mean);
+  var /= n-1;
+  if (var <= 0) return 1;
+
+  /* standard error of (mfe-mean)/sd for normal energies */
+  z = (mfe-mean)/sqrt(var);
+  return 1.96*sqrt((1+z*z/2)/n) <= shuffle_stop;
+}
+
+void zscore_explicitly_shuffled(const char *seq, double mfe, double *avg,
+				double *stdv, int type){
+    struct shuffle_job job;
+    unsigned int n;
     unsigned int counter;
-    unsigned int length = strlen(seq);
-    char *tmp = (char *) space((unsigned) length+1);
-    char *shuff = (char *) space((unsigned) length+1);
-    char *structure = (char *) space((unsigned) length+1);
-    float *energies = (float*) space(sizeof(float) * n);
+    char *shuff;
+    struct dinuc_shuffler *dinuc;
+    fold_batch_ctx *ctx;
     float mean = 0;
     float sd = 0;
-    /* generate seed from time */
-    srand((unsigned)time(NULL));
-    strcpy(tmp, seq);
+    int k, m, max;
+#ifdef HAVE_PTHREAD
+    struct shuffle_job **j;
+#endif
+
+    max = (shuffle_max < 2) ? 2 : shuffle_max;
+
+    job.seq = seq;
+    job.length = strlen(seq);
+    job.type = type;
+    /* Same seed and sequence, same shuffles */
+    job.seed = shuffle_seed ^ sequence_hash(seq);
+    job.energies = (float*) space(sizeof(float) * max);
+    job.next = job.done = 0;
+    job.end = (shuffle_stop > 0 && shuffle_min >= 2 && shuffle_min < max) ?
+      shuffle_min : max;
+
+    ctx = batch_ctx();
+    shuff = (char *) space(FOLD_BATCH * (job.length+1));
+    dinuc = dinuc_shuffler_create(job.length);
+    dinuc_shuffler_set(dinuc, seq, job.length);
+
+    jobs_lock();
+    job.id = ++shuffle_jobs_started;
+#ifdef HAVE_PTHREAD
+    if (shuffle_threads > 1) {
+      start_shuffle_threads();
+      pthread_cond_init(&job.round_done, NULL);
+      job.next_job = shuffle_jobs;
+      shuffle_jobs = &job;
+      pthread_cond_broadcast(&shuffle_more);
+    }
+#endif
+
+    /* The calling thread folds samples as well and decides after each
+       round whether to go on */
+    while (1) {
+      while (job.next < job.end) {
+	m = next_samples(&job, &k);
+	jobs_unlock();
+	fold_samples(&job, k, m, ctx, dinuc, shuff);
+	jobs_lock();
+	job.done += m;
+      }
+#ifdef HAVE_PTHREAD
+      while (job.done < job.end)
+	pthread_cond_wait(&job.round_done, &shuffle_lock);
+#endif
+      if (job.end == max || shuffle_converged(job.energies, job.end, mfe))
+	break;
+      job.end += SHUFFLE_ROUND;
+      if (job.end > max) job.end = max;
+#ifdef HAVE_PTHREAD
+      if (shuffle_threads > 1) pthread_cond_broadcast(&shuffle_more);
+#endif
+    }
+
+#ifdef HAVE_PTHREAD
+    if (shuffle_threads > 1) {
+      for (j = &shuffle_jobs; *j != &job; j = &(*j)->next_job);
+      *j = job.next_job;
+      pthread_cond_destroy(&job.round_done);
+    }
+#endif
+    jobs_unlock();
+
+    n = job.end;
 
-    /*printf("INHERE\n");*/
-    
     for (counter = 0; counter < n; counter++)
     {
-      if (type == 1) fisher_yates_shuffle(tmp,length,shuff);
-      if (type == 3) altschul_erickson_shuffle(tmp,length,shuff);
-      energies[counter] = fold(shuff, structure);
-      free_arrays();
-      mean = mean + energies[counter];
+      mean = mean + job.energies[counter];
     }
 
     mean = (float) mean/n;
     
     for (counter = 0; counter < n; counter++)
     {
-      sd += (energies[counter]-mean)*(energies[counter]-mean);
+      sd += (job.energies[counter]-mean)*(job.energies[counter]-mean);
     }
 
     sd = (float) sd/(n-1);
@@ -376,10 +743,9 @@ void zscore_explicitly_shuffled(const char *seq, double *avg, double *stdv, int
     *avg = (double) mean;
     *stdv = (double) sd;
 
-    free(energies);
-    free(tmp);
+    free(job.energies);
     free(shuff);
-    free(structure);
+    dinuc_shuffler_free(dinuc);
 }
 
 
@@ -406,66 +772,76 @@ void regression_svm_init(){
 
 void regression_svm_free(){
 
+  int i;
+
   if (avg_model != NULL) svm_destroy_model(avg_model);
   if (stdv_model != NULL) svm_destroy_model(stdv_model);
-  if (GC20_30_avg != NULL) svm_destroy_model(GC20_30_avg);
-  if (GC30_36_avg != NULL) svm_destroy_model(GC30_36_avg);
-  if (GC36_40_avg != NULL) svm_destroy_model(GC36_40_avg);
-  if (GC40_46_avg != NULL) svm_destroy_model(GC40_46_avg);
-  if (GC46_50_avg != NULL) svm_destroy_model(GC46_50_avg);
-  if (GC50_56_avg != NULL) svm_destroy_model(GC50_56_avg);
-  if (GC56_60_avg != NULL) svm_destroy_model(GC56_60_avg);
-  if (GC60_66_avg != NULL) svm_destroy_model(GC60_66_avg);
-  if (GC66_70_avg != NULL) svm_destroy_model(GC66_70_avg);
-  if (GC70_80_avg != NULL) svm_destroy_model(GC70_80_avg);
-  if (GC20_30_stdv != NULL) svm_destroy_model(GC20_30_stdv);
-  if (GC30_36_stdv != NULL) svm_destroy_model(GC30_36_stdv);
-  if (GC36_40_stdv != NULL) svm_destroy_model(GC36_40_stdv);
-  if (GC40_46_stdv != NULL) svm_destroy_model(GC40_46_stdv);
-  if (GC46_50_stdv != NULL) svm_destroy_model(GC46_50_stdv);
-  if (GC50_56_stdv != NULL) svm_destroy_model(GC50_56_stdv);
-  if (GC56_60_stdv != NULL) svm_destroy_model(GC56_60_stdv);
-  if (GC60_66_stdv != NULL) svm_destroy_model(GC60_66_stdv);
-  if (GC66_70_stdv != NULL) svm_destroy_model(GC66_70_stdv);
-  if (GC70_80_stdv != NULL) svm_destroy_model(GC70_80_stdv);
+  for (i = 0; i < GC_BINS; i++) {
+    svm_dense_pair_free(GC_models[i]);
+    GC_models[i]=NULL;
+  }
 
   avg_model=NULL;
   stdv_model=NULL;
 }
 
 
-/* Predict mean and standard deviation of random sequences for a base
-   composition of a given sequence seq*/
+/* Returns the G+C bin (0..GC_BINS-1) of the dinucleotide regression
+   models, or -1 if GplusC is in none of them */
+
+static int gc_bin(double GplusC){
+
+  if (GplusC >= 0.200 && GplusC < 0.300) return 0;
+  if (GplusC >= 0.300 && GplusC < 0.360) return 1;
+  if (GplusC >= 0.360 && GplusC < 0.400) return 2;
+  if (GplusC >= 0.400 && GplusC < 0.460) return 3;
+  if (GplusC >= 0.460 && GplusC < 0.500) return 4;
+  if (GplusC >= 0.500 && GplusC < 0.560) return 5;
+  if (GplusC >= 0.560 && GplusC < 0.600) return 6;
+  if (GplusC >= 0.600 && GplusC < 0.660) return 7;
+  if (GplusC >= 0.660 && GplusC < 0.700) return 8;
+  if (GplusC >= 0.700 && GplusC <= 0.800) return 9;
+  return -1;
+}
+
+
+/* Decides how mean and standard deviation of random sequences are
+   obtained for the base composition of seq (see predict_values()) and
+   sets the regression features x (4 for type 0, 20 for type 2).
+   Returns the G+C bin for type 2, -1 otherwise. */
 /* type = 0: use MONO-nucleotide shuffled SVM */
 /* type = 1: explictily shuffle MONO-nucleotide */
 /* type = 2: use DI-nucleotide shuffled SVM */
 /* type = 3: explictily shuffle DI-nucleotide */
 
-void predict_values(const char *seq, double *avg, double *stdv, int *type, 
-		    int avoid_shuffle, char* warning_string) {
+static int regression_features(const struct composition *comp, double *x,
+			       int *type, int avoid_shuffle,
+			       char* warning_string) {
 
   unsigned int counter;
-  double *mono_array = (double*) space(sizeof(double) * 5);
-  double *di_array = (double*) space(sizeof(double) * 16);
-  unsigned int length = strlen(seq);
+  double mono_array[4];
+  double di_array[16];
+  unsigned int length = comp->length;
   double GplusC,AT_ratio,CG_ratio;
-  char tmp[20];
+  int bin = -1;
   int verbose;
   verbose = 0; /* set to 1 to get out of range warnings. */
 
-  /* count base frequencies */
-  /* was allocated with space, which makes a calloc */
-  for (counter = 0; counter < 5; counter++) { mono_array[counter] = 0; }
-  for (counter = 0; counter < 16; counter++) { di_array[counter] = 0; }
-  base_frequencies(seq, length, mono_array, di_array);
+  /* base frequencies; RNAz 2.0 was trained with dinucleotide
+     frequencies rounded to three decimal places */
+  for (counter = 0; counter < 3; counter++) {
+    mono_array[counter] = (double) comp->bases[counter]/length;
+  }
+  mono_array[3] = (double) (comp->bases[3] + comp->bases[4])/length;
+  for (counter = 0; counter < 16; counter++) {
+    di_array[counter] = round_decimals((double) comp->di[counter]/(length-1), 3);
+  }
 
   /* RNAz 1.0 uses always the full float. In RNAz 2.0 we used for training numbers 
      with at most 3 decimal places. We adujst it here for RNAz 2.0. */
   if (*type > 0) {
-    for (counter = 0; counter < 5; counter++) { 
-      char tmp[10];
-      sprintf(tmp, "%.3f", (double) mono_array[counter]);
-      mono_array[counter] = (double) atof(tmp);
+    for (counter = 0; counter < 4; counter++) { 
+      mono_array[counter] = round_decimals(mono_array[counter], 3);
     }
   }
 
@@ -476,8 +852,7 @@ void predict_values(const char *seq, double *avg, double *stdv, int *type,
     GplusC =(double) mono_array[1] + mono_array[2];
   } else {
     /* Once again we round to three decimal places for RNAz 2.0 */
-    sprintf(tmp, "%.3f", (double) mono_array[1] + mono_array[2]);
-    GplusC = (double) atof(tmp);
+    GplusC = round_decimals(mono_array[1] + mono_array[2], 3);
   }
   if (mono_array[0] + mono_array[3]==0 || mono_array[1] + mono_array[2]==0) {
     AT_ratio = CG_ratio = 0.0;
@@ -488,11 +863,9 @@ void predict_values(const char *seq, double *avg, double *stdv, int *type,
     } else {
       /* Once again we round to three decimal places for RNAz 2.0 */
       /* CG ratio = C / (C + G) */
-      sprintf(tmp, "%.3f", (double) mono_array[1] / (mono_array[1] + mono_array[2]));
-      CG_ratio = (double) atof(tmp);
+      CG_ratio = round_decimals(mono_array[1] / (mono_array[1] + mono_array[2]), 3);
       /* AT ratio = A / (A + T) */
-      sprintf(tmp, "%.3f", (double) mono_array[0] / (mono_array[0] + mono_array[3]));
-      AT_ratio = (double) atof(tmp);
+      AT_ratio = round_decimals(mono_array[0] / (mono_array[0] + mono_array[3]), 3);
     }
   }
 
@@ -750,15 +1123,51 @@ void predict_values(const char *seq, double *avg, double *stdv, int *type,
 
   /* Mononucleotide Regression */
   if (*type == 0) {
+    x[0] = GplusC;
+    x[1] = AT_ratio;
+    x[2] = CG_ratio;
+    x[3] = length;
+  }
 
-    struct svm_node node_mono[5];
+  /* Dinucleotide Regression */
+  if (*type == 2 ) {  
+
+    /* now set the features, in the order of the libsvm indices 1..20 */
+    x[0] = GplusC;
+    x[1] = CG_ratio;
+    x[2] = AT_ratio;
+    for (counter = 0; counter < 16; counter++) {
+      x[3+counter] = di_array[counter];
+    }
+    /* normalized, scaled sequence length */
+    x[19] = round_decimals((double) (length-50)/150, 5);
+
+    bin = gc_bin(GplusC);
+  }
+
+  return bin;
+}
+
+
+/* Predict mean and standard deviation of random sequences for a base
+   composition of a given sequence seq. For the dinucleotide
+   regression (type 2) mfe_zscore_batch() evaluates many sequences of
+   one G+C bin together, this is the same for a single one. */
+
+static void predict_features(const char *seq, double mfe, const double *x,
+			     int bin, double *avg, double *stdv, int type) {
+
+  unsigned int length = strlen(seq);
 
-    /*printf("GplusC:%f,AT_ratio:%f,CG_ratio:%f,%d\n",GplusC,AT_ratio,CG_ratio,length);*/
+  /* Mononucleotide Regression */
+  if (type == 0) {
+
+    struct svm_node node_mono[5];
 
-    node_mono[0].index = 1; node_mono[0].value = GplusC;
-    node_mono[1].index = 2; node_mono[1].value = AT_ratio;
-    node_mono[2].index = 3; node_mono[2].value = CG_ratio;
-    node_mono[3].index = 4; node_mono[3].value = length;
+    node_mono[0].index = 1; node_mono[0].value = x[0];
+    node_mono[1].index = 2; node_mono[1].value = x[1];
+    node_mono[2].index = 3; node_mono[2].value = x[2];
+    node_mono[3].index = 4; node_mono[3].value = x[3];
     node_mono[4].index =-1;
     
     scale_regression_node((struct svm_node*)&node_mono);
@@ -769,171 +1178,34 @@ void predict_values(const char *seq, double *avg, double *stdv, int *type,
     backscale_regression(avg,stdv);
   }
 
-  /* Mononucleotide explictly shuffled */
-  if (*type == 1) {
-
-    zscore_explicitly_shuffled(seq, avg, stdv, *type);
+  /* Mononucleotide or dinucleotide explictly shuffled */
+  if (type == 1 || type == 3) {
+    zscore_explicitly_shuffled(seq, mfe, avg, stdv, type);
   }
 
-  /* Dinucleotide Regression */
-  if (*type == 2 ) {  
-
-    double norm_length;
-    struct svm_node node_di[21];
-    
-    /* normalized, scaled sequence length */
-    sprintf(tmp, "%.5f", (double) (length-50)/150);
-    norm_length = (double) atof(tmp);
-    
-    /* now set node properties */
-    node_di[0].index = 1; node_di[0].value = GplusC;
-    node_di[1].index = 2; node_di[1].value = CG_ratio;
-    node_di[2].index = 3; node_di[2].value = AT_ratio;
-    node_di[3].index = 4; node_di[3].value = di_array[0];
-    node_di[4].index = 5; node_di[4].value = di_array[1];
-    node_di[5].index = 6; node_di[5].value = di_array[2];
-    node_di[6].index = 7; node_di[6].value = di_array[3];
-    node_di[7].index = 8; node_di[7].value = di_array[4];
-    node_di[8].index = 9; node_di[8].value = di_array[5];
-    node_di[9].index = 10; node_di[9].value = di_array[6];
-    node_di[10].index = 11; node_di[10].value = di_array[7];
-    node_di[11].index = 12; node_di[11].value = di_array[8];
-    node_di[12].index = 13; node_di[12].value = di_array[9];
-    node_di[13].index = 14; node_di[13].value = di_array[10];
-    node_di[14].index = 15; node_di[14].value = di_array[11];
-    node_di[15].index = 16; node_di[15].value = di_array[12];
-    node_di[16].index = 17; node_di[16].value = di_array[13];
-    node_di[17].index = 18; node_di[17].value = di_array[14];
-    node_di[18].index = 19; node_di[18].value = di_array[15];
-    node_di[19].index = 20; node_di[19].value = norm_length;
-    node_di[20].index =-1;
-
-    /* Now we have to fetch the right model and calculate avg and stdv*/
- 
-    if (GplusC >= 0.200 && GplusC < 0.300) {
-      if (GC20_30_avg == NULL || GC20_30_stdv == NULL)
-      {
-	get_regression_models(&GC20_30_avg, &GC20_30_stdv, 0);
-	/*printf("\n==Model for GC 20-30 was loaded.\n");*/
-      }
-      *avg=svm_predict(GC20_30_avg,node_di);
-      *stdv=svm_predict(GC20_30_stdv,node_di);
-      *avg = *avg/10.0 * length;
-    }
-
-    if (GplusC >= 0.300 && GplusC < 0.360) {
-      if (GC30_36_avg == NULL || GC30_36_stdv == NULL)
-      {
-	get_regression_models(&GC30_36_avg, &GC30_36_stdv, 1);
-	/*printf("\n==Model for GC 30-36 was loaded.\n");*/
-      }
-      *avg=svm_predict(GC30_36_avg,node_di);
-      *stdv=svm_predict(GC30_36_stdv,node_di);
-      *avg = *avg/10.0 * length;
-    }
-
-    if (GplusC >= 0.360 && GplusC < 0.400) {
-      if (GC36_40_avg == NULL || GC36_40_stdv == NULL)
-      {
-	get_regression_models(&GC36_40_avg, &GC36_40_stdv, 2);
-	/*printf("\n==Model for GC 36-40 was loaded.\n");*/
-      }
-      *avg=svm_predict(GC36_40_avg,node_di);
-      *stdv=svm_predict(GC36_40_stdv,node_di);
-      *avg = *avg/10.0 * length;
-    }
-
-    if (GplusC >= 0.400 && GplusC < 0.460) {
-      if (GC40_46_avg == NULL || GC40_46_stdv == NULL)
-      {
-	get_regression_models(&GC40_46_avg, &GC40_46_stdv, 3);
-	/*printf("\n==Model for GC 40-46 was loaded.\n");*/
-      }
-      *avg=svm_predict(GC40_46_avg,node_di);
-      *stdv=svm_predict(GC40_46_stdv,node_di);
-      *avg = *avg/10.0 * length;
-    }
-
-    if (GplusC >= 0.460 && GplusC < 0.500) {
-      if (GC46_50_avg == NULL || GC46_50_stdv == NULL)
-      {
-	get_regression_models(&GC46_50_avg, &GC46_50_stdv, 4);
-	/*printf("\n==Model for GC 46-50 was loaded.\n");*/
-      }
-      *avg=svm_predict(GC46_50_avg,node_di);
-      *stdv=svm_predict(GC46_50_stdv,node_di);
-      *avg = *avg/10.0 * length;
-    }
-
-    if (GplusC >= 0.500 && GplusC < 0.560) {
-      if (GC50_56_avg == NULL || GC50_56_stdv == NULL)
-      {
-	get_regression_models(&GC50_56_avg, &GC50_56_stdv, 5);
-	/*printf("\n==Model for GC 50-56 was loaded.\n");*/
-      }
-      *avg=svm_predict(GC50_56_avg,node_di);
-      *stdv=svm_predict(GC50_56_stdv,node_di);
-      *avg = *avg/10.0 * length;
-    }
-
-    if (GplusC >= 0.560 && GplusC < 0.600) {
-      if (GC56_60_avg == NULL || GC56_60_stdv == NULL)
-      {
-	get_regression_models(&GC56_60_avg, &GC56_60_stdv, 6);
-	/*printf("\n==Model for GC 56-60 was loaded.\n");*/
-      }
-      *avg=svm_predict(GC56_60_avg,node_di);
-      *stdv=svm_predict(GC56_60_stdv,node_di);
-      *avg = *avg/10.0 * length;
-    }
+  /* Dinucleotide Regression; no model outside of 20-80% G+C */
+  if (type == 2 && bin >= 0) {
+    load_regression_models(&GC_models[bin], bin);
+    svm_dense_pair_predict(GC_models[bin],x,avg,stdv);
+    *avg = *avg/10.0 * length;
+  }
+}
 
-    if (GplusC >= 0.600 && GplusC < 0.660) {
-      if (GC60_66_avg == NULL || GC60_66_stdv == NULL)
-      {
-	get_regression_models(&GC60_66_avg, &GC60_66_stdv, 7);
-	/*printf("\n==Model for GC 60-66 was loaded.\n");*/
-      }
-      *avg=svm_predict(GC60_66_avg,node_di);
-      *stdv=svm_predict(GC60_66_stdv,node_di);
-      *avg = *avg/10.0 * length;
-    }
 
-    if (GplusC >= 0.660 && GplusC < 0.700) {
-      if (GC66_70_avg == NULL || GC66_70_stdv == NULL)
-      {
-	get_regression_models(&GC66_70_avg, &GC66_70_stdv, 8);
-	/*printf("\n==Model for GC 66-70 was loaded.\n");*/
-      }
-      *avg=svm_predict(GC66_70_avg,node_di);
-      *stdv=svm_predict(GC66_70_stdv,node_di);
-      *avg = *avg/10.0 * length;
-    }
+void predict_values(const char *seq, const struct composition *comp,
+		    double mfe, double *avg, double *stdv,
+		    int *type, int avoid_shuffle, char* warning_string) {
 
-    if (GplusC >= 0.700 && GplusC <= 0.800) {
-      if (GC70_80_avg == NULL || GC70_80_stdv == NULL)
-      {
-	get_regression_models(&GC70_80_avg, &GC70_80_stdv, 9);
-	/*printf("\n==Model for GC 70-80 was loaded.\n");*/
-      }
-      *avg=svm_predict(GC70_80_avg,node_di);
-      *stdv=svm_predict(GC70_80_stdv,node_di);
-      *avg = *avg/10.0 * length;
-    }
-  }
+  double x[20];
+  int bin;
 
-  /* Dinucleotide explictly shuffled */
-  if (*type == 3) {
-    zscore_explicitly_shuffled(seq, avg, stdv, *type);
-  }
-  
-  free(mono_array);
-  free(di_array);
-  
+  bin = regression_features(comp, x, type, avoid_shuffle, warning_string);
+  predict_features(seq, mfe, x, bin, avg, stdv, *type);
 }
 
 
 /* Predict the z-score of a sequence. If a mfe>0 is given, the mfe of
-   the sequence is calculated by fold() otherwise the precalculated
+   the sequence is calculated by fold_energy_only() otherwise the precalculated
    value is used*/
 /* type = 0: use MONO-nucleotide shuffled SVM */
 /* type = 1: explictily shuffle MONO-nucleotide */
@@ -943,27 +1215,26 @@ void predict_values(const char *seq, double *avg, double *stdv, int *type,
 double mfe_zscore(const char *seq, double mfe, int *type, int avoid_shuffle,
 		  char* warning_string) {
   double E, stdv, avg;
-  char *struc;
+  struct composition comp;
 
   if (mfe>0){
-	struc = space(strlen(seq)+1);
-	E = fold(seq, struc);
-	free(struc);
+	E = fold_energy_only(NULL, seq);
   } else {
 	E=mfe;
   }
   
   avg = 0.0;
   stdv = 0.0;
-  
-  predict_values(seq, &avg, &stdv, type, avoid_shuffle, warning_string);
+
+  sequence_composition(seq, NULL, NULL, &comp);
+  predict_values(seq, &comp, E, &avg, &stdv, type, avoid_shuffle, warning_string);
 
   /* Just as backup strategy if something goes totally wrong, 
      we evaluate the sequence once again by shuffling */
   if (avg > -1 || stdv < 0.1) {
     if (*type == 2) *type = 3;
     if (*type == 0) *type = 1;
-    predict_values(seq, &avg, &stdv, type, avoid_shuffle, warning_string);
+    predict_values(seq, &comp, E, &avg, &stdv, type, avoid_shuffle, warning_string);
   }
 
   /* If stdv is close to zero, we set the z-score by definition to zero.*/
@@ -977,3 +1248,116 @@ double mfe_zscore(const char *seq, double mfe, int *type, int avoid_shuffle,
 
 }
   
+
+
+/* Same as calling mfe_zscore() for the sequences seqs[0..n-1] one
+   after the other, with the energies mfes[], the z-scores in z[] and
+   the types in types[] (on input the type requested for each
+   sequence, on output the one used). The dinucleotide regression is
+   done for all sequences of one G+C bin at once. warning_string ends
+   up with the warnings of the last sequence that had any, just like
+   in the sequential calls. comps[] are the compositions of the
+   sequences, if NULL they are counted here. */
+
+#define WARNING_SIZE 2000
+
+void mfe_zscore_batch(const char **seqs, const struct composition *comps,
+		      const double *mfes, int n,
+		      double *z, int *types, int avoid_shuffle,
+		      char* warning_string) {
+
+  struct composition *counted = NULL;
+  double *E, *avg, *stdv, *x, *x_bin, *avg_bin, *stdv_bin;
+  int *bin, *members;
+  char *warnings;
+  int i, b, m;
+
+  if (n <= 0) return;
+
+  E = (double *) space(sizeof(double) * n);
+  avg = (double *) space(sizeof(double) * n);
+  stdv = (double *) space(sizeof(double) * n);
+  x = (double *) space(sizeof(double) * 20 * n);
+  x_bin = (double *) space(sizeof(double) * 20 * n);
+  avg_bin = (double *) space(sizeof(double) * n);
+  stdv_bin = (double *) space(sizeof(double) * n);
+  bin = (int *) space(sizeof(int) * n);
+  members = (int *) space(sizeof(int) * n);
+  warnings = (char *) space(WARNING_SIZE * n);
+
+  if (comps == NULL) {
+    counted = (struct composition *) space(sizeof(struct composition) * n);
+    for (i = 0; i < n; i++) {
+      sequence_composition(seqs[i], NULL, NULL, &counted[i]);
+    }
+    comps = counted;
+  }
+
+  for (i = 0; i < n; i++) {
+    if (mfes[i]>0){
+      E[i] = fold_energy_only(NULL, seqs[i]);
+    } else {
+      E[i]=mfes[i];
+    }
+    avg[i] = 0.0;
+    stdv[i] = 0.0;
+    bin[i] = regression_features(&comps[i], x+20*i, &types[i], avoid_shuffle,
+				 warnings+WARNING_SIZE*i);
+  }
+
+  /* Dinucleotide regression, one G+C bin after the other */
+  for (b = 0; b < GC_BINS; b++) {
+    m = 0;
+    for (i = 0; i < n; i++) {
+      if (types[i] == 2 && bin[i] == b) {
+	memcpy(x_bin+20*m, x+20*i, sizeof(double) * 20);
+	members[m++] = i;
+      }
+    }
+    if (m == 0) continue;
+
+    load_regression_models(&GC_models[b], b);
+    svm_dense_pair_predict_batch(GC_models[b], x_bin, m, avg_bin, stdv_bin);
+    for (i = 0; i < m; i++) {
+      avg[members[i]] = avg_bin[i]/10.0 * strlen(seqs[members[i]]);
+      stdv[members[i]] = stdv_bin[i];
+    }
+  }
+
+  for (i = 0; i < n; i++) {
+    if (types[i] != 2) {
+      predict_features(seqs[i], E[i], x+20*i, bin[i], &avg[i], &stdv[i],
+		       types[i]);
+    }
+
+    /* backup strategy, see mfe_zscore() */
+    if (avg[i] > -1 || stdv[i] < 0.1) {
+      if (types[i] == 2) types[i] = 3;
+      if (types[i] == 0) types[i] = 1;
+      predict_values(seqs[i], &comps[i], E[i], &avg[i], &stdv[i], &types[i],
+		     avoid_shuffle, warnings+WARNING_SIZE*i);
+    }
+
+    if ( stdv[i] < 0.00001) {
+      z[i] = 0.0;
+    } else {
+      z[i] = (E[i]-avg[i])/stdv[i];
+    }
+
+    if (warnings[WARNING_SIZE*i] != '\0') {
+      strcpy(warning_string, warnings+WARNING_SIZE*i);
+    }
+  }
+
+  free(E);
+  free(avg);
+  free(stdv);
+  free(x);
+  free(x_bin);
+  free(avg_bin);
+  free(stdv_bin);
+  free(bin);
+  free(members);
+  free(warnings);
+  free(counted);
+}
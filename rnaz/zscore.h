@@ -10,8 +10,41 @@
  *                                                                   *
  *********************************************************************/
 
+/* Explicit shuffling: seed, threads, number of samples and the
+   precision of the z-score at which sampling may stop early (0: never) */
+extern unsigned long long shuffle_seed;
+extern int shuffle_threads;
+extern int shuffle_min;
+extern int shuffle_max;
+extern double shuffle_stop;
+
+/* Releases the batch context the calling thread shuffled with */
+void free_shuffle_workspace(void);
+
+/* Ends the helper threads of the explicit shuffling */
+void stop_shuffle_threads(void);
+
+/* Base composition of a sequence, see sequence_composition() */
+struct composition {
+  int length;       /* characters that are not gaps ('-') */
+  int gaps;
+  int bases[6];     /* A, C, G, T, U and any other character */
+  int di[16];       /* AA, AC, AG, AU, CA, ..., UU without gaps; T and U
+                       are the same, but TU and UT are not counted */
+};
+
+void sequence_composition(const char *seq, char *rna, char *ungapped,
+			  struct composition *comp);
+
+double round_decimals(double v, int digits);
+
 void regression_svm_init();
 
 void regression_svm_free();
 
 double mfe_zscore(const char *seq, double mfe, int *type, int avoid_shuffle, char* warning_string);
+
+void mfe_zscore_batch(const char **seqs, const struct composition *comps,
+		      const double *mfes, int n,
+		      double *z, int *types, int avoid_shuffle,
+		      char* warning_string);